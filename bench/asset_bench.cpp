@@ -0,0 +1,397 @@
+/*
+ * Headless asset benchmark: measures the CPU parse stage (modelParse/objParse, materialParse, imageLoad) of every asset
+ * under the given files/folders. No window or GL context is created, so it also runs on machines without a GPU.
+ * OBJ files are additionally compared with the previous iostream parser and the warm binary mesh cache, and the
+ * vertex cache optimization (MODEL_LOAD_OPTIMIZE) is timed with its triangle weighted ACMR before and after.
+ *
+ * usage: asset_bench [file-or-folder ...]   (defaults to assets/)
+ */
+#include "mygl/model.h"
+#include "mygl/mesh_cache.h"
+#include "mygl/mesh_optimize.h"
+#include "mygl/texture.h"
+#include "mygl/thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace legacy
+{
+
+/* parser as it was before objParse (stringstream per line, one vector<string> per face corner) */
+void tokenize(std::string const &str, const char delim, std::vector<std::string> &out)
+{
+    size_t start;
+    size_t end = 0;
+
+    while( (start = str.find_first_not_of(delim, end)) != std::string::npos )
+    {
+        end = str.find(delim, start);
+        out.push_back(str.substr(start, end - start));
+    }
+}
+
+struct Index
+{
+    unsigned int v = 0;
+    unsigned int vt = 0;
+    unsigned int vn = 0;
+    int tokens = 0;
+
+    friend std::stringstream& operator >>(std::stringstream& in, Index& index)
+    {
+        std::string data;
+        in >> data;
+
+        std::vector<std::string> tokens;
+        tokenize(data, '/', tokens);
+
+        index.tokens = static_cast<int>(tokens.size());
+        if(tokens.empty())
+        {
+            return in;
+        }
+
+        index.v = std::stoi( tokens[0] );
+        if(tokens.size() == 2)
+        {
+            index.vn = std::stoi( tokens[1] );
+        }
+        else if(tokens.size() == 3)
+        {
+            index.vt = std::stoi( tokens[1] );
+            index.vn = std::stoi( tokens[2] );
+        }
+        return in;
+    }
+};
+
+ObjData objParse(const std::string& filepath)
+{
+    std::ifstream objFile(filepath);
+    if(!objFile.is_open())
+    {
+        throw std::runtime_error("[Bench] Couldn't open OBJ file at " + filepath);
+    }
+
+    ObjData data;
+    std::vector<Vector3D> vertices;
+    std::vector<Vector3D> normals;
+    std::vector<Vector2D> uvs;
+
+    std::string line;
+    while(std::getline(objFile, line))
+    {
+        std::stringstream ss(line);
+        std::string code;
+        ss >> code;
+
+        if(code == "o")
+        {
+            if(!data.objects.empty() && !data.objects.back().material.empty())
+            {
+                auto& range = data.objects.back().material.back();
+                range.indexCount = data.objects.back().indices.size() - range.indexOffset;
+            }
+            ss >> data.objects.emplace_back().name;
+        }
+        else if(code == "v")
+        {
+            auto& v = vertices.emplace_back();
+            ss >> v.x >> v.y >> v.z;
+        }
+        else if(code == "vt")
+        {
+            auto& vt = uvs.emplace_back();
+            ss >> vt.x >> vt.y;
+        }
+        else if(code == "vn")
+        {
+            auto& vn = normals.emplace_back();
+            ss >> vn.x >> vn.y >> vn.z;
+        }
+        else if(code == "f")
+        {
+            auto& object = data.objects.back();
+            Index idx[3];
+            ss >> idx[0] >> idx[1] >> idx[2];
+            for(int i = 0; i < 3; i++)
+            {
+                object.indices.emplace_back(object.vertices.size());
+                Vertex& vertex = object.vertices.emplace_back();
+                vertex.pos = vertices[idx[i].v - 1];
+                if(idx[i].tokens >= 2)
+                {
+                    vertex.normal = normals[idx[i].vn - 1];
+                }
+                if(idx[i].tokens == 3)
+                {
+                    vertex.uv = uvs[idx[i].vt - 1];
+                }
+            }
+        }
+        else if(code == "mtllib")
+        {
+            ss >> data.materialLibraries.emplace_back();
+        }
+        else if(code == "usemtl")
+        {
+            auto& object = data.objects.back();
+            if(!object.material.empty())
+            {
+                auto& range = object.material.back();
+                range.indexCount = object.indices.size() - range.indexOffset;
+            }
+            auto& range = object.material.emplace_back();
+            ss >> range.material;
+            range.indexOffset = object.indices.size();
+        }
+    }
+
+    if(!data.objects.empty() && !data.objects.back().material.empty())
+    {
+        auto& range = data.objects.back().material.back();
+        range.indexCount = data.objects.back().indices.size() - range.indexOffset;
+    }
+    return data;
+}
+
+}
+
+template<typename F>
+double timeBest(int runs, F&& f)
+{
+    double best = 1e30;
+    for(int i = 0; i < runs; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto stop = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(stop - start).count());
+    }
+    return best;
+}
+
+bool sameVertex(const Vertex& a, const Vertex& b)
+{
+    return a.pos.x == b.pos.x && a.pos.y == b.pos.y && a.pos.z == b.pos.z
+        && a.normal.x == b.normal.x && a.normal.y == b.normal.y && a.normal.z == b.normal.z && a.normal.w == b.normal.w
+        && a.uv.x == b.uv.x && a.uv.y == b.uv.y;
+}
+
+/* compares the triangles of both parses corner by corner (index buffers may differ after welding) */
+bool sameData(const ObjData& a, const ObjData& b)
+{
+    if(a.objects.size() != b.objects.size() || a.materialLibraries != b.materialLibraries)
+    {
+        return false;
+    }
+    for(size_t i = 0; i < a.objects.size(); i++)
+    {
+        const auto& oa = a.objects[i];
+        const auto& ob = b.objects[i];
+        if(oa.name != ob.name || oa.indices.size() != ob.indices.size() || oa.material.size() != ob.material.size())
+        {
+            return false;
+        }
+        for(size_t k = 0; k < oa.indices.size(); k++)
+        {
+            if(!sameVertex(oa.vertices[oa.indices[k]], ob.vertices[ob.indices[k]]))
+            {
+                return false;
+            }
+        }
+        for(size_t m = 0; m < oa.material.size(); m++)
+        {
+            if(oa.material[m].material != ob.material[m].material || oa.material[m].indexOffset != ob.material[m].indexOffset
+               || oa.material[m].indexCount != ob.material[m].indexCount)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+size_t vertexCount(const ObjData& data)
+{
+    size_t count = 0;
+    for(const auto& object : data.objects)
+    {
+        count += object.vertices.size();
+    }
+    return count;
+}
+
+struct Totals
+{
+    double megabytes = 0.0;
+    double seconds = 0.0;
+    double triangles = 0.0;
+    double pixels = 0.0;
+};
+
+void printRow(const std::string& file, double megabytes, double seconds, const std::string& rate, const std::string& notes)
+{
+    std::cout << std::left << std::setw(72) << file << std::right
+              << std::setw(8) << megabytes << " MB "
+              << std::setw(9) << seconds * 1000.0 << " ms "
+              << std::setw(9) << megabytes / seconds << " MB/s "
+              << std::setw(16) << rate << "  " << notes << std::endl;
+}
+
+std::string rate(double count, double seconds, const std::string& unit)
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2) << count / seconds / 1e6 << " M" << unit << "/s";
+    return ss.str();
+}
+
+void benchObj(const std::string& file, double megabytes, int runs, Totals& totals)
+{
+    ObjData current, previous;
+    double tParse = timeBest(runs, [&]() { current = objParse(file); });
+    double tLegacy = timeBest(runs, [&]() { previous = legacy::objParse(file); });
+
+    /* bounded memory path: spilled pools, one object alive at a time */
+    double tStream = timeBest(runs, [&]() { objStream(file, [](const std::vector<std::string>&) {}, [](ObjObject&) {}); });
+
+    /* warm cache: map the blob, validate the source stamp and hash (the blob of the default flags, the ones the app
+       loads with are named differently and stay untouched) */
+    meshCacheWrite(file, current, MODEL_LOAD_DEFAULT);
+    MeshCache cache;
+    bool cacheValid = true;
+    double tCache = timeBest(runs, [&]() { cacheValid = meshCacheLoad(file, MODEL_LOAD_DEFAULT, cache) && cacheValid; });
+
+    /* optimization works in place, so it runs once on a copy */
+    ObjData optimized = current;
+    double tOptimize = timeBest(1, [&]() {
+        for(auto& object : optimized.objects)
+        {
+            meshOptimize(object);
+        }
+    });
+
+    double triangles = 0.0, acmrBefore = 0.0, acmrAfter = 0.0;
+    for(std::size_t i = 0; i < current.objects.size(); i++)
+    {
+        const auto& before = current.objects[i];
+        const auto& after = optimized.objects[i];
+        double objectTriangles = static_cast<double>(before.indices.size() / 3);
+        triangles += objectTriangles;
+        acmrBefore += objectTriangles * vertexCacheStats(before.indices.data(), before.indices.size(), before.vertices.size()).acmr;
+        acmrAfter += objectTriangles * vertexCacheStats(after.indices.data(), after.indices.size(), after.vertices.size()).acmr;
+    }
+
+    std::stringstream notes;
+    notes << std::fixed << std::setprecision(2)
+          << "legacy " << tLegacy * 1000.0 << " ms (" << tLegacy / tParse << "x slower, "
+          << (sameData(current, previous) ? "same output" : "OUTPUT DIFFERS") << "), "
+          << "stream " << tStream * 1000.0 << " ms, "
+          << "cache " << tCache * 1000.0 << " ms" << (cacheValid ? "" : " INVALID") << ", "
+          << vertexCount(previous) << " -> " << vertexCount(current) << " vertices, "
+          << "optimize " << tOptimize * 1000.0 << " ms (ACMR " << acmrBefore / std::max(triangles, 1.0) << " -> " << acmrAfter / std::max(triangles, 1.0) << ")";
+    printRow(file, megabytes, tParse, rate(triangles, tParse, "tris"), notes.str());
+
+    totals.triangles += triangles;
+    totals.seconds += tParse;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> inputs;
+    for(int i = 1; i < argc; i++)
+    {
+        inputs.emplace_back(argv[i]);
+    }
+    if(inputs.empty())
+    {
+        inputs.emplace_back("assets");
+    }
+
+    /* collect files, folders are searched recursively */
+    std::vector<std::filesystem::path> files;
+    for(const auto& input : inputs)
+    {
+        if(std::filesystem::is_directory(input))
+        {
+            for(const auto& entry : std::filesystem::recursive_directory_iterator(input))
+            {
+                if(entry.is_regular_file())
+                {
+                    files.push_back(entry.path());
+                }
+            }
+        }
+        else if(std::filesystem::exists(input))
+        {
+            files.emplace_back(input);
+        }
+        else
+        {
+            std::cout << input << ": not found, skipped" << std::endl;
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    const int runs = 3;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "threads: " << threadPoolSize() << " (set MYGL_THREADS to compare)" << std::endl;
+
+    Totals totals;
+    for(const auto& path : files)
+    {
+        std::string file = path.generic_string();
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        double megabytes = static_cast<double>(std::filesystem::file_size(path)) / (1024.0 * 1024.0);
+
+        try
+        {
+            if(extension == ".obj")
+            {
+                benchObj(file, megabytes, runs, totals);
+            }
+            else if(extension == ".mtl")
+            {
+                std::size_t count = 0;
+                double t = timeBest(runs, [&]() { count = materialParse(file).size(); });
+                printRow(file, megabytes, t, "", std::to_string(count) + " materials");
+                totals.seconds += t;
+            }
+            else if(extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp")
+            {
+                ImageData image;
+                double t = timeBest(runs, [&]() { image = imageLoad(file); });
+                double pixels = static_cast<double>(image.width) * image.height;
+                printRow(file, megabytes, t, rate(pixels, t, "pix"), std::to_string(image.width) + "x" + std::to_string(image.height));
+                totals.pixels += pixels;
+                totals.seconds += t;
+            }
+            else
+            {
+                continue;
+            }
+            totals.megabytes += megabytes;
+        }
+        catch(const std::exception& e)
+        {
+            std::cout << file << ": " << e.what() << std::endl;
+        }
+    }
+
+    std::cout << "total: " << totals.megabytes << " MB in " << totals.seconds * 1000.0 << " ms ("
+              << totals.megabytes / std::max(totals.seconds, 1e-9) << " MB/s), "
+              << totals.triangles / 1e6 << " M triangles, " << totals.pixels / 1e6 << " M pixels" << std::endl;
+
+    return EXIT_SUCCESS;
+}
@@ -1,11 +1,20 @@
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
+#include <filesystem>
 #include <iostream>
+#include <stdexcept>
+#include <tuple>
 
 #include "mygl/shader.h"
+#include "mygl/shader_cache.h"
 #include "mygl/mesh.h"
 #include "mygl/geometry.h"
 #include "mygl/camera.h"
 #include "mygl/cube_map.h"
+#include "mygl/thread_pool.h"
+#include "mygl/uniform_buffer.h"
+#include "mygl/draw_ring.h"
 
 #include "planet.h"
 #include "plane.h"
@@ -70,12 +79,27 @@ struct
     /* plane */
     Plane plane;
 
-    /* shader */
+    /* sky, texture id 0 if its faces are missing (the clear color shows instead) */
+    Skybox skybox;
+
+    /* shader, the color program reads texture arrays with s3tc and separate, packed maps without it */
     eRenderMode renderMode;
+    bool textureArrays;
     ShaderProgram shaderColor;
     ShaderProgram shaderNormal;
     ShaderProgram shaderFlagColor;
     ShaderProgram shaderFlagNormal;
+    ShaderProgram shaderSkybox;
+
+    /* camera and light, filled once per frame and read by all programs through their uniform blocks */
+    UniformBuffer frameBlock;
+    UniformBuffer lightBlock;
+
+    /* per draw model matrices and the material table, the draws only pass the index of their record */
+    DrawRing drawRing;
+    UniformBuffer materialTable;
+    std::vector<Material*> materials;
+    std::vector<MaterialRecord> materialRecords;
 
     bool isDay;
 
@@ -236,10 +260,128 @@ void sceneInit(float width, float height)
     sScene.cameraFollow = eCameraFollow::PLANE;
     sScene.zoomSpeedMultiplier = 0.05f;
 
+    /* submit all programs first, the driver compiles them while the assets below load (programs of earlier runs come
+     * from the binary cache, errors show at their first use) */
+    double shaderTime = glfwGetTime();
+    sScene.textureArrays = textureCompressionSupported();
+    std::vector<ShaderProgram> programs = shaderCreateAsync({
+        shaderSourceLoad("shader/default.vert", "shader/color.frag", {sScene.textureArrays ? "TEXTURE_ARRAYS" : "PACKED_MAPS"}),
+        shaderSourceLoad("shader/default.vert", "shader/normal.frag"),
+        shaderSourceLoad("shader/flag.vert", "shader/flag.frag", {sScene.textureArrays ? "TEXTURE_ARRAYS" : "PACKED_MAPS"}),
+        shaderSourceLoad("shader/flag.vert", "shader/normal.frag"),
+        shaderSourceLoad("shader/skybox.vert", "shader/skybox.frag")
+    });
+    shaderTime = glfwGetTime() - shaderTime;
+    sScene.shaderColor = programs[0];
+    sScene.shaderNormal = programs[1];
+    sScene.shaderFlagColor = programs[2];
+    sScene.shaderFlagNormal = programs[3];
+    sScene.shaderSkybox = programs[4];
+
+    /* decode all textures of the scene in parallel up front, the loads of the objects below are cache hits then. The
+     * plane (with its flag) is always close to the camera, so its maps outrank the planet's under a texture budget. */
+    double textureTime = glfwGetTime();
+    std::vector<TextureRequest> textureRequests = {{"assets/flag/textures/Flag_Displacement.png", TEXTURE_USAGE_DATA, TEXTURE_PRIORITY_PRIMARY + 1}};
+    const std::pair<const char*, int> libraries[] = {
+        {"assets/plane/Cessna.mtl", 1}, {"assets/flag/flag_uibk_textured.mtl", 1}, {"assets/planet/earth-cartoon.mtl", 0}
+    };
+    for(const auto& [library, objectPriority] : libraries)
+    {
+        for(const auto& [name, material] : materialParse(library))
+        {
+            /* same usages as materialUpload, otherwise the loads below miss the cache */
+            const std::tuple<const std::string*, eTextureUsage, eTexturePriority> maps[] = {
+                {&material.map_emission, TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE},
+                {&material.map_ambient, TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL},
+                {&material.map_diffuse, TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY},
+                {&material.map_specular, TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE},
+                {&material.map_shininess, TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL},
+                {&material.map_normal, TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY}
+            };
+            for(const auto& [path, usage, rolePriority] : maps)
+            {
+                if(!path->empty())
+                {
+                    textureRequests.push_back(TextureRequest{*path, usage, rolePriority + objectPriority});
+                }
+            }
+        }
+    }
+    std::vector<Texture> sceneTextures = textureLoadBatch(textureRequests);
+    textureTime = glfwGetTime() - textureTime;
+
     /* setup objects in scene and create opengl buffers for meshes */
     sScene.plane = planeLoad("assets/plane/Cessna.obj", "assets/flag/flag_uibk_textured.obj");
     sScene.planet = planetLoad("assets/planet/earth-cartoon.obj");
 
+    /* the objects hold their own references now */
+    for(const Texture& texture : sceneTextures)
+    {
+        textureDelete(texture);
+    }
+
+    /* without s3tc the objects packed their scalar maps instead of building texture arrays (see materialFamilyPrepare) */
+    if(!sScene.textureArrays)
+    {
+        unsigned int materialCount = 0, packedCount = 0;
+        for(auto* models : {&sScene.plane.partModel, &sScene.planet.partModel})
+        {
+            for(const auto& model : *models)
+            {
+                for(const auto& material : model.material)
+                {
+                    materialCount++;
+                    packedCount += material.map_packed.id != 0 ? 1 : 0;
+                }
+            }
+        }
+        std::cout << "[Texture] packed the scalar maps of " << packedCount << " of " << materialCount << " materials" << std::endl;
+    }
+
+    TextureCacheStats textures = textureCacheStats();
+    std::cout << "[Texture] " << textures.decodes << " images decoded and " << textures.diskLoads << " loaded from cache on " << threadPoolSize()
+              << " threads in " << textureTime * 1000.0 << " ms, "
+              << textures.compressed << " compressed to BCn, " << textures.hits << " cache hits, " << textures.uploadBytes / (1024 * 1024) << " MB uploaded, "
+              << textures.savedBytes / (1024 * 1024) << " MB VRAM saved, " << textures.arrayLayers << " maps in " << textures.arrays
+              << " texture arrays" << std::endl;
+
+    /* effective resolutions, only interesting if the budget had to drop levels */
+    std::cout << "[Texture] " << textures.residentBytes / (1024 * 1024) << " MB resident";
+    if(textureBudget() != 0)
+    {
+        std::cout << " of a " << textureBudget() / (1024 * 1024) << " MB budget, " << textures.droppedLevels << " mip levels dropped";
+    }
+    std::cout << std::endl;
+    if(textures.droppedLevels > 0)
+    {
+        for(const TextureResidency& texture : textureResidency())
+        {
+            std::cout << "  " << texture.name << ": " << texture.loadedWidth << "x" << texture.loadedHeight << " of " << texture.width << "x"
+                      << texture.height << " (priority " << texture.priority << ", " << texture.bytes / 1024 << " KB)" << std::endl;
+        }
+    }
+
+    /* the sky is optional, without all six faces the background stays the clear color */
+    const std::string skyboxPath = "assets/skybox/hiptyc_2020_4k_gal_with_syferfontein_18d_clear_puresky_4k/";
+    std::array<std::string, 6> skyboxFaces;
+    bool skyboxComplete = true;
+    for(unsigned int i = 0; i < skyboxFaces.size(); i++)
+    {
+        skyboxFaces[i] = skyboxPath + "n_" + std::to_string(i) + ".png";
+        skyboxComplete = skyboxComplete && std::filesystem::exists(skyboxFaces[i]);
+    }
+    if(skyboxComplete)
+    {
+        double skyboxTime = glfwGetTime();
+        sScene.skybox = skyboxCreate(skyboxFaces);
+        std::cout << "[Skybox] " << sScene.skybox.texture.width << "x" << sScene.skybox.texture.height << " faces loaded in " << (glfwGetTime() - skyboxTime) * 1000.0
+                  << " ms" << std::endl;
+    }
+    else
+    {
+        std::cerr << "[Skybox] faces in " << skyboxPath << " are incomplete, drawing the clear color instead" << std::endl;
+    }
+
     /* Create a light source for day and night */
     sScene.isDay = true;
 
@@ -257,11 +399,45 @@ void sceneInit(float width, float height)
     sScene.nightLight.kd = 0.3f;
     sScene.nightLight.ks = 0.2f;
 
-    /* load shader from file */
-    sScene.shaderColor = shaderLoad("shader/default.vert", "shader/color.frag");
-    sScene.shaderNormal = shaderLoad("shader/default.vert", "shader/normal.frag");
-    sScene.shaderFlagColor = shaderLoad("shader/flag.vert", "shader/flag.frag");
-    sScene.shaderFlagNormal = shaderLoad("shader/flag.vert", "shader/normal.frag");
+    /* programs the driver finished while the assets loaded, the others are waited for at their first use */
+    unsigned int shadersReady = 0;
+    for(ShaderProgram* program : {&sScene.shaderColor, &sScene.shaderNormal, &sScene.shaderFlagColor, &sScene.shaderFlagNormal, &sScene.shaderSkybox})
+    {
+        shadersReady += shaderReady(*program) ? 1 : 0;
+    }
+    ShaderCacheStats shaders = shaderCacheStats();
+    std::cout << "[Shader] " << programs.size() << " programs submitted in " << shaderTime * 1000.0 << " ms, " << shaders.hits
+              << " loaded from the binary cache, " << shadersReady << " ready after loading the assets, " << shaders.rejected
+              << " cached binaries rejected, " << shaders.savedSeconds * 1000.0 << " ms saved" << std::endl;
+
+    sScene.frameBlock = uniformBufferCreate(UNIFORM_BLOCK_FRAME, sizeof(FrameBlock));
+    sScene.lightBlock = uniformBufferCreate(UNIFORM_BLOCK_LIGHT, sizeof(LightBlock));
+
+    /* every material of the scene gets its element of the material table */
+    std::vector<Model*> models = {&sScene.plane.flag.model};
+    for(auto& model : sScene.plane.partModel)
+    {
+        models.push_back(&model);
+    }
+    for(auto& model : sScene.planet.partModel)
+    {
+        models.push_back(&model);
+    }
+    for(Model* model : models)
+    {
+        for(auto& material : model->material)
+        {
+            material.record = static_cast<unsigned int>(sScene.materials.size());
+            sScene.materials.push_back(&material);
+        }
+    }
+    if(sScene.materials.size() > MATERIAL_RECORDS)
+    {
+        throw std::runtime_error("[Scene] " + std::to_string(sScene.materials.size()) + " materials don't fit into the material table");
+    }
+    sScene.materialRecords.resize(MATERIAL_RECORDS);
+    sScene.materialTable = uniformBufferCreate(UNIFORM_BLOCK_MATERIAL, MATERIAL_RECORDS * sizeof(MaterialRecord));
+    sScene.drawRing = drawRingCreate(4);
 
     sScene.renderMode = eRenderMode::COLOR;
 }
@@ -291,18 +467,62 @@ void sceneUpdate(float dt)
     }
 }
 
+/* vertex decoding parameters of a mesh, compact meshes store quantized positions and octahedral normals */
+void shaderMeshUniforms(ShaderProgram& shader, const Mesh& mesh)
+{
+    shaderUniform(shader, "uPositionOffset", mesh.positionOffset);
+    shaderUniform(shader, "uPositionScale", mesh.positionScale);
+    shaderUniform(shader, "uOctNormals", mesh.format == VERTEX_FORMAT_COMPACT);
+}
+
+/* level of detail whose error stays below one pixel at the distance of the model's bounding sphere */
+unsigned int selectLod(const Model& model, const Matrix4D& transformation)
+{
+    Vector3D center = Vector3D(transformation * Vector4D(model.boundsCenter, 1.0f));
+    float scale = std::max({length(Vector3D(transformation[0])), length(Vector3D(transformation[1])), length(Vector3D(transformation[2]))});
+    float distance = std::max(length(center - cameraPosition(sScene.camera)) - model.boundsRadius * scale, sScene.camera.nearPlane);
+
+    /* pixels per world unit at distance 1 */
+    float projScale = sScene.camera.height / (2.0f * std::tan(sScene.camera.fov * 0.5f));
+    return modelSelectLod(model, distance / (projScale * scale));
+}
+
+/* binds the texture arrays of a material family to the units color.frag reads the maps from */
+void bindMaterialFamily(const MaterialFamily& family)
+{
+    for(unsigned int map = 0; map < MATERIAL_MAP_COUNT; map++)
+    {
+        glActiveTexture(GL_TEXTURE0 + map);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, family.maps[map].id);
+    }
+}
+
+/* texture unit of packed scalar maps, behind the map slots (see eMaterialMap) and the flag's displacement map */
+const int PACKED_MAP_UNIT = MATERIAL_MAP_COUNT + 1;
+
+/* binds the separate maps of a material that isn't part of texture arrays to the same units, the packed scalar maps
+ * behind them (color.frag with PACKED_MAPS) */
+void bindMaterialMaps(ShaderProgram& shader, Material& material)
+{
+    for(unsigned int map = 0; map < MATERIAL_MAP_COUNT; map++)
+    {
+        glActiveTexture(GL_TEXTURE0 + map);
+        glBindTexture(GL_TEXTURE_2D, materialMap(material, static_cast<eMaterialMap>(map)).id);
+    }
+    glActiveTexture(GL_TEXTURE0 + PACKED_MAP_UNIT);
+    glBindTexture(GL_TEXTURE_2D, material.map_packed.id);
+    shaderUniform(shader, "packedMaps", material.map_packed.id != 0);
+    shaderUniform(shader, "packedSpecular", material.packedSpecular);
+}
+
 /* 
  * function to render all objects in the scene using their diffuse colors or their normals
- * (depending on shader program and renderNormal flag)
+ * (depending on shader program and renderNormal flag, the color shader is color.frag with TEXTURE_ARRAYS, or with
+ * PACKED_MAPS if the maps are separate textures)
  */
 void renderColor(ShaderProgram& shader, bool renderNormal) {
-    /* setup camera and model matrices */
-    Matrix4D proj = cameraProjection(sScene.camera);
-    Matrix4D view = cameraView(sScene.camera);
-    glUseProgram(shader.id);
-    shaderUniform(shader, "uProj",  proj);
-    shaderUniform(shader, "uView",  view);
-    shaderUniform(shader, "uModel",  sScene.plane.transformation);
+    /* camera, light, model matrices and materials come from the uniform blocks (see sceneDraw) */
+    shaderUse(shader);
     /*
     if (renderNormal)
     {
@@ -311,16 +531,23 @@ void renderColor(ShaderProgram& shader, bool renderNormal) {
     }*/
 
    if (!renderNormal) {
-        shaderUniform(shader, "uCameraPos", cameraPosition(sScene.camera));
-
-        const SceneLight& light = sScene.isDay ? sScene.dayLight : sScene.nightLight;
-
-        shaderUniform(shader, "uLight.globalAmbientLightColor", light.globalAmbientLightColor);
-        shaderUniform(shader, "uLight.lightColor", light.lightColor);
-        shaderUniform(shader, "uLight.lightPos", light.lightPos);
-        shaderUniform(shader, "uLight.ka", light.ka);
-        shaderUniform(shader, "uLight.kd", light.kd);
-        shaderUniform(shader, "uLight.ks", light.ks);
+        /* texture units of the maps, see eMaterialMap */
+        shaderUniform(shader, "map_diffuse", MATERIAL_MAP_DIFFUSE);
+        shaderUniform(shader, "map_normal", MATERIAL_MAP_NORMAL);
+        shaderUniform(shader, "map_ambient", MATERIAL_MAP_AMBIENT);
+        shaderUniform(shader, "map_emission", MATERIAL_MAP_EMISSION);
+        shaderUniform(shader, "map_shininess", MATERIAL_MAP_SHININESS);
+        shaderUniform(shader, "map_specular", MATERIAL_MAP_SPECULAR);
+
+        /* the plane parts share their texture arrays and the draws only change layers, separate maps are bound per draw */
+        if (sScene.textureArrays)
+        {
+            bindMaterialFamily(sScene.plane.family);
+        }
+        else
+        {
+            shaderUniform(shader, "map_packed", PACKED_MAP_UNIT);
+        }
     }
 
     /* render plane */
@@ -330,99 +557,51 @@ void renderColor(ShaderProgram& shader, bool renderNormal) {
         auto& transform = sScene.plane.partTransformations[i];
 
         glBindVertexArray(model.mesh.vao);
+        shaderMeshUniforms(shader, model.mesh);
 
-        shaderUniform(shader, "uModel", sScene.plane.transformation * transform);
+        Matrix4D modelMatrix = sScene.plane.transformation * transform;
+        unsigned int lod = selectLod(model, modelMatrix);
+        Vector3D viewPosition = Vector3D(inverse(modelMatrix) * Vector4D(cameraPosition(sScene.camera), 1.0f));
 
+        if (!renderNormal)
+        {
+            bool hasSpecular = (i == 0);
+            shaderUniform(shader, "hasSpecular", hasSpecular);
+        }
         for(auto& material : model.material)
         {
-            if (!renderNormal)
+            if (!renderNormal && !sScene.textureArrays)
             {
-                /* set material properties */
-                shaderUniform(shader, "uMaterial.diffuse", material.diffuse);
-                shaderUniform(shader, "uMaterial.ambient", material.ambient);
-                shaderUniform(shader, "uMaterial.specular", material.specular);
-                shaderUniform(shader, "uMaterial.shininess", material.shininess);
-                shaderUniform(shader, "uMaterial.emission", material.emission);
-                /* Texture binding */
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, material.map_diffuse.id);
-                shaderUniform(shader, "map_diffuse", 0);
-
-                glActiveTexture(GL_TEXTURE1);
-                glBindTexture(GL_TEXTURE_2D, material.map_normal.id);
-                shaderUniform(shader, "map_normal", 1);
-
-                glActiveTexture(GL_TEXTURE2);
-                glBindTexture(GL_TEXTURE_2D, material.map_ambient.id);
-                shaderUniform(shader, "map_ambient", 2);
-
-                glActiveTexture(GL_TEXTURE3);
-                glBindTexture(GL_TEXTURE_2D, material.map_emission.id);
-                shaderUniform(shader, "map_emission", 3);
-
-                glActiveTexture(GL_TEXTURE4);
-                glBindTexture(GL_TEXTURE_2D, material.map_shininess.id);
-                shaderUniform(shader, "map_shininess", 4);
-
-                bool hasSpecular = (i == 0);
-                shaderUniform(shader, "hasSpecular", hasSpecular);
-
-                if (hasSpecular) {
-                    glActiveTexture(GL_TEXTURE5);
-                    glBindTexture(GL_TEXTURE_2D, material.map_specular.id);
-                    shaderUniform(shader, "map_specular", 5);
-                }
+                bindMaterialMaps(shader, material);
             }
-            glDrawElements(GL_TRIANGLES, material.indexCount, GL_UNSIGNED_INT, (const void*) (material.indexOffset*sizeof(unsigned int)) );
+            unsigned int record = drawRingPush(sScene.drawRing, modelMatrix, material.record);
+            modelDrawCulled(model, material, viewPosition, lod, record);
         }
     }
 
 
-    /* render planet */
+    /* render planet: one bind for all of its parts as well */
+    if (!renderNormal && sScene.textureArrays)
+    {
+        bindMaterialFamily(sScene.planet.family);
+    }
     for(unsigned int i=0; i < sScene.planet.partModel.size(); i++)
     {
         auto& model = sScene.planet.partModel[i];
         glBindVertexArray(model.mesh.vao);
+        shaderMeshUniforms(shader, model.mesh);
 
-        shaderUniform(shader, "uModel", sScene.planet.transformation);
+        unsigned int lod = selectLod(model, sScene.planet.transformation);
+        Vector3D viewPosition = Vector3D(inverse(sScene.planet.transformation) * Vector4D(cameraPosition(sScene.camera), 1.0f));
 
         for(auto& material : model.material)
         {
-            if (!renderNormal)
+            if (!renderNormal && !sScene.textureArrays)
             {
-                /* set material properties */
-                shaderUniform(shader, "uMaterial.diffuse", material.diffuse);
-                shaderUniform(shader, "uMaterial.ambient", material.ambient);
-                shaderUniform(shader, "uMaterial.specular", material.specular);
-                shaderUniform(shader, "uMaterial.shininess", material.shininess);
-                shaderUniform(shader, "uMaterial.emission", material.emission);
-
-                /* Texture binding */
-                glActiveTexture(GL_TEXTURE0);
-                glBindTexture(GL_TEXTURE_2D, material.map_diffuse.id);
-                shaderUniform(shader, "map_diffuse", 0);
-
-                glActiveTexture(GL_TEXTURE1);
-                glBindTexture(GL_TEXTURE_2D, material.map_normal.id);
-                shaderUniform(shader, "map_normal", 1);
-
-                glActiveTexture(GL_TEXTURE2);
-                glBindTexture(GL_TEXTURE_2D, material.map_ambient.id);
-                shaderUniform(shader, "map_ambient", 2);
-
-                glActiveTexture(GL_TEXTURE3);
-                glBindTexture(GL_TEXTURE_2D, material.map_emission.id);
-                shaderUniform(shader, "map_emission", 3);
-
-                glActiveTexture(GL_TEXTURE4);
-                glBindTexture(GL_TEXTURE_2D, material.map_shininess.id);
-                shaderUniform(shader, "map_shininess", 4);
-
-                glActiveTexture(GL_TEXTURE5);
-                glBindTexture(GL_TEXTURE_2D, material.map_specular.id);
-                shaderUniform(shader, "map_specular", 5);
+                bindMaterialMaps(shader, material);
             }
-            glDrawElements(GL_TRIANGLES, material.indexCount, GL_UNSIGNED_INT, (const void*) (material.indexOffset*sizeof(unsigned int)) );
+            unsigned int record = drawRingPush(sScene.drawRing, sScene.planet.transformation, material.record);
+            modelDrawCulled(model, material, viewPosition, lod, record);
         }
     }
 
@@ -432,38 +611,27 @@ void renderColor(ShaderProgram& shader, bool renderNormal) {
 }
 
 void renderFlag(ShaderProgram& shader, bool renderNormal) {
-    Matrix4D proj = cameraProjection(sScene.camera);
-    Matrix4D view = cameraView(sScene.camera);
+    /* camera, light and model matrix come from the uniform blocks (see sceneDraw) */
+    shaderUse(shader);
 
-    glUseProgram(shader.id);
-
-    shaderUniform(shader, "uProj", proj);
-    shaderUniform(shader, "uView", view);
-    shaderUniform(shader, "uModel", sScene.plane.transformation *
-                                   sScene.plane.flagModelMatrix *
-                                   sScene.plane.flagNegativeRotation);
-
-    if (!renderNormal) {
-        shaderUniform(shader, "uCameraPos", cameraPosition(sScene.camera));
-
-        const SceneLight& light = sScene.isDay ? sScene.dayLight : sScene.nightLight;
-
-        shaderUniform(shader, "uLight.globalAmbientLightColor", light.globalAmbientLightColor);
-        shaderUniform(shader, "uLight.lightColor", light.lightColor);
-        shaderUniform(shader, "uLight.lightPos", light.lightPos);
-        shaderUniform(shader, "uLight.ka", light.ka);
-        shaderUniform(shader, "uLight.kd", light.kd);
-        shaderUniform(shader, "uLight.ks", light.ks);
-    }
+    Matrix4D modelMatrix = sScene.plane.transformation * sScene.plane.flagModelMatrix * sScene.plane.flagNegativeRotation;
 
     glBindVertexArray(sScene.plane.flag.model.mesh.vao);
+    shaderMeshUniforms(shader, sScene.plane.flag.model.mesh);
 
+    /* one call per wave parameter array */
+    float amplitudes[3], phases[3], frequencies[3];
+    Vector2D directions[3];
     for (int i = 0; i < 3; ++i) {
-        shaderUniform(shader, "amplitudes[" + std::to_string(i) + "]", sScene.plane.flagSim.parameter[i].amplitude);
-        shaderUniform(shader, "phases[" + std::to_string(i) + "]", sScene.plane.flagSim.parameter[i].phi);
-        shaderUniform(shader, "frequencies[" + std::to_string(i) + "]", sScene.plane.flagSim.parameter[i].omega);
-        shaderUniform(shader, "directions[" + std::to_string(i) + "]", sScene.plane.flagSim.parameter[i].direction);
+        amplitudes[i] = sScene.plane.flagSim.parameter[i].amplitude;
+        phases[i] = sScene.plane.flagSim.parameter[i].phi;
+        frequencies[i] = sScene.plane.flagSim.parameter[i].omega;
+        directions[i] = sScene.plane.flagSim.parameter[i].direction;
     }
+    shaderUniform(shader, "amplitudes", amplitudes, 3);
+    shaderUniform(shader, "phases", phases, 3);
+    shaderUniform(shader, "frequencies", frequencies, 3);
+    shaderUniform(shader, "directions", directions, 3);
 
     shaderUniform(shader, "zPosMin", sScene.plane.flag.minPosZ);
     shaderUniform(shader, "accumTime", sScene.plane.flagSim.accumTime);
@@ -474,41 +642,36 @@ void renderFlag(ShaderProgram& shader, bool renderNormal) {
     shaderUniform(shader, "displacementScale", 0.1f);
 
 
-    for (const auto& material : sScene.plane.flag.model.material) {
+    if (!renderNormal) {
+        /* texture units of the maps, see eMaterialMap */
+        shaderUniform(shader, "map_diffuse", MATERIAL_MAP_DIFFUSE);
+        shaderUniform(shader, "map_normal", MATERIAL_MAP_NORMAL);
+        shaderUniform(shader, "map_ambient", MATERIAL_MAP_AMBIENT);
+        shaderUniform(shader, "map_emission", MATERIAL_MAP_EMISSION);
+        shaderUniform(shader, "map_shininess", MATERIAL_MAP_SHININESS);
+        shaderUniform(shader, "map_specular", MATERIAL_MAP_SPECULAR);
+
+        /* the flag is a family of its own, its draws only pick layers like the plane's */
+        if (sScene.textureArrays)
+        {
+            bindMaterialFamily(sScene.plane.flag.family);
+        }
+        else
+        {
+            shaderUniform(shader, "map_packed", PACKED_MAP_UNIT);
+        }
+    }
+
+    for (auto& material : sScene.plane.flag.model.material) {
         if (!renderNormal) {
-            shaderUniform(shader, "uMaterial.ambient", material.ambient);
-            shaderUniform(shader, "uMaterial.diffuse", material.diffuse);
-            shaderUniform(shader, "uMaterial.specular", material.specular);
-            shaderUniform(shader, "uMaterial.shininess", material.shininess);
-            /* Texture binding */
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, material.map_diffuse.id);
-            shaderUniform(shader, "map_diffuse", 0);
-
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, material.map_normal.id);
-            shaderUniform(shader, "map_normal", 1);
-
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, material.map_ambient.id);
-            shaderUniform(shader, "map_ambient", 2);
-
-            glActiveTexture(GL_TEXTURE3);
-            glBindTexture(GL_TEXTURE_2D, material.map_emission.id);
-            shaderUniform(shader, "map_emission", 3);
-
-            glActiveTexture(GL_TEXTURE4);
-            glBindTexture(GL_TEXTURE_2D, material.map_shininess.id);
-            shaderUniform(shader, "map_shininess", 4);
-
-            glActiveTexture(GL_TEXTURE5);
-            glBindTexture(GL_TEXTURE_2D, material.map_specular.id);
-            shaderUniform(shader, "map_specular", 5);
+            if (!sScene.textureArrays) {
+                bindMaterialMaps(shader, material);
+            }
         } else {
             shaderUniform(shader, "isFlag", true);
         }
-        glDrawElements(GL_TRIANGLES, material.indexCount, GL_UNSIGNED_INT,
-                       (const void*)(material.indexOffset * sizeof(unsigned int)));
+        unsigned int record = drawRingPush(sScene.drawRing, modelMatrix, material.record);
+        modelDraw(sScene.plane.flag.model, material, 0, record);
     }
 
     /* cleanup opengl state */
@@ -523,7 +686,31 @@ void sceneDraw()
     glClearColor(135.0 / 255, 206.0 / 255, 235.0 / 255, 1.0);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    /* camera and light of this frame, one upload each for all programs */
+    Matrix4D proj = cameraProjection(sScene.camera);
+    Matrix4D view = cameraView(sScene.camera);
+    FrameBlock frame{view, proj, proj * view, cameraPosition(sScene.camera), static_cast<float>(glfwGetTime())};
+    uniformBufferUpdate(sScene.frameBlock, &frame);
+
+    const SceneLight& sceneLight = sScene.isDay ? sScene.dayLight : sScene.nightLight;
+    LightBlock light;
+    light.lightPos = sceneLight.lightPos;
+    light.globalAmbientLightColor = sceneLight.globalAmbientLightColor;
+    light.lightColor = sceneLight.lightColor;
+    light.ka = sceneLight.ka;
+    light.kd = sceneLight.kd;
+    light.ks = sceneLight.ks;
+    uniformBufferUpdate(sScene.lightBlock, &light);
+
+    /* the materials change with the lights of the plane, the table is small enough to upload as a whole */
+    for(std::size_t i = 0; i < sScene.materials.size(); i++)
+    {
+        sScene.materialRecords[i] = materialRecord(*sScene.materials[i]);
+    }
+    uniformBufferUpdate(sScene.materialTable, sScene.materialRecords.data());
+
     /*------------ render scene -------------*/
+    drawRingBegin(sScene.drawRing);
     {
         if (sScene.renderMode == eRenderMode::COLOR)
         {
@@ -535,7 +722,14 @@ void sceneDraw()
             renderColor(sScene.shaderNormal, true);
             renderFlag(sScene.shaderFlagNormal, true);
         }
+
+        /* the sky last, it only shades the pixels the opaque geometry left empty */
+        if (sScene.skybox.texture.id != 0)
+        {
+            skyboxDraw(sScene.skybox, sScene.shaderSkybox, view, proj);
+        }
     }
+    drawRingEnd(sScene.drawRing);
     glCheckError();
 
     /* cleanup opengl state */
@@ -564,12 +758,17 @@ int main(int argc, char **argv)
     /*---------- init opengl stuff ------------*/
     glEnable(GL_DEPTH_TEST);
 
+    /* filter across the edges of cube map faces (the sky) instead of clamping within each face */
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
     /* setup scene */
     sceneInit(static_cast<float>(width), static_cast<float>(height));
 
     /*-------------- main loop ----------------*/
     double timeStamp = glfwGetTime();
     double timeStampNew = 0.0;
+    double streamStart = timeStamp;
+    unsigned int streamFrames = 0;
 
     /* loop until user closes window */
     while (!glfwWindowShouldClose(window))
@@ -577,6 +776,18 @@ int main(int argc, char **argv)
         /* poll and process input and window events */
         glfwPollEvents();
 
+        /* bring in the next piece of the larger texture levels within the per-frame upload budget */
+        if(textureStreamPending() > 0)
+        {
+            textureStreamUpdate();
+            streamFrames++;
+            if(textureStreamPending() == 0)
+            {
+                std::cout << "[Texture] streamed " << textureCacheStats().streamedBytes / (1024 * 1024) << " MB in " << streamFrames << " frames ("
+                          << (glfwGetTime() - streamStart) * 1000.0 << " ms)" << std::endl;
+            }
+        }
+
         /* update model matrix of cube */
         timeStampNew = glfwGetTime();
         sceneUpdate(static_cast<float>(timeStampNew - timeStamp));
@@ -590,11 +801,22 @@ int main(int argc, char **argv)
     }
 
     /*-------- cleanup --------*/
+    std::cout << "[DrawRing] " << sScene.drawRing.stalls << " frames waited for the GPU to release their draw records" << std::endl;
+
     /* delete opengl shader and buffers */
     shaderDelete(sScene.shaderColor);
     shaderDelete(sScene.shaderNormal);
+    shaderDelete(sScene.shaderSkybox);
+    uniformBufferDelete(sScene.frameBlock);
+    uniformBufferDelete(sScene.lightBlock);
+    uniformBufferDelete(sScene.materialTable);
+    drawRingDelete(sScene.drawRing);
     planeDelete(sScene.plane);
     planetDelete(sScene.planet);
+    if (sScene.skybox.texture.id != 0)
+    {
+        skyboxDelete(sScene.skybox);
+    }
 
     /* cleanup glfw/glcontext */
     windowDelete(window);
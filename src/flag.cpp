@@ -32,14 +32,22 @@ Flag flagCreate(const std::string& flagFilePath)
     flag.flag_displacement = textureLoad("assets/flag/textures/Flag_Displacement.png");
 
     for (auto& material : flag.model.material){
-        material.map_diffuse = textureLoad("assets/flag/textures/Flag_Albedo.png");
-        material.map_emission = textureLoad("assets/flag/textures/Cessna_Flag_Emission.png");
-        material.map_ambient = textureLoad("assets/flag/textures/Flag_AO.png");
-        material.map_normal = textureLoad("assets/flag/textures/Flag_Normals.png");
-        material.map_specular = textureLoad("assets/flag/textures/Flag_Specular_Color.png");
-        material.map_shininess = textureLoad("assets/flag/textures/Flag_Specular.png");
+        textureReplace(material.map_diffuse, "assets/flag/textures/Flag_Albedo.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+        textureReplace(material.map_emission, "assets/flag/textures/Cessna_Flag_Emission.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
+        textureReplace(material.map_ambient, "assets/flag/textures/Flag_AO.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+        textureReplace(material.map_normal, "assets/flag/textures/Flag_Normals.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+        textureReplace(material.map_specular, "assets/flag/textures/Flag_Specular_Color.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
+        textureReplace(material.map_shininess, "assets/flag/textures/Flag_Specular.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
     }
 
+    /* one texture array per map slot like the plane and planet, so drawing the flag doesn't bind its maps one by one */
+    std::vector<Material*> materials;
+    for (auto& material : flag.model.material)
+    {
+        materials.push_back(&material);
+    }
+    flag.family = materialFamilyPrepare(materials);
+
     flag.minPosZ = -8.0f;
 
     return flag;
@@ -48,6 +56,8 @@ Flag flagCreate(const std::string& flagFilePath)
 void flagDelete(Flag &flag)
 {
     modelDelete(flag.model); // already includes texture delete
+    textureDelete(flag.flag_displacement);
+    materialFamilyDelete(flag.family);
 }
 
 void updateSimulation(FlagSim& flagSim, float speedFactor, float dt)
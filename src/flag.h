@@ -32,6 +32,9 @@ struct Flag {
     Model model;
     Texture flag_displacement;
 
+    /* texture arrays of the flag's material, a family of its own */
+    MaterialFamily family;
+
     float minPosZ;
 };
 
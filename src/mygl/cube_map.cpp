@@ -1,10 +1,12 @@
 #include "cube_map.h"
+#include "texture.h"
+#include "image_cache.h"
+#include "texture_compress.h"
+#include "thread_pool.h"
 
 #include <stdexcept>
 #include <iostream>
 
-#include <stb_image/stb_image.h>
-
 MeshCubeMap meshCubeMapCreate(const std::vector<Vector3D> &vertices, const std::vector<unsigned int> &indices)
 {
     GLuint vao = 0, vbo = 0, ebo = 0;
@@ -42,50 +44,84 @@ void meshCubeMapDelete(const MeshCubeMap &mesh)
     glDeleteVertexArrays(1, &mesh.vao);
 }
 
-TextureCube textureCubeLoad(const std::array<std::string, 6>& image_paths)
+TextureCube textureCubeLoad(const std::array<std::string, 6>& image_paths, int priority)
 {
-    int width = 0, height = 0, components = 0;
+    /* decode all faces concurrently, or read them from the texture disk cache (cube map faces are not flipped). The
+     * faces are compressed like color textures, but all of them need the same block format */
+    std::array<ImageMips, 6> faces;
+    auto load = [&](eTextureUsage usage) {
+        parallelFor(faces.size(), [&](std::size_t i) { faces[i] = imageLoadMips(image_paths[i], usage, false); });
+    };
+    load(textureCompressionSupported() ? TEXTURE_USAGE_COLOR : TEXTURE_USAGE_DATA);
+    for (auto i=1u; i<faces.size(); i++)
+    {
+        if (faces[i].format != faces[0].format)
+        {
+            load(TEXTURE_USAGE_DATA);
+            break;
+        }
+    }
+    for (auto i=1u; i<faces.size(); i++)
+    {
+        if (faces[i].levels[0].width != faces[0].levels[0].width || faces[i].levels[0].height != faces[0].levels[0].height)
+        {
+            std::cerr << "[TextureCube] faces of " << image_paths[0] << " differ in size" << std::endl;
+            throw std::runtime_error("[TextureCube] faces of " + image_paths[0] + " differ in size");
+        }
+    }
 
-    /* flip image to match opengl's texture coordinates */
-    stbi_set_flip_vertically_on_load(false);
+    /* all six faces count against the texture budget, which may leave out their top levels */
+    const eTextureFormat format = faces[0].format;
+    const std::vector<ImageLevel>& levels = faces[0].levels;
+    std::vector<std::size_t> levelBytes(levels.size());
+    for (auto level=0u; level<levels.size(); level++)
+    {
+        levelBytes[level] = textureFormatSize(format, levels[level].width, levels[level].height) * faces.size();
+    }
+    unsigned int skip = textureBudgetFit(levelBytes, levels[0].width, levels[0].height, priority);
 
     GLuint id = 0;
     glGenTextures(1, &id);
     glBindTexture(GL_TEXTURE_CUBE_MAP, id);
 
-    for (auto i=0u; i<image_paths.size(); i++)
+    for (auto i=0u; i<faces.size(); i++)
     {
-        /* load image */
-        unsigned char* data = stbi_load(image_paths[i].c_str(), &width, &height, &components, 4);
-        if (data == nullptr)
+        /* upload data */
+        for (auto level=skip; level<faces[i].levels.size(); level++)
         {
-            std::cerr << "[TextureCube] couldn't load image file " << image_paths[i] << std::endl;
-            std::cerr.flush();
-            stbi_image_free(data);
-            glDeleteTextures(1, &id);
-            throw std::runtime_error("[TextureCube] couldn't load image file " + image_paths[i]);
+            const ImageLevel& face = faces[i].levels[level];
+            if (format == TEXTURE_FORMAT_RGBA8)
+            {
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level - skip, GL_RGBA8, face.width, face.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, face.pixels);
+            }
+            else
+            {
+                glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level - skip, textureInternalFormat(format), face.width, face.height, 0,
+                                       (GLsizei) textureFormatSize(format, face.width, face.height), face.pixels);
+            }
         }
-        /* upload data */
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
         glCheckError();
-        stbi_image_free(data);
     }
 
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, (GLint) (levels.size() - skip) - 1);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glCheckError();
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
 
-    return TextureCube{id, (unsigned int) width, (unsigned int) height};
+    TextureCube texture{id, levels[0].width, levels[0].height};
+    textureTrack(Texture{id, texture.width, texture.height}, image_paths[0], levelBytes, skip, priority);
+    return texture;
 }
 
 void textureCubeDelete(const TextureCube& texture)
 {
-    glDeleteTextures(1, &texture.id);
+    /* tracked like the 2D textures, so the budget gets the room back */
+    textureDelete(Texture{texture.id, texture.width, texture.height});
 }
 
 CubeMap cubeMapCreate(const std::vector<Vector3D>& vertices, const std::vector<unsigned int>& indices, const std::array<std::string, 6>& image_paths)
@@ -100,3 +136,44 @@ void cubeMapDelete(const CubeMap& cubeMap)
     meshCubeMapDelete(cubeMap.mesh);
     textureCubeDelete(cubeMap.texture);
 }
+
+Skybox skyboxCreate(const std::array<std::string, 6>& image_paths)
+{
+    Skybox skybox;
+    skybox.texture = textureCubeLoad(image_paths);
+
+    /* core profile needs a vertex array object even for a draw without attributes */
+    glGenVertexArrays(1, &skybox.vao);
+    glCheckError();
+    return skybox;
+}
+
+void skyboxDraw(const Skybox& skybox, ShaderProgram& shader, const Matrix4D& view, const Matrix4D& proj)
+{
+    /* the sky is infinitely far away, so only the rotation of the camera matters */
+    Matrix4D rotation = Matrix4D(Matrix3D(view));
+    shaderUse(shader);
+    shaderUniform(shader, "uInvViewProj", inverse(proj * rotation));
+    shaderUniform(shader, "uSky", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, skybox.texture.id);
+
+    /* the triangle lies exactly on the far plane: pixels covered by geometry fail the depth test before shading */
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(skybox.vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+    glCheckError();
+
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    glUseProgram(0);
+}
+
+void skyboxDelete(const Skybox& skybox)
+{
+    glDeleteVertexArrays(1, &skybox.vao);
+    textureCubeDelete(skybox.texture);
+}
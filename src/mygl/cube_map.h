@@ -1,6 +1,8 @@
 #pragma once
 
 #include "base.h"
+#include "shader.h"
+#include "texture.h"
 
 #include <vector>
 #include <array>
@@ -37,13 +39,15 @@ struct TextureCube
 };
 
 /**
- * @brief Initialize OpenGL cube map texture and load it from file.
+ * @brief Initialize OpenGL cube map texture and load it from file. The six faces are decoded concurrently (or read
+ * from the texture disk cache) with their mip chains and compressed like color textures where supported.
  *
- * @param path Path to folder containing texture files. They need to be 
+ * @param image_paths Paths to the face images in the order +x, -x, +y, -y, +z, -z, all of the same size.
+ * @param priority Importance for the texture budget (see textureSetBudget), which may leave out top mip levels.
  *
  * @return Initialized texture object.
  */
-TextureCube textureCubeLoad(const std::array<std::string, 6>& image_paths);
+TextureCube textureCubeLoad(const std::array<std::string, 6>& image_paths, int priority = TEXTURE_PRIORITY_PRIMARY);
 /**
  * @brief Delete texture cube object. Has to be called for each texture after it is not used anymore.
  *
@@ -61,3 +65,38 @@ struct CubeMap
 CubeMap cubeMapCreate(const std::vector<Vector3D>& vertices, const std::vector<unsigned int>& indices, const std::array<std::string, 6>& image_paths);
 
 void cubeMapDelete(const CubeMap& cubeMap);
+
+/* sky behind everything else: a cube map drawn as a single full-screen triangle at the far plane */
+struct Skybox
+{
+    TextureCube texture;
+    GLuint vao = 0;     // without attributes, the triangle comes from gl_VertexID
+};
+
+/**
+ * @brief Loads the faces of a sky cube map (see textureCubeLoad) and prepares drawing it.
+ *
+ * @param image_paths Paths to the face images in the order +x, -x, +y, -y, +z, -z.
+ *
+ * @return Skybox, throws if a face can't be loaded.
+ */
+Skybox skyboxCreate(const std::array<std::string, 6>& image_paths);
+
+/**
+ * @brief Draws the sky after all opaque geometry: one full-screen triangle at the far plane with a less-or-equal
+ * depth test and without depth writes, so only pixels no geometry covered are shaded. The shader (skybox.vert/.frag)
+ * turns screen positions into view directions with the inverse of the projection and the camera rotation.
+ *
+ * @param skybox Skybox to draw.
+ * @param shader Skybox shader program.
+ * @param view View matrix of the camera, its translation is ignored.
+ * @param proj Projection matrix of the camera.
+ */
+void skyboxDraw(const Skybox& skybox, ShaderProgram& shader, const Matrix4D& view, const Matrix4D& proj);
+
+/**
+ * @brief Deletes the cube map and vertex array of a skybox.
+ *
+ * @param skybox Skybox to delete.
+ */
+void skyboxDelete(const Skybox& skybox);
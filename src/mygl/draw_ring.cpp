@@ -0,0 +1,200 @@
+#include "draw_ring.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace detail
+{
+
+/* a window is exactly one DrawBlock, its offsets stay multiples of any uniform buffer offset alignment */
+const std::size_t DRAW_WINDOW_SIZE = DRAW_RECORDS * sizeof(DrawRecord);
+
+std::size_t drawRingOffset(const DrawRing& ring, unsigned int window)
+{
+    return (static_cast<std::size_t>(ring.segment) * ring.windows + window) * DRAW_WINDOW_SIZE;
+}
+
+void drawRingBind(const DrawRing& ring)
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_DRAW, ring.buffer, static_cast<GLintptr>(drawRingOffset(ring, ring.window)), DRAW_WINDOW_SIZE);
+}
+
+}
+
+DrawRing drawRingCreate(unsigned int windows)
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if(alignment <= 0 || detail::DRAW_WINDOW_SIZE % static_cast<std::size_t>(alignment) != 0)
+    {
+        throw std::runtime_error("[DrawRing] uniform buffer offset alignment " + std::to_string(alignment) + " doesn't divide the window size");
+    }
+
+    DrawRing ring;
+    ring.windows = windows;
+    GLsizeiptr size = static_cast<GLsizeiptr>(DRAW_RING_SEGMENTS * windows * detail::DRAW_WINDOW_SIZE);
+
+    glGenBuffers(1, &ring.buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+    if(GLAD_GL_ARB_buffer_storage)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+        ring.mapped = static_cast<char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags));
+    }
+    else
+    {
+        std::cerr << "[DrawRing] GL_ARB_buffer_storage not supported, uploading draw records one by one" << std::endl;
+        glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glCheckError();
+
+    return ring;
+}
+
+void drawRingBegin(DrawRing& ring)
+{
+    GLsync& fence = ring.fences[ring.segment];
+    if(fence)
+    {
+        if(glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            ring.stalls++;
+            while(glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            {
+            }
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    ring.window = 0;
+    ring.count = 0;
+    detail::drawRingBind(ring);
+}
+
+unsigned int drawRingPush(DrawRing& ring, const Matrix4D& model, unsigned int material)
+{
+    if(ring.count == DRAW_RECORDS)
+    {
+        if(ring.window + 1 == ring.windows)
+        {
+            throw std::runtime_error("[DrawRing] more than " + std::to_string(ring.windows * DRAW_RECORDS) + " draws in one frame");
+        }
+        ring.window++;
+        ring.count = 0;
+        detail::drawRingBind(ring);
+    }
+
+    DrawRecord record;
+    record.model = model;
+    Matrix3D inv = inverse(Matrix3D(model));
+    for(int j = 0; j < 3; j++)
+    {
+        record.normal[j] = Vector4D(inv(j, 0), inv(j, 1), inv(j, 2), 0.0f);
+    }
+    record.material = static_cast<int>(material);
+
+    std::size_t offset = detail::drawRingOffset(ring, ring.window) + ring.count * sizeof(DrawRecord);
+    if(ring.mapped)
+    {
+        std::memcpy(ring.mapped + offset, &record, sizeof(record));
+    }
+    else
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, static_cast<GLintptr>(offset), sizeof(record), &record);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    return ring.count++;
+}
+
+void drawRingEnd(DrawRing& ring)
+{
+    /* without a persistent mapping the driver orders the uploads itself */
+    if(ring.mapped)
+    {
+        ring.fences[ring.segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    ring.segment = (ring.segment + 1) % DRAW_RING_SEGMENTS;
+}
+
+void drawRingDelete(DrawRing& ring)
+{
+    for(GLsync& fence : ring.fences)
+    {
+        if(fence)
+        {
+            glDeleteSync(fence);
+        }
+    }
+    if(ring.mapped)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, ring.buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &ring.buffer);
+    ring = DrawRing{};
+}
+
+bool drawRingBaseInstance()
+{
+    return GLAD_GL_ARB_base_instance && GLAD_GL_ARB_instanced_arrays;
+}
+
+void drawRingAttach()
+{
+    if(!drawRingBaseInstance())
+    {
+        return;
+    }
+
+    /* shared by all vertex arrays for the lifetime of the context */
+    static GLuint ids = 0;
+    if(ids == 0)
+    {
+        std::vector<GLint> values(DRAW_RECORDS);
+        for(unsigned int i = 0; i < DRAW_RECORDS; i++)
+        {
+            values[i] = static_cast<GLint>(i);
+        }
+        glGenBuffers(1, &ids);
+        glBindBuffer(GL_ARRAY_BUFFER, ids);
+        glBufferData(GL_ARRAY_BUFFER, values.size() * sizeof(GLint), values.data(), GL_STATIC_DRAW);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, ids);
+    glEnableVertexAttribArray(eDataIdx::DrawID);
+    glVertexAttribIPointer(eDataIdx::DrawID, 1, GL_INT, sizeof(GLint), nullptr);
+    glVertexAttribDivisorARB(eDataIdx::DrawID, 1);
+}
+
+void drawRingElements(GLenum type, GLsizei count, const void* offset, unsigned int record)
+{
+    if(drawRingBaseInstance())
+    {
+        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, count, type, offset, 1, record);
+    }
+    else
+    {
+        glVertexAttribI1i(eDataIdx::DrawID, static_cast<GLint>(record));
+        glDrawElements(GL_TRIANGLES, count, type, offset);
+    }
+}
+
+MaterialRecord materialRecord(const Material& material)
+{
+    MaterialRecord record;
+    record.diffuse = material.diffuse;
+    record.shininess = material.shininess;
+    record.ambient = material.ambient;
+    record.specular = material.specular;
+    record.emission = material.emission;
+    materialLayers(material, record.layers);
+    return record;
+}
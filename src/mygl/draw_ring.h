@@ -0,0 +1,102 @@
+#pragma once
+
+#include "model.h"
+#include "uniform_buffer.h"
+
+/* frames the CPU may run ahead of the GPU, each owns one segment of the ring */
+#define DRAW_RING_SEGMENTS 3
+
+/* per draw records of the frames in flight: one persistently mapped buffer of DRAW_RING_SEGMENTS segments, each
+   split into windows of DRAW_RECORDS records that are bound to UNIFORM_BLOCK_DRAW in turn */
+struct DrawRing
+{
+    GLuint buffer = 0;
+    char* mapped = nullptr;     // nullptr without GL_ARB_buffer_storage, records are uploaded one by one then
+    unsigned int windows = 0;   // windows per segment
+
+    unsigned int segment = 0;   // segment of the current frame
+    unsigned int window = 0;    // window of the segment bound to UNIFORM_BLOCK_DRAW
+    unsigned int count = 0;     // records written to the window
+    GLsync fences[DRAW_RING_SEGMENTS] = {};
+
+    unsigned int stalls = 0;    // frames that had to wait for the GPU to release their segment
+};
+
+/**
+ * @brief Creates a draw ring. With GL_ARB_buffer_storage the whole buffer is mapped once (persistent and coherent),
+ * records are then plain memory writes.
+ *
+ * @param windows Windows of DRAW_RECORDS records per frame, the most draws a frame can issue is windows * DRAW_RECORDS.
+ *
+ * @return Draw ring.
+ */
+DrawRing drawRingCreate(unsigned int windows);
+
+/**
+ * @brief Starts the records of a frame: waits until the GPU is done with the frame that used the segment last and
+ * binds its first window.
+ *
+ * @param ring Draw ring.
+ */
+void drawRingBegin(DrawRing& ring);
+
+/**
+ * @brief Writes the record of the next draw, moving on to the next window when the current one is full.
+ *
+ * @param ring Draw ring.
+ * @param model Model matrix, the normal matrix is derived from it.
+ * @param material Element of the material table (Material::record).
+ *
+ * @return Index of the record in the bound window, to pass as record to modelDraw.
+ *
+ * @throws std::runtime_error If the frame issues more draws than the segment holds.
+ */
+unsigned int drawRingPush(DrawRing& ring, const Matrix4D& model, unsigned int material);
+
+/**
+ * @brief Ends the records of a frame and fences its segment.
+ *
+ * @param ring Draw ring.
+ */
+void drawRingEnd(DrawRing& ring);
+
+/**
+ * @brief Deletes a draw ring. Has to be called for each draw ring after it is not used anymore.
+ *
+ * @param ring Draw ring to delete.
+ */
+void drawRingDelete(DrawRing& ring);
+
+/**
+ * @brief Whether draws select their record through the base instance (GL_ARB_base_instance together with
+ * GL_ARB_instanced_arrays) or through a constant draw ID attribute.
+ *
+ * @return True if the draw ID attribute is instanced.
+ */
+bool drawRingBaseInstance();
+
+/**
+ * @brief Adds the draw ID attribute (eDataIdx::DrawID) to the bound vertex array: an instanced attribute over the
+ * indices 0..DRAW_RECORDS-1, so the base instance of a draw selects its record. Without GL_ARB_base_instance the
+ * attribute stays disabled and draws set it as a constant instead (see drawRingElements).
+ */
+void drawRingAttach();
+
+/**
+ * @brief Draws triangles from the bound index buffer with a record of the bound window.
+ *
+ * @param type Index type.
+ * @param count Number of indices.
+ * @param offset Byte offset into the index buffer.
+ * @param record Index of the record in the bound window (see drawRingPush).
+ */
+void drawRingElements(GLenum type, GLsizei count, const void* offset, unsigned int record);
+
+/**
+ * @brief Record of a material for the material table.
+ *
+ * @param material Material (of a family, see materialFamilyCreate, for its layers).
+ *
+ * @return Material record.
+ */
+MaterialRecord materialRecord(const Material& material);
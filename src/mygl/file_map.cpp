@@ -0,0 +1,368 @@
+#include "file_map.h"
+#include "hash.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileMap::FileMap(FileMap&& other) noexcept
+    : data(std::exchange(other.data, nullptr)),
+      size(std::exchange(other.size, 0)),
+      _mapping(std::exchange(other._mapping, nullptr)),
+      _file(std::exchange(other._file, nullptr))
+{
+
+}
+
+FileMap& FileMap::operator =(FileMap&& other) noexcept
+{
+    if(this != &other)
+    {
+        fileMapClose(*this);
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+        _mapping = std::exchange(other._mapping, nullptr);
+        _file = std::exchange(other._file, nullptr);
+    }
+    return *this;
+}
+
+FileMap::~FileMap()
+{
+    fileMapClose(*this);
+}
+
+ScratchMap::ScratchMap(ScratchMap&& other) noexcept
+    : data(std::exchange(other.data, nullptr)),
+      size(std::exchange(other.size, 0)),
+      _mapping(std::exchange(other._mapping, nullptr)),
+      _file(std::exchange(other._file, nullptr))
+{
+
+}
+
+ScratchMap& ScratchMap::operator =(ScratchMap&& other) noexcept
+{
+    if(this != &other)
+    {
+        scratchMapClose(*this);
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+        _mapping = std::exchange(other._mapping, nullptr);
+        _file = std::exchange(other._file, nullptr);
+    }
+    return *this;
+}
+
+ScratchMap::~ScratchMap()
+{
+    scratchMapClose(*this);
+}
+
+#ifdef _WIN32
+
+FileMap fileMapOpen(const std::string& path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("[FileMap] Couldn't open file at " + path);
+    }
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        throw std::runtime_error("[FileMap] Couldn't query size of file " + path);
+    }
+
+    FileMap map;
+    map._file = file;
+    if(size.QuadPart == 0)
+    {
+        return map;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mapping == nullptr)
+    {
+        throw std::runtime_error("[FileMap] Couldn't map file " + path);
+    }
+    map._mapping = mapping;
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(view == nullptr)
+    {
+        throw std::runtime_error("[FileMap] Couldn't map file " + path);
+    }
+    map.data = static_cast<const char*>(view);
+    map.size = static_cast<std::size_t>(size.QuadPart);
+
+    return map;
+}
+
+void fileMapClose(FileMap& map)
+{
+    if(map.data)
+    {
+        UnmapViewOfFile(map.data);
+    }
+    if(map._mapping)
+    {
+        CloseHandle(static_cast<HANDLE>(map._mapping));
+    }
+    if(map._file)
+    {
+        CloseHandle(static_cast<HANDLE>(map._file));
+    }
+
+    map.data = nullptr;
+    map.size = 0;
+    map._mapping = nullptr;
+    map._file = nullptr;
+}
+
+/* removes the whole pages of a range from the working set (unlocking pages that aren't locked does exactly that) */
+static void releasePages(void* view, std::size_t viewSize, std::size_t offset, std::size_t size)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    std::size_t page = info.dwPageSize;
+    std::size_t begin = (offset + page - 1) / page * page;
+    std::size_t end = std::min(offset + size, viewSize) / page * page;
+    if(view && begin < end)
+    {
+        VirtualUnlock(static_cast<char*>(view) + begin, end - begin);
+    }
+}
+
+void fileMapRelease(const FileMap& map, std::size_t offset, std::size_t size)
+{
+    releasePages(const_cast<char*>(map.data), map.size, offset, size);
+}
+
+ScratchMap scratchMapCreate(std::size_t size)
+{
+    ScratchMap map;
+    if(size == 0)
+    {
+        return map;
+    }
+
+    std::string path = (std::filesystem::temp_directory_path() / ("mygl-scratch-" + std::to_string(GetCurrentProcessId()) + "-" + std::to_string(GetTickCount64()))).string();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("[FileMap] Couldn't create scratch file " + path);
+    }
+    map._file = file;
+
+    LARGE_INTEGER mappingSize;
+    mappingSize.QuadPart = static_cast<LONGLONG>(size);
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, mappingSize.HighPart, mappingSize.LowPart, nullptr);
+    if(mapping == nullptr)
+    {
+        throw std::runtime_error("[FileMap] Couldn't map scratch file " + path);
+    }
+    map._mapping = mapping;
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+    if(view == nullptr)
+    {
+        throw std::runtime_error("[FileMap] Couldn't map scratch file " + path);
+    }
+    map.data = static_cast<char*>(view);
+    map.size = size;
+
+    return map;
+}
+
+void scratchMapRelease(const ScratchMap& map, std::size_t offset, std::size_t size)
+{
+    releasePages(map.data, map.size, offset, size);
+}
+
+void scratchMapClose(ScratchMap& map)
+{
+    if(map.data)
+    {
+        UnmapViewOfFile(map.data);
+    }
+    if(map._mapping)
+    {
+        CloseHandle(static_cast<HANDLE>(map._mapping));
+    }
+    if(map._file)
+    {
+        CloseHandle(static_cast<HANDLE>(map._file));
+    }
+
+    map.data = nullptr;
+    map.size = 0;
+    map._mapping = nullptr;
+    map._file = nullptr;
+}
+
+#else
+
+FileMap fileMapOpen(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        throw std::runtime_error("[FileMap] Couldn't open file at " + path);
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("[FileMap] Couldn't query size of file " + path);
+    }
+
+    FileMap map;
+    if(info.st_size == 0)
+    {
+        close(fd);
+        return map;
+    }
+
+    void* view = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(view == MAP_FAILED)
+    {
+        throw std::runtime_error("[FileMap] Couldn't map file " + path);
+    }
+
+    /* files are consumed front to back, let the kernel read ahead aggressively */
+    madvise(view, static_cast<std::size_t>(info.st_size), MADV_SEQUENTIAL);
+
+    map.data = static_cast<const char*>(view);
+    map.size = static_cast<std::size_t>(info.st_size);
+    map._mapping = view;
+
+    return map;
+}
+
+void fileMapClose(FileMap& map)
+{
+    if(map._mapping)
+    {
+        munmap(map._mapping, map.size);
+    }
+
+    map.data = nullptr;
+    map.size = 0;
+    map._mapping = nullptr;
+    map._file = nullptr;
+}
+
+/* drops the whole pages of a range, file backed pages are read again (or written back) by the kernel as needed */
+static void releasePages(void* view, std::size_t viewSize, std::size_t offset, std::size_t size)
+{
+    std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    std::size_t begin = (offset + page - 1) / page * page;
+    std::size_t end = std::min(offset + size, viewSize) / page * page;
+    if(view && begin < end)
+    {
+        madvise(static_cast<char*>(view) + begin, end - begin, MADV_DONTNEED);
+    }
+}
+
+void fileMapRelease(const FileMap& map, std::size_t offset, std::size_t size)
+{
+    releasePages(map._mapping, map.size, offset, size);
+}
+
+ScratchMap scratchMapCreate(std::size_t size)
+{
+    ScratchMap map;
+    if(size == 0)
+    {
+        return map;
+    }
+
+    std::string path = (std::filesystem::temp_directory_path() / "mygl-scratch-XXXXXX").string();
+    int fd = mkstemp(path.data());
+    if(fd < 0)
+    {
+        throw std::runtime_error("[FileMap] Couldn't create scratch file " + path);
+    }
+
+    /* the file lives on as long as it is mapped */
+    unlink(path.c_str());
+    if(ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("[FileMap] Couldn't resize scratch file " + path);
+    }
+
+    void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(view == MAP_FAILED)
+    {
+        throw std::runtime_error("[FileMap] Couldn't map scratch file " + path);
+    }
+
+    map.data = static_cast<char*>(view);
+    map.size = size;
+    map._mapping = view;
+
+    return map;
+}
+
+void scratchMapRelease(const ScratchMap& map, std::size_t offset, std::size_t size)
+{
+    releasePages(map.data, map.size, offset, size);
+}
+
+void scratchMapClose(ScratchMap& map)
+{
+    if(map._mapping)
+    {
+        munmap(map._mapping, map.size);
+    }
+
+    map.data = nullptr;
+    map.size = 0;
+    map._mapping = nullptr;
+    map._file = nullptr;
+}
+
+#endif
+
+bool fileStamp(const std::string& path, FileStamp& stamp)
+{
+    std::error_code error;
+    auto time = std::filesystem::last_write_time(path, error);
+    if(error)
+    {
+        return false;
+    }
+
+    const std::size_t blockSize = 16 * 1024 * 1024;
+    FileMap source = fileMapOpen(path);
+    stamp.size = source.size;
+    stamp.time = static_cast<std::int64_t>(time.time_since_epoch().count());
+    stamp.hash = 0;
+    for(std::size_t offset = 0; offset < source.size; offset += blockSize)
+    {
+        std::size_t size = std::min(blockSize, source.size - offset);
+        stamp.hash = hash64(source.data + offset, size, stamp.hash);
+        fileMapRelease(source, offset, size);
+    }
+    return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+/* read-only memory mapping of a whole file (unmapped automatically when going out of scope) */
+struct FileMap
+{
+    const char* data = nullptr;
+    std::size_t size = 0;
+
+    void* _mapping = nullptr;
+    void* _file = nullptr;
+
+    FileMap() = default;
+    FileMap(FileMap&& other) noexcept;
+    FileMap& operator =(FileMap&& other) noexcept;
+    FileMap(const FileMap&) = delete;
+    FileMap& operator =(const FileMap&) = delete;
+    ~FileMap();
+};
+
+/**
+ * @brief Maps the whole content of a file read-only into memory.
+ *
+ * @param path Path to the file.
+ *
+ * @return Mapping of the file. Empty files result in a mapping with data == nullptr and size == 0.
+ */
+FileMap fileMapOpen(const std::string& path);
+
+/**
+ * @brief Unmaps a file. Is called automatically by the destructor, calling it more than once is fine.
+ *
+ * @param map Mapping to close.
+ */
+void fileMapClose(FileMap& map);
+
+/**
+ * @brief Tells the OS that a range of a mapping won't be read again for a while, so its pages can be dropped from
+ * memory right away. Reading the range again later is fine, it is simply paged in again.
+ *
+ * @param map Mapping the range belongs to.
+ * @param offset Start of the range in bytes.
+ * @param size Size of the range in bytes.
+ */
+void fileMapRelease(const FileMap& map, std::size_t offset, std::size_t size);
+
+/* read-write memory mapping of an anonymous temporary file, keeps large scratch arrays out of the heap and lets the
+   OS write them out instead of swapping (unmapped and deleted automatically when going out of scope) */
+struct ScratchMap
+{
+    char* data = nullptr;
+    std::size_t size = 0;
+
+    void* _mapping = nullptr;
+    void* _file = nullptr;
+
+    ScratchMap() = default;
+    ScratchMap(ScratchMap&& other) noexcept;
+    ScratchMap& operator =(ScratchMap&& other) noexcept;
+    ScratchMap(const ScratchMap&) = delete;
+    ScratchMap& operator =(const ScratchMap&) = delete;
+    ~ScratchMap();
+};
+
+/**
+ * @brief Creates a zero filled temporary file of the given size in the system temp directory and maps it read-write.
+ * The file is deleted as soon as the mapping is closed (or right away where the OS allows it).
+ *
+ * @param size Size in bytes.
+ *
+ * @return Mapping of the file. A size of zero results in a mapping with data == nullptr.
+ */
+ScratchMap scratchMapCreate(std::size_t size);
+
+/**
+ * @brief Drops the pages of a range of a scratch mapping from the working set of the process. The content is kept,
+ * the OS writes it to the file if it needs the memory and pages it in again on the next access.
+ *
+ * @param map Mapping the range belongs to.
+ * @param offset Start of the range in bytes.
+ * @param size Size of the range in bytes.
+ */
+void scratchMapRelease(const ScratchMap& map, std::size_t offset, std::size_t size);
+
+/**
+ * @brief Unmaps and deletes a scratch file. Is called automatically by the destructor, calling it more than once is
+ * fine.
+ *
+ * @param map Mapping to close.
+ */
+void scratchMapClose(ScratchMap& map);
+
+/* size, modification time and content hash of a source file, the on-disk caches are only valid while it matches */
+struct FileStamp
+{
+    std::uint64_t size = 0;
+    std::int64_t time = 0;
+    std::uint64_t hash = 0;
+};
+
+/**
+ * @brief Computes the stamp of a file. The content is hashed block by block and each block is dropped from memory
+ * again, so huge files don't pile up in memory.
+ *
+ * @param path Path to the file.
+ * @param stamp Receives the stamp.
+ *
+ * @return False if the file doesn't exist.
+ */
+bool fileStamp(const std::string& path, FileStamp& stamp);
@@ -0,0 +1,640 @@
+#include "glb.h"
+#include "draw_ring.h"
+#include "file_map.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace detail
+{
+
+/* minimal JSON document, enough for the glTF header chunk */
+struct Json
+{
+    enum eType { Null, Bool, Number, String, Array, Object };
+
+    eType type = Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<Json> array;
+    std::vector<std::pair<std::string, Json>> object;
+
+    const Json* find(std::string_view key) const
+    {
+        for(const auto& [name, value] : object)
+        {
+            if(name == key)
+            {
+                return &value;
+            }
+        }
+        return nullptr;
+    }
+
+    const Json& operator[](std::string_view key) const
+    {
+        static const Json null;
+        const Json* value = find(key);
+        return value ? *value : null;
+    }
+
+    const Json& operator[](std::size_t index) const
+    {
+        static const Json null;
+        return index < array.size() ? array[index] : null;
+    }
+
+    double numberOr(double fallback) const
+    {
+        return type == Number ? number : fallback;
+    }
+};
+
+struct JsonParser
+{
+    const char* cur;
+    const char* end;
+
+    [[noreturn]] void fail(const char* what)
+    {
+        throw std::runtime_error(std::string("[GLB] invalid JSON chunk: ") + what);
+    }
+
+    void skipSpace()
+    {
+        while(cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\n' || *cur == '\r'))
+        {
+            cur++;
+        }
+    }
+
+    bool consume(char c)
+    {
+        skipSpace();
+        if(cur < end && *cur == c)
+        {
+            cur++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c)
+    {
+        if(!consume(c))
+        {
+            fail("unexpected character");
+        }
+    }
+
+    void appendUtf8(std::string& out, std::uint32_t code)
+    {
+        if(code < 0x80)
+        {
+            out += static_cast<char>(code);
+        }
+        else if(code < 0x800)
+        {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else if(code < 0x10000)
+        {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else
+        {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    std::uint32_t hex4()
+    {
+        std::uint32_t code = 0;
+        if(end - cur < 4 || std::from_chars(cur, cur + 4, code, 16).ptr != cur + 4)
+        {
+            fail("bad unicode escape");
+        }
+        cur += 4;
+        return code;
+    }
+
+    std::string parseString()
+    {
+        expect('"');
+        std::string out;
+        while(cur < end && *cur != '"')
+        {
+            char c = *cur++;
+            if(c != '\\')
+            {
+                out += c;
+                continue;
+            }
+            if(cur == end)
+            {
+                break;
+            }
+            switch(char e = *cur++)
+            {
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u':
+                {
+                    std::uint32_t code = hex4();
+                    /* surrogate pair */
+                    if(code >= 0xD800 && code < 0xDC00 && end - cur >= 6 && cur[0] == '\\' && cur[1] == 'u')
+                    {
+                        cur += 2;
+                        code = 0x10000 + ((code - 0xD800) << 10) + (hex4() - 0xDC00);
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default: out += e; break;
+            }
+        }
+        if(cur == end)
+        {
+            fail("unterminated string");
+        }
+        cur++;
+        return out;
+    }
+
+    Json parseValue(int depth = 0)
+    {
+        if(depth > 64)
+        {
+            fail("nested too deeply");
+        }
+
+        skipSpace();
+        if(cur == end)
+        {
+            fail("unexpected end");
+        }
+
+        Json value;
+        if(*cur == '{')
+        {
+            cur++;
+            value.type = Json::Object;
+            if(consume('}'))
+            {
+                return value;
+            }
+            do
+            {
+                skipSpace();
+                std::string key = parseString();
+                expect(':');
+                value.object.emplace_back(std::move(key), parseValue(depth + 1));
+            } while(consume(','));
+            expect('}');
+        }
+        else if(*cur == '[')
+        {
+            cur++;
+            value.type = Json::Array;
+            if(consume(']'))
+            {
+                return value;
+            }
+            do
+            {
+                value.array.push_back(parseValue(depth + 1));
+            } while(consume(','));
+            expect(']');
+        }
+        else if(*cur == '"')
+        {
+            value.type = Json::String;
+            value.string = parseString();
+        }
+        else if(end - cur >= 4 && std::memcmp(cur, "true", 4) == 0)
+        {
+            value.type = Json::Bool;
+            value.boolean = true;
+            cur += 4;
+        }
+        else if(end - cur >= 5 && std::memcmp(cur, "false", 5) == 0)
+        {
+            value.type = Json::Bool;
+            cur += 5;
+        }
+        else if(end - cur >= 4 && std::memcmp(cur, "null", 4) == 0)
+        {
+            cur += 4;
+        }
+        else
+        {
+            auto [ptr, ec] = std::from_chars(cur, end, value.number);
+            if(ec != std::errc())
+            {
+                fail("unexpected character");
+            }
+            value.type = Json::Number;
+            cur = ptr;
+        }
+        return value;
+    }
+};
+
+const std::uint32_t GLB_MAGIC = 0x46546C67;      /* "glTF" */
+const std::uint32_t GLB_CHUNK_JSON = 0x4E4F534A; /* "JSON" */
+const std::uint32_t GLB_CHUNK_BIN = 0x004E4942;  /* "BIN\0" */
+
+/* accessor resolved to an absolute location inside the BIN chunk */
+struct GlbAccessor
+{
+    std::size_t offset = 0;
+    std::size_t count = 0;
+    GLenum componentType = GL_FLOAT;
+    GLint components = 0;
+    GLboolean normalized = GL_FALSE;
+    GLsizei stride = 0; /* 0 = tightly packed */
+
+    std::size_t componentSize() const
+    {
+        return componentType == GL_UNSIGNED_BYTE || componentType == GL_BYTE ? 1 : componentType == GL_UNSIGNED_SHORT || componentType == GL_SHORT ? 2 : 4;
+    }
+
+    std::size_t elementSize() const
+    {
+        return componentSize() * components;
+    }
+
+    /* one byte past the last element */
+    std::size_t end() const
+    {
+        return count == 0 ? offset : offset + (count - 1) * (stride ? stride : elementSize()) + elementSize();
+    }
+};
+
+GLint glbComponents(const std::string& type)
+{
+    if(type == "SCALAR") return 1;
+    if(type == "VEC2") return 2;
+    if(type == "VEC3") return 3;
+    if(type == "VEC4") return 4;
+    if(type == "MAT2") return 4;
+    if(type == "MAT3") return 9;
+    if(type == "MAT4") return 16;
+    throw std::runtime_error("[GLB] unknown accessor type " + type);
+}
+
+struct GlbFile
+{
+    FileMap file;
+    Json json;
+    const unsigned char* bin = nullptr;
+    std::size_t binSize = 0;
+    std::string directory;
+};
+
+GlbAccessor glbAccessor(const GlbFile& glb, const Json& index)
+{
+    if(index.type != Json::Number)
+    {
+        throw std::runtime_error("[GLB] missing accessor");
+    }
+
+    const Json& accessor = glb.json["accessors"][static_cast<std::size_t>(index.number)];
+    if(accessor.type != Json::Object)
+    {
+        throw std::runtime_error("[GLB] accessor index out of range");
+    }
+    if(accessor.find("sparse"))
+    {
+        throw std::runtime_error("[GLB] sparse accessors are not supported");
+    }
+
+    const Json& view = glb.json["bufferViews"][static_cast<std::size_t>(accessor["bufferView"].numberOr(-1))];
+    if(view.type != Json::Object || view["buffer"].numberOr(0) != 0)
+    {
+        throw std::runtime_error("[GLB] accessor without a buffer view into the BIN chunk");
+    }
+
+    GlbAccessor result;
+    result.offset = static_cast<std::size_t>(view["byteOffset"].numberOr(0) + accessor["byteOffset"].numberOr(0));
+    result.count = static_cast<std::size_t>(accessor["count"].numberOr(0));
+    result.componentType = static_cast<GLenum>(accessor["componentType"].numberOr(GL_FLOAT));
+    result.components = glbComponents(accessor["type"].string);
+    result.normalized = accessor["normalized"].boolean ? GL_TRUE : GL_FALSE;
+    result.stride = static_cast<GLsizei>(view["byteStride"].numberOr(0));
+
+    std::size_t viewEnd = static_cast<std::size_t>(view["byteOffset"].numberOr(0) + view["byteLength"].numberOr(0));
+    if(result.end() > viewEnd || viewEnd > glb.binSize)
+    {
+        throw std::runtime_error("[GLB] accessor exceeds its buffer view");
+    }
+    return result;
+}
+
+GlbFile glbOpen(const std::string& filepath)
+{
+    GlbFile glb;
+    glb.file = fileMapOpen(filepath);
+    glb.directory = filepath.substr(0, filepath.find_last_of("\\/") + 1);
+
+    const char* data = glb.file.data;
+    std::uint32_t header[3] = {0, 0, 0};
+    if(glb.file.size < sizeof(header))
+    {
+        throw std::runtime_error("[GLB] file too small: " + filepath);
+    }
+    std::memcpy(header, data, sizeof(header));
+    if(header[0] != GLB_MAGIC || header[1] != 2)
+    {
+        throw std::runtime_error("[GLB] not a glTF 2.0 binary file: " + filepath);
+    }
+
+    /* chunks: JSON first, then an optional BIN chunk, unknown chunks are skipped */
+    std::size_t size = std::min<std::size_t>(glb.file.size, header[2]);
+    std::size_t offset = sizeof(header);
+    bool hasJson = false;
+    while(offset + 8 <= size)
+    {
+        std::uint32_t chunk[2];
+        std::memcpy(chunk, data + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if(chunk[0] > size - offset)
+        {
+            throw std::runtime_error("[GLB] truncated chunk in " + filepath);
+        }
+
+        if(chunk[1] == GLB_CHUNK_JSON && !hasJson)
+        {
+            JsonParser parser{data + offset, data + offset + chunk[0]};
+            glb.json = parser.parseValue();
+            hasJson = true;
+        }
+        else if(chunk[1] == GLB_CHUNK_BIN && !glb.bin)
+        {
+            glb.bin = reinterpret_cast<const unsigned char*>(data + offset);
+            glb.binSize = chunk[0];
+        }
+        offset += (chunk[0] + 3) & ~std::size_t(3);
+    }
+
+    if(!hasJson || glb.json.type != Json::Object)
+    {
+        throw std::runtime_error("[GLB] missing JSON chunk in " + filepath);
+    }
+    return glb;
+}
+
+Texture glbTexture(const GlbFile& glb, const Json& info, std::map<std::size_t, Texture>& textures)
+{
+    const Json& index = info["index"];
+    if(index.type != Json::Number)
+    {
+        return Texture{};
+    }
+
+    /* textures referenced by several materials are decoded once, every material holds its own reference */
+    std::size_t textureIndex = static_cast<std::size_t>(index.number);
+    auto it = textures.find(textureIndex);
+    if(it != textures.end())
+    {
+        textureRetain(it->second);
+        return it->second;
+    }
+
+    const Json& image = glb.json["images"][static_cast<std::size_t>(glb.json["textures"][textureIndex]["source"].numberOr(-1))];
+    Texture texture;
+    if(image.find("bufferView"))
+    {
+        const Json& view = glb.json["bufferViews"][static_cast<std::size_t>(image["bufferView"].numberOr(-1))];
+        std::size_t offset = static_cast<std::size_t>(view["byteOffset"].numberOr(0));
+        std::size_t length = static_cast<std::size_t>(view["byteLength"].numberOr(0));
+        if(offset + length > glb.binSize)
+        {
+            throw std::runtime_error("[GLB] embedded image exceeds the BIN chunk");
+        }
+        texture = textureCreate(imageLoad(glb.bin + offset, length, false));
+    }
+    else if(image["uri"].type == Json::String && image["uri"].string.rfind("data:", 0) != 0)
+    {
+        texture = textureLoad(glb.directory + image["uri"].string, TEXTURE_USAGE_DATA, false);
+    }
+    else
+    {
+        std::cerr << "[GLB] texture " << textureIndex << " has no usable image source, skipped" << std::endl;
+    }
+
+    textures.emplace(textureIndex, texture);
+    return texture;
+}
+
+Material glbMaterial(const GlbFile& glb, const Json& material, std::map<std::size_t, Texture>& textures)
+{
+    const Json& pbr = material["pbrMetallicRoughness"];
+    const Json& baseColor = pbr["baseColorFactor"];
+    const Json& emissive = material["emissiveFactor"];
+    float roughness = static_cast<float>(pbr["roughnessFactor"].numberOr(1.0));
+
+    Material result{};
+    result.name = material["name"].string;
+    result.diffuse = Vector3D(static_cast<float>(baseColor[0].numberOr(1.0)), static_cast<float>(baseColor[1].numberOr(1.0)), static_cast<float>(baseColor[2].numberOr(1.0)));
+    result.ambient = Vector3D(1.0f, 1.0f, 1.0f);
+    result.specular = Vector3D(0.5f, 0.5f, 0.5f);
+    result.emission = Vector3D(static_cast<float>(emissive[0].numberOr(0.0)), static_cast<float>(emissive[1].numberOr(0.0)), static_cast<float>(emissive[2].numberOr(0.0)));
+    result.shininess = (1.0f - roughness) * (1.0f - roughness) * 1000.0f;
+
+    result.map_diffuse = glbTexture(glb, pbr["baseColorTexture"], textures);
+    result.map_normal = glbTexture(glb, material["normalTexture"], textures);
+    result.map_ambient = glbTexture(glb, material["occlusionTexture"], textures);
+    result.map_emission = glbTexture(glb, material["emissiveTexture"], textures);
+    return result;
+}
+
+void glbAttribute(const GlbAccessor* accessor, GLuint index, std::size_t base)
+{
+    if(!accessor)
+    {
+        /* attribute reads the current generic value (0, 0, 0, 1) */
+        glDisableVertexAttribArray(index);
+        return;
+    }
+    glEnableVertexAttribArray(index);
+    glVertexAttribPointer(index, accessor->components, accessor->componentType, accessor->normalized, accessor->stride, (void*) (accessor->offset - base));
+}
+
+Model glbModel(const GlbFile& glb, const std::string& name, const Json& mesh, std::vector<Material>& materials, std::map<std::size_t, Texture>& textures)
+{
+    struct Primitive
+    {
+        GlbAccessor indices;
+        GlbAccessor position;
+        GlbAccessor normal;
+        GlbAccessor uv;
+        bool hasNormal = false;
+        bool hasUv = false;
+        std::size_t material = 0;
+    };
+
+    std::vector<Primitive> primitives;
+    std::size_t begin = glb.binSize, end = 0;
+    for(const auto& primitive : mesh["primitives"].array)
+    {
+        if(primitive["mode"].numberOr(4) != 4)
+        {
+            std::cerr << "[GLB] '" << name << "': skipped a primitive that is not a triangle list" << std::endl;
+            continue;
+        }
+        if(!primitive.find("indices"))
+        {
+            throw std::runtime_error("[GLB] '" + name + "': non-indexed primitives are not supported");
+        }
+
+        const Json& attributes = primitive["attributes"];
+        Primitive& p = primitives.emplace_back();
+        p.indices = glbAccessor(glb, primitive["indices"]);
+        p.position = glbAccessor(glb, attributes["POSITION"]);
+        if((p.hasNormal = attributes.find("NORMAL") != nullptr))
+        {
+            p.normal = glbAccessor(glb, attributes["NORMAL"]);
+        }
+        if((p.hasUv = attributes.find("TEXCOORD_0") != nullptr))
+        {
+            p.uv = glbAccessor(glb, attributes["TEXCOORD_0"]);
+        }
+        p.material = static_cast<std::size_t>(primitive["material"].numberOr(static_cast<double>(materials.size() - 1)));
+        if(p.material >= materials.size())
+        {
+            throw std::runtime_error("[GLB] '" + name + "': material index out of range");
+        }
+
+        for(const GlbAccessor* accessor : {&p.indices, &p.position, p.hasNormal ? &p.normal : nullptr, p.hasUv ? &p.uv : nullptr})
+        {
+            if(accessor)
+            {
+                begin = std::min(begin, accessor->offset);
+                end = std::max(end, accessor->end());
+            }
+        }
+    }
+
+    Model model;
+    model.name = name;
+    if(primitives.empty())
+    {
+        return model;
+    }
+
+    /* start on a 4 byte boundary so index offsets stay multiples of the index size */
+    begin &= ~std::size_t(3);
+
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, end - begin, glb.bin + begin, GL_STATIC_DRAW);
+    glCheckError();
+
+    model.mesh.vbo = buffer;
+    model.mesh.ebo = buffer;
+    for(const auto& p : primitives)
+    {
+        GLuint vao = 0;
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+
+        glbAttribute(&p.position, eDataIdx::Position, begin);
+        glbAttribute(p.hasNormal ? &p.normal : nullptr, eDataIdx::Normal, begin);
+        glbAttribute(p.hasUv ? &p.uv : nullptr, eDataIdx::UV, begin);
+        drawRingAttach();
+        glCheckError();
+
+        Material& material = model.material.emplace_back(materials[p.material]);
+        materialRetain(material);
+        material.vao = vao;
+        material.indexType = p.indices.componentType;
+        material.indexOffset = static_cast<unsigned int>((p.indices.offset - begin) / p.indices.componentSize());
+        material.indexCount = static_cast<unsigned int>(p.indices.count);
+
+        model.mesh.size_vbo += static_cast<unsigned int>(p.position.count);
+        model.mesh.size_ibo += material.indexCount;
+    }
+    model.mesh.vao = model.material.front().vao;
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    return model;
+}
+
+}
+
+std::vector<Model> glbLoad(const std::string& filepath)
+{
+    detail::GlbFile glb = detail::glbOpen(filepath);
+    const detail::Json& json = glb.json;
+
+    /* all materials plus a default one for primitives without material */
+    std::map<std::size_t, Texture> textures;
+    std::vector<Material> materials;
+    for(const auto& material : json["materials"].array)
+    {
+        materials.push_back(detail::glbMaterial(glb, material, textures));
+    }
+    detail::Json fallback;
+    fallback.type = detail::Json::Object;
+    materials.push_back(detail::glbMaterial(glb, fallback, textures));
+
+    std::vector<Model> models;
+    bool transformed = false;
+    for(const auto& node : json["nodes"].array)
+    {
+        if(!node.find("mesh"))
+        {
+            continue;
+        }
+
+        const detail::Json& mesh = json["meshes"][static_cast<std::size_t>(node["mesh"].number)];
+        std::string name = node["name"].type == detail::Json::String ? node["name"].string : mesh["name"].string;
+        models.push_back(detail::glbModel(glb, name, mesh, materials, textures));
+
+        transformed = transformed || node.find("matrix") || node.find("translation") || node.find("rotation") || node.find("scale");
+    }
+
+    /* files without a scene graph still get their meshes */
+    if(json["nodes"].array.empty())
+    {
+        for(const auto& mesh : json["meshes"].array)
+        {
+            models.push_back(detail::glbModel(glb, mesh["name"].string, mesh, materials, textures));
+        }
+    }
+
+    /* the models hold their own references, materials no primitive uses are freed here */
+    materialDelete(materials);
+
+    if(transformed)
+    {
+        std::cerr << "[GLB] " << filepath << ": node transforms are ignored, apply them before exporting" << std::endl;
+    }
+
+    std::cout << "[GLB] " << filepath << ": " << models.size() << " models, " << glb.binSize << " bytes of buffer data" << std::endl;
+    return models;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "model.h"
+
+/**
+ * @brief Loads a binary glTF 2.0 file (GLB) without parsing any vertex data on the CPU. The file is memory mapped and
+ * for every node with a mesh the byte range of the BIN chunk covering its accessors is handed to glBufferData as is;
+ * every primitive gets its own vertex array that points into that buffer (POSITION, NORMAL, TEXCOORD_0) and becomes
+ * one material range of the model (see modelDraw).
+ *
+ * Materials are converted from the metallic-roughness model: base color -> diffuse, emissive -> emission,
+ * occlusion -> ambient map, roughness -> shininess (same mapping as Blender's MTL export). Textures may be external
+ * files or images embedded in the BIN chunk. glTF puts the texture origin at the top left, so images are loaded
+ * without the vertical flip used for OBJ files.
+ *
+ * Node transforms are not applied (OBJ exports bake them into the vertices), sparse accessors and non-indexed or
+ * non-triangle primitives are not supported.
+ *
+ * @param filepath Path to the GLB file.
+ *
+ * @return One model per node that references a mesh, named after the node.
+ */
+std::vector<Model> glbLoad(const std::string& filepath);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+/**
+ * @brief Fast non-cryptographic 64 bit hash of a memory block (8 bytes per step, multiply-xorshift mixing).
+ * Used to detect changed source files for the on-disk caches.
+ *
+ * @param data Pointer to the data.
+ * @param size Size of the data in bytes.
+ * @param seed Seed to chain several hashes.
+ *
+ * @return Hash value.
+ */
+inline std::uint64_t hash64(const void* data, std::size_t size, std::uint64_t seed = 0)
+{
+    constexpr std::uint64_t k0 = 0x9E3779B97F4A7C15ull;
+    constexpr std::uint64_t k1 = 0xBF58476D1CE4E5B9ull;
+    constexpr std::uint64_t k2 = 0x94D049BB133111EBull;
+
+    auto mix = [](std::uint64_t h) {
+        h ^= h >> 31;
+        h *= k1;
+        h ^= h >> 29;
+        return h;
+    };
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    std::uint64_t h0 = seed ^ (size * k0);
+    std::uint64_t h1 = ~seed;
+
+    /* two independent lanes keep the multiplier pipeline busy */
+    std::size_t i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        std::uint64_t a, b;
+        std::memcpy(&a, bytes + i, 8);
+        std::memcpy(&b, bytes + i + 8, 8);
+        h0 = (h0 ^ mix(a * k2)) * k0;
+        h1 = (h1 ^ mix(b * k2)) * k1;
+    }
+
+    if(i + 8 <= size)
+    {
+        std::uint64_t a;
+        std::memcpy(&a, bytes + i, 8);
+        h1 = (h1 ^ mix(a * k2)) * k1;
+        i += 8;
+    }
+
+    std::uint64_t tail = 0;
+    std::memcpy(&tail, bytes + i, size - i);
+    h0 = (h0 ^ mix(tail * k2 + (size - i))) * k0;
+
+    return mix(h0 ^ (h1 * k2));
+}
@@ -0,0 +1,229 @@
+#include "image_cache.h"
+#include "texture_compress.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace detail
+{
+
+const char IMAGE_CACHE_MAGIC[8] = {'M', 'Y', 'G', 'L', 'I', 'M', 'G', 'S'};
+
+struct ImageCacheHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t flipped;
+    std::uint64_t sourceSize;
+    std::int64_t sourceTime;
+    std::uint64_t sourceHash;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t levelCount;
+    std::uint32_t usage;
+    std::uint32_t format;
+    std::uint32_t reserved;
+};
+
+/* sizes of all levels of a full mip chain, level 0 first */
+std::vector<ImageLevel> mipLevels(unsigned int width, unsigned int height)
+{
+    std::vector<ImageLevel> levels;
+    levels.push_back(ImageLevel{width, height, nullptr});
+    while(width > 1 || height > 1)
+    {
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+        levels.push_back(ImageLevel{width, height, nullptr});
+    }
+    return levels;
+}
+
+std::size_t levelBytes(const ImageLevel& level)
+{
+    return textureFormatSize(TEXTURE_FORMAT_RGBA8, level.width, level.height);
+}
+
+/* 2x2 box filter like glGenerateMipmap, the last row/column of odd sizes is repeated */
+void downsample(const ImageLevel& src, const ImageLevel& dst, unsigned char* out)
+{
+    for(unsigned int y = 0; y < dst.height; y++)
+    {
+        const unsigned char* row0 = src.pixels + std::size_t(std::min(2 * y, src.height - 1)) * src.width * 4;
+        const unsigned char* row1 = src.pixels + std::size_t(std::min(2 * y + 1, src.height - 1)) * src.width * 4;
+        for(unsigned int x = 0; x < dst.width; x++)
+        {
+            std::size_t x0 = std::size_t(std::min(2 * x, src.width - 1)) * 4;
+            std::size_t x1 = std::size_t(std::min(2 * x + 1, src.width - 1)) * 4;
+            for(unsigned int c = 0; c < 4; c++)
+            {
+                unsigned int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                *out++ = static_cast<unsigned char>((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+}
+
+std::string imageCachePath(const std::string& sourcePath, eTextureUsage usage, bool flipVertically)
+{
+    const char* suffixes[] = {"", ".color", ".scalar", ".normal"};
+    return sourcePath + suffixes[usage] + (flipVertically ? ".texcache" : ".noflip.texcache");
+}
+
+bool imageCacheLoad(const std::string& sourcePath, eTextureUsage usage, bool flipVertically, ImageMips& mips)
+{
+    std::string path = imageCachePath(sourcePath, usage, flipVertically);
+    if(!std::filesystem::exists(path))
+    {
+        return false;
+    }
+
+    FileStamp stamp;
+    if(!fileStamp(sourcePath, stamp))
+    {
+        return false;
+    }
+
+    mips = ImageMips{};
+    mips.file = fileMapOpen(path);
+
+    detail::ImageCacheHeader header;
+    if(mips.file.size < sizeof(header))
+    {
+        return false;
+    }
+    std::memcpy(&header, mips.file.data, sizeof(header));
+    if(std::memcmp(header.magic, detail::IMAGE_CACHE_MAGIC, sizeof(header.magic)) != 0
+       || header.version != IMAGE_CACHE_VERSION
+       || header.flipped != (flipVertically ? 1u : 0u)
+       || header.usage != static_cast<std::uint32_t>(usage)
+       || header.format > TEXTURE_FORMAT_BC5
+       || header.sourceSize != stamp.size
+       || header.sourceTime != stamp.time
+       || header.sourceHash != stamp.hash
+       || header.width == 0 || header.height == 0)
+    {
+        return false;
+    }
+
+    /* the levels follow the header back to back, their sizes follow from the base size */
+    mips.format = static_cast<eTextureFormat>(header.format);
+    mips.levels = detail::mipLevels(header.width, header.height);
+    std::size_t offset = sizeof(header);
+    for(auto& level : mips.levels)
+    {
+        std::size_t bytes = textureFormatSize(mips.format, level.width, level.height);
+        if(mips.file.size - offset < bytes)
+        {
+            return false;
+        }
+        level.pixels = reinterpret_cast<const unsigned char*>(mips.file.data + offset);
+        offset += bytes;
+    }
+    return header.levelCount == mips.levels.size() && offset == mips.file.size;
+}
+
+void imageCacheWrite(const std::string& sourcePath, eTextureUsage usage, bool flipVertically, const ImageMips& mips)
+{
+    FileStamp stamp;
+    if(mips.levels.empty() || !fileStamp(sourcePath, stamp))
+    {
+        return;
+    }
+
+    detail::ImageCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, detail::IMAGE_CACHE_MAGIC, sizeof(header.magic));
+    header.version = IMAGE_CACHE_VERSION;
+    header.flipped = flipVertically ? 1u : 0u;
+    header.sourceSize = stamp.size;
+    header.sourceTime = stamp.time;
+    header.sourceHash = stamp.hash;
+    header.width = mips.levels[0].width;
+    header.height = mips.levels[0].height;
+    header.levelCount = static_cast<std::uint32_t>(mips.levels.size());
+    header.usage = static_cast<std::uint32_t>(usage);
+    header.format = static_cast<std::uint32_t>(mips.format);
+
+    /* write to a temporary file first so a crash never leaves a truncated file behind */
+    std::string path = imageCachePath(sourcePath, usage, flipVertically);
+    std::string tmpPath = path + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for(const auto& level : mips.levels)
+    {
+        out.write(reinterpret_cast<const char*>(level.pixels), static_cast<std::streamsize>(textureFormatSize(mips.format, level.width, level.height)));
+    }
+    out.close();
+
+    std::error_code error;
+    if(!out)
+    {
+        std::cerr << "[ImageCache] couldn't write cache file " << tmpPath << std::endl;
+        std::filesystem::remove(tmpPath, error);
+        return;
+    }
+
+    std::filesystem::rename(tmpPath, path, error);
+    if(error)
+    {
+        std::cerr << "[ImageCache] couldn't write cache file " << path << ": " << error.message() << std::endl;
+        std::filesystem::remove(tmpPath, error);
+    }
+}
+
+ImageMips imageMipChain(const ImageData& image)
+{
+    ImageMips mips;
+    mips.base = image;
+    mips.levels = detail::mipLevels(image.width, image.height);
+    mips.levels[0].pixels = image.pixels.get();
+
+    std::size_t bytes = 0;
+    for(std::size_t i = 1; i < mips.levels.size(); i++)
+    {
+        bytes += detail::levelBytes(mips.levels[i]);
+    }
+    mips.storage.resize(bytes);
+
+    unsigned char* out = mips.storage.data();
+    for(std::size_t i = 1; i < mips.levels.size(); i++)
+    {
+        detail::downsample(mips.levels[i - 1], mips.levels[i], out);
+        mips.levels[i].pixels = out;
+        out += detail::levelBytes(mips.levels[i]);
+    }
+    return mips;
+}
+
+ImageMips imageLoadMips(const std::string& path, eTextureUsage usage, bool flipVertically)
+{
+    ImageMips mips;
+    if(imageCacheLoad(path, usage, flipVertically, mips))
+    {
+        return mips;
+    }
+
+    /* compressed levels are made from the RGBA8 ones, which are only written to disk if they are used themselves */
+    ImageMips rgba;
+    if(usage == TEXTURE_USAGE_DATA || !imageCacheLoad(path, TEXTURE_USAGE_DATA, flipVertically, rgba))
+    {
+        rgba = imageMipChain(imageLoad(path, flipVertically));
+    }
+    if(usage == TEXTURE_USAGE_DATA)
+    {
+        imageCacheWrite(path, TEXTURE_USAGE_DATA, flipVertically, rgba);
+        return rgba;
+    }
+
+    mips = imageCompress(rgba, textureFormatFor(usage, rgba.levels[0]));
+    imageCacheWrite(path, usage, flipVertically, mips);
+    return mips;
+}
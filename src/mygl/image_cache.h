@@ -0,0 +1,80 @@
+#pragma once
+
+#include "texture.h"
+#include "file_map.h"
+
+#include <string>
+#include <vector>
+
+/* version of the texture disk cache format, bump whenever the file layout, the mip filter or the encoders change */
+#define IMAGE_CACHE_VERSION 2
+
+/* decoded image with its full mip chain, the levels either point into a mapped cache file or into memory */
+struct ImageMips
+{
+    std::vector<ImageLevel> levels;
+    eTextureFormat format = TEXTURE_FORMAT_RGBA8;
+
+    FileMap file;
+    ImageData base;
+    std::vector<unsigned char> storage;
+};
+
+/**
+ * @brief Path of the texture disk cache file that belongs to an image file (stored next to it, one per orientation
+ * and usage).
+ *
+ * @param sourcePath Path to the image file.
+ * @param usage Usage the levels were prepared for (decides their format).
+ * @param flipVertically Orientation of the cached levels.
+ *
+ * @return Path to the cache file.
+ */
+std::string imageCachePath(const std::string& sourcePath, eTextureUsage usage, bool flipVertically);
+
+/**
+ * @brief Maps the cache file of an image with its mip chain. The file is only accepted if format version, usage and
+ * flip and the size, modification time and content hash of the image file still match.
+ *
+ * @param sourcePath Path to the image file.
+ * @param usage Usage the cached levels have to be prepared for.
+ * @param flipVertically Orientation the cached levels have to be in.
+ * @param mips Receives the mapped levels on success.
+ *
+ * @return True if a valid cache file was found, false if it is missing, stale or corrupt.
+ */
+bool imageCacheLoad(const std::string& sourcePath, eTextureUsage usage, bool flipVertically, ImageMips& mips);
+
+/**
+ * @brief Writes a decoded image and its mip chain into the cache file of the image file. Failing to write (e.g.
+ * read-only asset folder) is reported but not an error.
+ *
+ * @param sourcePath Path to the image file the levels were decoded from.
+ * @param usage Usage the levels were prepared for.
+ * @param flipVertically Orientation of the levels.
+ * @param mips Levels to write.
+ */
+void imageCacheWrite(const std::string& sourcePath, eTextureUsage usage, bool flipVertically, const ImageMips& mips);
+
+/**
+ * @brief Builds the full mip chain of a decoded image on the CPU with the same 2x2 box filter as glGenerateMipmap.
+ * Level 0 is the image itself (shared, not copied).
+ *
+ * @param image Decoded image.
+ *
+ * @return Image with all levels down to 1x1.
+ */
+ImageMips imageMipChain(const ImageData& image);
+
+/**
+ * @brief Loads an image file with its mip chain from the cache file, or decodes it, builds the mip chain, compresses
+ * it for the usage (see imageCompress) and writes the cache file for the next run. Doesn't touch OpenGL, so it can
+ * run on worker threads.
+ *
+ * @param path Path to image file.
+ * @param usage What the image holds, TEXTURE_USAGE_DATA keeps it as RGBA8.
+ * @param flipVertically Flip the image to match OpenGL's texture coordinates.
+ *
+ * @return Image with all levels down to 1x1.
+ */
+ImageMips imageLoadMips(const std::string& path, eTextureUsage usage = TEXTURE_USAGE_DATA, bool flipVertically = true);
@@ -1,29 +1,170 @@
 #include "mesh.h"
+#include "draw_ring.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace detail
+{
+
+/* float to IEEE half, rounds to nearest even, overflows to infinity */
+unsigned short floatToHalf(float value)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    std::uint32_t sign = (bits >> 16) & 0x8000u;
+    std::uint32_t magnitude = bits & 0x7FFFFFFFu;
+
+    /* NaN and values that are too large for a half */
+    if(magnitude >= 0x47800000u)
+    {
+        return static_cast<unsigned short>(sign | (magnitude > 0x7F800000u ? 0x7E00u : 0x7C00u));
+    }
+    /* denormals and zero */
+    if(magnitude < 0x38800000u)
+    {
+        float denormal;
+        std::memcpy(&denormal, &magnitude, sizeof(denormal));
+        return static_cast<unsigned short>(sign | static_cast<std::uint32_t>(std::nearbyint(denormal * 16777216.0f)));
+    }
+
+    std::uint32_t half = (magnitude - 0x38000000u) >> 13;
+    std::uint32_t rest = magnitude & 0x1FFFu;
+    if(rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+    {
+        half++;
+    }
+    return static_cast<unsigned short>(sign | half);
+}
+
+short toSnorm16(float value)
+{
+    return static_cast<short>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+/* octahedral normal encoding (Cigolle et al. 2014), decoded by octDecode in the vertex shaders */
+void octEncode(const Vector4D& normal, short out[2])
+{
+    float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    float x = sum > 0.0f ? normal.x / sum : 0.0f;
+    float y = sum > 0.0f ? normal.y / sum : 0.0f;
+    if(normal.z < 0.0f)
+    {
+        float folded = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        y = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded;
+    }
+    out[0] = toSnorm16(x);
+    out[1] = toSnorm16(y);
+}
+
+std::vector<CompactVertex> compactVertices(const Vertex* vertices, unsigned int vertexCount, Vector3D& offset, Vector3D& scale)
+{
+    Vector3D min = vertexCount ? vertices[0].pos : Vector3D(0.0f, 0.0f, 0.0f);
+    Vector3D max = min;
+    for(unsigned int i = 0; i < vertexCount; i++)
+    {
+        for(unsigned int c = 0; c < 3; c++)
+        {
+            min[c] = std::min(min[c], vertices[i].pos[c]);
+            max[c] = std::max(max[c], vertices[i].pos[c]);
+        }
+    }
+    offset = min;
+    scale = max - min;
+
+    std::vector<CompactVertex> compact(vertexCount);
+    for(unsigned int i = 0; i < vertexCount; i++)
+    {
+        CompactVertex& v = compact[i];
+        for(unsigned int c = 0; c < 3; c++)
+        {
+            float t = scale[c] > 0.0f ? (vertices[i].pos[c] - min[c]) / scale[c] : 0.0f;
+            v.pos[c] = static_cast<unsigned short>(std::lround(std::clamp(t, 0.0f, 1.0f) * 65535.0f));
+        }
+        v.pad = 0;
+        octEncode(vertices[i].normal, v.normal);
+        v.uv[0] = floatToHalf(vertices[i].uv.x);
+        v.uv[1] = floatToHalf(vertices[i].uv.y);
+    }
+    return compact;
+}
+
+}
 
 Mesh meshCreate(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices, GLenum vertexBufferUsage, GLenum indexBufferUsage)
 {
-    GLuint vao = 0, vbo = 0, ebo = 0;
+    return meshCreate(vertices.data(), (unsigned int) vertices.size(), indices.data(), (unsigned int) indices.size(), vertexBufferUsage, indexBufferUsage);
+}
+
+Mesh meshCreate(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, GLenum vertexBufferUsage, GLenum indexBufferUsage,
+                eVertexFormat format)
+{
+    Mesh mesh;
+    mesh.size_vbo = vertexCount;
+    mesh.size_ibo = indexCount;
+    mesh.format = format;
+
+    /* compact meshes convert first, float meshes upload the given memory directly */
+    std::vector<CompactVertex> compact;
+    std::vector<unsigned short> shortIndices;
+    if(format == VERTEX_FORMAT_COMPACT)
+    {
+        compact = detail::compactVertices(vertices, vertexCount, mesh.positionOffset, mesh.positionScale);
+        if(vertexCount < 65536)
+        {
+            shortIndices.assign(indices, indices + indexCount);
+            mesh.indexType = GL_UNSIGNED_SHORT;
+        }
+    }
 
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
+    glGenVertexArrays(1, &mesh.vao);
+    glGenBuffers(1, &mesh.vbo);
+    glGenBuffers(1, &mesh.ebo);
 
-    glBindVertexArray(vao);
+    glBindVertexArray(mesh.vao);
     {
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), vertexBufferUsage);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+        if(format == VERTEX_FORMAT_COMPACT)
+        {
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(CompactVertex), compact.data(), vertexBufferUsage);
+        }
+        else
+        {
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices, vertexBufferUsage);
+        }
         glCheckError();
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), indexBufferUsage);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+        if(mesh.indexType == GL_UNSIGNED_SHORT)
+        {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned short), shortIndices.data(), indexBufferUsage);
+        }
+        else
+        {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, indexBufferUsage);
+        }
         glCheckError();
 
         glEnableVertexAttribArray(eDataIdx::Position);
         glEnableVertexAttribArray(eDataIdx::Normal);
         glEnableVertexAttribArray(eDataIdx::UV);
-        glVertexAttribPointer(eDataIdx::Position,   3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, pos));
-        glVertexAttribPointer(eDataIdx::Normal,     3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, normal));
-        glVertexAttribPointer(eDataIdx::UV,         2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, uv));
+        if(format == VERTEX_FORMAT_COMPACT)
+        {
+            glVertexAttribPointer(eDataIdx::Position,   3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (void*) offsetof(CompactVertex, pos));
+            glVertexAttribPointer(eDataIdx::Normal,     2, GL_SHORT,          GL_TRUE, sizeof(CompactVertex), (void*) offsetof(CompactVertex, normal));
+            glVertexAttribPointer(eDataIdx::UV,         2, GL_HALF_FLOAT,     GL_FALSE, sizeof(CompactVertex), (void*) offsetof(CompactVertex, uv));
+        }
+        else
+        {
+            glVertexAttribPointer(eDataIdx::Position,   3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, pos));
+            glVertexAttribPointer(eDataIdx::Normal,     3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, normal));
+            glVertexAttribPointer(eDataIdx::UV,         2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*) offsetof(Vertex, uv));
+        }
+        drawRingAttach();
         glCheckError();
     }
 
@@ -31,12 +172,22 @@ Mesh meshCreate(const std::vector<Vertex> &vertices, const std::vector<unsigned
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-    return Mesh{vao, vbo, ebo, (unsigned int) vertices.size(), (unsigned int) indices.size()};
+    return mesh;
+}
+
+std::size_t meshByteSize(const Mesh& mesh)
+{
+    std::size_t vertexSize = mesh.format == VERTEX_FORMAT_COMPACT ? sizeof(CompactVertex) : sizeof(Vertex);
+    std::size_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    return mesh.size_vbo * vertexSize + mesh.size_ibo * indexSize;
 }
 
 void meshDelete(const Mesh &mesh)
 {
     glDeleteBuffers(1, &mesh.vbo);
-    glDeleteBuffers(1, &mesh.ebo);
+    if(mesh.ebo != mesh.vbo)
+    {
+        glDeleteBuffers(1, &mesh.ebo);
+    }
     glDeleteVertexArrays(1, &mesh.vao);
 }
@@ -2,9 +2,10 @@
 
 #include "base.h"
 
+#include <cstddef>
 #include <vector>
 
-enum eDataIdx { Position = 0, Normal = 1, UV = 2 };
+enum eDataIdx { Position = 0, Normal = 1, UV = 2, DrawID = 3 };
 
 struct Vertex
 {
@@ -13,6 +14,21 @@ struct Vertex
     Vector2D uv;
 };
 
+/* layout of the vertex buffer on the GPU */
+enum eVertexFormat
+{
+    VERTEX_FORMAT_FLOAT = 0,    // struct Vertex as is (36 bytes)
+    VERTEX_FORMAT_COMPACT       // struct CompactVertex (16 bytes)
+};
+
+/* quantized vertex: position in 16 bit relative to the mesh AABB, octahedral normal in 2x16 bit, half float uv */
+struct CompactVertex
+{
+    unsigned short pos[3];
+    unsigned short pad;
+    short normal[2];
+    unsigned short uv[2];
+};
 
 struct Mesh
 {
@@ -22,6 +38,13 @@ struct Mesh
 
     unsigned int size_vbo = 0;
     unsigned int size_ibo = 0;
+
+    GLenum indexType = GL_UNSIGNED_INT;
+    eVertexFormat format = VERTEX_FORMAT_FLOAT;
+
+    /* position = positionOffset + positionScale * attribute, identity for float meshes */
+    Vector3D positionOffset = Vector3D(0.0f, 0.0f, 0.0f);
+    Vector3D positionScale = Vector3D(1.0f, 1.0f, 1.0f);
 };
 
 /**
@@ -44,6 +67,37 @@ struct Mesh
  */
 Mesh meshCreate(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, GLenum vertexBufferUsage, GLenum indexBufferUsage);
 
+/**
+ * @brief Same as above, but takes the vertex and index data from raw memory (e.g. a memory mapped cache file), so
+ * nothing has to be copied into vectors first.
+ *
+ * With VERTEX_FORMAT_COMPACT the vertices are converted to CompactVertex and meshes with less than 65536 vertices get
+ * 16 bit indices. Positions are read as normalized unsigned shorts and have to be decoded in the vertex shader with
+ * positionOffset/positionScale of the mesh, normals are two normalized shorts holding an octahedral encoding (see
+ * octDecode in default.vert). Draw with mesh.indexType.
+ *
+ * @param vertices Pointer to vertexCount vertices.
+ * @param vertexCount Number of vertices.
+ * @param indices Pointer to indexCount indices.
+ * @param indexCount Number of indices.
+ * @param vertexBufferUsage enum to hint the usage of the vertex buffer (see usage parameter in glBufferData function).
+ * @param indexBufferUsage enum to hint the usage of the index buffer (see usage parameter in glBufferData function).
+ * @param format Vertex layout on the GPU.
+ *
+ * @return Initialized mesh structure that can be drawn with OpenGL.
+ */
+Mesh meshCreate(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, GLenum vertexBufferUsage, GLenum indexBufferUsage,
+                eVertexFormat format = VERTEX_FORMAT_FLOAT);
+
+/**
+ * @brief Bytes the vertex and index buffers of a mesh occupy on the GPU.
+ *
+ * @param mesh Mesh created with meshCreate.
+ *
+ * @return Size of both buffers in bytes.
+ */
+std::size_t meshByteSize(const Mesh& mesh);
+
 /**
  * @brief Cleanup and delete all OpenGL buffers of a mesh. Has to be called for each mesh after it is not used anymore.
  *
@@ -0,0 +1,372 @@
+#include "mesh_cache.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+static_assert(sizeof(Vertex) == 36, "struct Vertex changed, bump MESH_CACHE_VERSION and update this check");
+static_assert(sizeof(MaterialLod) == 12, "struct MaterialLod changed, bump MESH_CACHE_VERSION and update this check");
+static_assert(sizeof(MeshCluster) == 40, "struct MeshCluster changed, bump MESH_CACHE_VERSION and update this check");
+
+namespace detail
+{
+
+const char MESH_CACHE_MAGIC[8] = {'M', 'Y', 'G', 'L', 'M', 'E', 'S', 'H'};
+
+struct MeshCacheHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t vertexSize;
+    std::uint64_t sourceSize;
+    std::int64_t sourceTime;
+    std::uint64_t sourceHash;
+    std::uint32_t libraryCount;
+    std::uint32_t objectCount;
+    std::uint32_t flags;
+};
+
+/* bounds checked reader over the mapped blob */
+struct BlobReader
+{
+    const char* cur;
+    const char* end;
+
+    bool read(void* out, std::size_t size)
+    {
+        if(static_cast<std::size_t>(end - cur) < size)
+        {
+            return false;
+        }
+        std::memcpy(out, cur, size);
+        cur += size;
+        return true;
+    }
+
+    bool readString(std::string& out)
+    {
+        std::uint32_t length = 0;
+        if(!read(&length, sizeof(length)) || static_cast<std::size_t>(end - cur) < length)
+        {
+            return false;
+        }
+        out.assign(cur, length);
+        cur += length;
+        return true;
+    }
+
+    /* returns a pointer to count elements in place (blob sections are 4 byte aligned) */
+    template<typename T>
+    const T* view(std::size_t count)
+    {
+        if(static_cast<std::size_t>(end - cur) / sizeof(T) < count)
+        {
+            return nullptr;
+        }
+        const T* data = reinterpret_cast<const T*>(cur);
+        cur += count * sizeof(T);
+        return data;
+    }
+
+    void align(std::size_t alignment, const char* base)
+    {
+        std::size_t offset = static_cast<std::size_t>(cur - base);
+        cur = base + std::min(static_cast<std::size_t>(end - base), (offset + alignment - 1) / alignment * alignment);
+    }
+};
+
+/* every range has to lie within the index array of its object, the indices themselves are only read once the object
+   is consumed (see meshCacheObjectValid) */
+bool rangesValid(const MeshCacheObject& object)
+{
+    auto inside = [&](unsigned int offset, unsigned int count) {
+        return offset <= object.indexCount && count <= object.indexCount - offset;
+    };
+    for(const auto& range : object.material)
+    {
+        if(!inside(range.indexOffset, range.indexCount))
+        {
+            return false;
+        }
+        for(const auto& lod : range.lod)
+        {
+            if(!inside(lod.indexOffset, lod.indexCount))
+            {
+                return false;
+            }
+        }
+        for(const auto& cluster : range.clusters)
+        {
+            if(!inside(cluster.indexOffset, cluster.indexCount))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* appends to the output stream of a writer and tracks the size for the alignment */
+struct BlobWriter
+{
+    MeshCacheWriter& writer;
+
+    void write(const void* data, std::size_t size)
+    {
+        writer.out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        writer.size += size;
+    }
+
+    void writeString(const std::string& str)
+    {
+        std::uint32_t length = static_cast<std::uint32_t>(str.size());
+        write(&length, sizeof(length));
+        write(str.data(), str.size());
+    }
+
+    void align(std::size_t alignment)
+    {
+        const char zero[16] = {};
+        write(zero, static_cast<std::size_t>((alignment - writer.size % alignment) % alignment));
+    }
+};
+
+}
+
+std::string meshCachePath(const std::string& sourcePath, unsigned int flags)
+{
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".%x.meshcache", flags);
+    return sourcePath + suffix;
+}
+
+bool meshCacheLoad(const std::string& sourcePath, unsigned int flags, MeshCache& cache)
+{
+    std::string path = meshCachePath(sourcePath, flags);
+    if(!std::filesystem::exists(path))
+    {
+        return false;
+    }
+
+    FileStamp stamp;
+    if(!fileStamp(sourcePath, stamp))
+    {
+        return false;
+    }
+
+    cache = MeshCache{};
+    cache.file = fileMapOpen(path);
+
+    detail::BlobReader reader{cache.file.data, cache.file.data + cache.file.size};
+
+    detail::MeshCacheHeader header;
+    if(!reader.read(&header, sizeof(header))
+       || std::memcmp(header.magic, detail::MESH_CACHE_MAGIC, sizeof(header.magic)) != 0
+       || header.version != MESH_CACHE_VERSION
+       || header.vertexSize != sizeof(Vertex)
+       || header.flags != flags
+       || header.sourceSize != stamp.size
+       || header.sourceTime != stamp.time
+       || header.sourceHash != stamp.hash)
+    {
+        return false;
+    }
+
+    cache.materialLibraries.resize(header.libraryCount);
+    for(auto& library : cache.materialLibraries)
+    {
+        if(!reader.readString(library))
+        {
+            return false;
+        }
+    }
+
+    cache.objects.resize(header.objectCount);
+    for(auto& object : cache.objects)
+    {
+        std::uint32_t counts[3] = {0, 0, 0};
+        if(!reader.readString(object.name) || !reader.read(counts, sizeof(counts)))
+        {
+            return false;
+        }
+
+        object.material.resize(counts[2]);
+        for(auto& range : object.material)
+        {
+            std::uint32_t lodCount = 0;
+            if(!reader.readString(range.material) || !reader.read(&range.indexOffset, sizeof(range.indexOffset)) || !reader.read(&range.indexCount, sizeof(range.indexCount))
+               || !reader.read(&lodCount, sizeof(lodCount)) || static_cast<std::size_t>(reader.end - reader.cur) / sizeof(MaterialLod) < lodCount)
+            {
+                return false;
+            }
+
+            range.lod.resize(lodCount);
+            std::uint32_t clusterCount = 0;
+            if(!reader.read(range.lod.data(), lodCount * sizeof(MaterialLod))
+               || !reader.read(&clusterCount, sizeof(clusterCount)) || static_cast<std::size_t>(reader.end - reader.cur) / sizeof(MeshCluster) < clusterCount)
+            {
+                return false;
+            }
+
+            range.clusters.resize(clusterCount);
+            if(!reader.read(range.clusters.data(), clusterCount * sizeof(MeshCluster)))
+            {
+                return false;
+            }
+        }
+
+        reader.align(4, cache.file.data);
+        object.vertexCount = counts[0];
+        object.vertices = reader.view<Vertex>(counts[0]);
+        object.indexCount = counts[1];
+        object.indices = reader.view<unsigned int>(counts[1]);
+        if((counts[0] && !object.vertices) || (counts[1] && !object.indices) || !detail::rangesValid(object))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool meshCacheObjectValid(const MeshCacheObject& object)
+{
+    for(unsigned int i = 0; i < object.indexCount; i++)
+    {
+        if(object.indices[i] >= object.vertexCount)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool meshCacheBegin(MeshCacheWriter& writer, const std::string& sourcePath, const std::vector<std::string>& materialLibraries, unsigned int flags)
+{
+    writer = MeshCacheWriter{};
+
+    FileStamp stamp;
+    if(!fileStamp(sourcePath, stamp))
+    {
+        return false;
+    }
+
+    /* zeroed so the padding bytes of the header are deterministic, the object count is filled in at the end */
+    detail::MeshCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, detail::MESH_CACHE_MAGIC, sizeof(header.magic));
+    header.version = MESH_CACHE_VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.sourceSize = stamp.size;
+    header.sourceTime = stamp.time;
+    header.sourceHash = stamp.hash;
+    header.libraryCount = static_cast<std::uint32_t>(materialLibraries.size());
+    header.objectCount = 0;
+    header.flags = flags;
+
+    /* write to a temporary file first so a crash never leaves a truncated blob behind */
+    writer.path = meshCachePath(sourcePath, flags);
+    writer.tmpPath = writer.path + ".tmp";
+    writer.out.open(writer.tmpPath, std::ios::binary | std::ios::trunc);
+
+    detail::BlobWriter blob{writer};
+    blob.write(&header, sizeof(header));
+    for(const auto& library : materialLibraries)
+    {
+        blob.writeString(library);
+    }
+
+    if(!writer.out)
+    {
+        std::cerr << "[MeshCache] couldn't write cache file " << writer.tmpPath << std::endl;
+        writer.out.close();
+        return false;
+    }
+    return true;
+}
+
+void meshCacheAppend(MeshCacheWriter& writer, const ObjObject& object)
+{
+    if(!writer.out.is_open())
+    {
+        return;
+    }
+
+    std::uint32_t counts[3] = {
+        static_cast<std::uint32_t>(object.vertices.size()),
+        static_cast<std::uint32_t>(object.indices.size()),
+        static_cast<std::uint32_t>(object.material.size())
+    };
+
+    detail::BlobWriter blob{writer};
+    blob.writeString(object.name);
+    blob.write(counts, sizeof(counts));
+
+    for(const auto& range : object.material)
+    {
+        blob.writeString(range.material);
+        blob.write(&range.indexOffset, sizeof(range.indexOffset));
+        blob.write(&range.indexCount, sizeof(range.indexCount));
+
+        std::uint32_t lodCount = static_cast<std::uint32_t>(range.lod.size());
+        blob.write(&lodCount, sizeof(lodCount));
+        blob.write(range.lod.data(), range.lod.size() * sizeof(MaterialLod));
+
+        std::uint32_t clusterCount = static_cast<std::uint32_t>(range.clusters.size());
+        blob.write(&clusterCount, sizeof(clusterCount));
+        blob.write(range.clusters.data(), range.clusters.size() * sizeof(MeshCluster));
+    }
+
+    blob.align(4);
+    blob.write(object.vertices.data(), object.vertices.size() * sizeof(Vertex));
+    blob.write(object.indices.data(), object.indices.size() * sizeof(unsigned int));
+    writer.objectCount++;
+}
+
+void meshCacheFinish(MeshCacheWriter& writer)
+{
+    if(!writer.out.is_open())
+    {
+        return;
+    }
+
+    writer.out.seekp(offsetof(detail::MeshCacheHeader, objectCount));
+    writer.out.write(reinterpret_cast<const char*>(&writer.objectCount), sizeof(writer.objectCount));
+    writer.out.close();
+
+    std::error_code error;
+    if(!writer.out)
+    {
+        std::cerr << "[MeshCache] couldn't write cache file " << writer.tmpPath << std::endl;
+        std::filesystem::remove(writer.tmpPath, error);
+        return;
+    }
+
+    std::filesystem::rename(writer.tmpPath, writer.path, error);
+    if(error)
+    {
+        std::cerr << "[MeshCache] couldn't write cache file " << writer.path << ": " << error.message() << std::endl;
+        std::filesystem::remove(writer.tmpPath, error);
+    }
+}
+
+void meshCacheWrite(const std::string& sourcePath, const ObjData& data, unsigned int flags)
+{
+    MeshCacheWriter writer;
+    if(!meshCacheBegin(writer, sourcePath, data.materialLibraries, flags))
+    {
+        return;
+    }
+
+    for(const auto& object : data.objects)
+    {
+        meshCacheAppend(writer, object);
+    }
+    meshCacheFinish(writer);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "model.h"
+#include "file_map.h"
+
+#include <cstdint>
+#include <fstream>
+
+/* version of the binary mesh cache format, bump whenever the blob layout or struct Vertex changes */
+#define MESH_CACHE_VERSION 4
+
+/* one object of a mesh cache blob, vertex and index data point directly into the mapped file */
+struct MeshCacheObject
+{
+    std::string name;
+
+    const Vertex* vertices = nullptr;
+    unsigned int vertexCount = 0;
+
+    const unsigned int* indices = nullptr;
+    unsigned int indexCount = 0;
+
+    std::vector<ObjMaterialRange> material;
+};
+
+struct MeshCache
+{
+    FileMap file;
+
+    std::vector<std::string> materialLibraries;
+    std::vector<MeshCacheObject> objects;
+};
+
+/**
+ * @brief Path of the binary mesh cache blob that belongs to an OBJ file (stored next to it, one per set of load flags,
+ * so loads with different flags never replace each other's blob).
+ *
+ * @param sourcePath Path to the OBJ file.
+ * @param flags eModelLoadFlags the blob is written with.
+ *
+ * @return Path to the cache blob.
+ */
+std::string meshCachePath(const std::string& sourcePath, unsigned int flags);
+
+/**
+ * @brief Maps the mesh cache blob of an OBJ file. The blob is only accepted if format version, vertex layout, load
+ * flags and the size, modification time and content hash of the OBJ file still match, and if all index ranges stay
+ * within the index array of their object. The indices themselves are not read here, so the objects can be consumed one
+ * at a time; check each one with meshCacheObjectValid before it is used.
+ *
+ * @param sourcePath Path to the OBJ file.
+ * @param flags eModelLoadFlags the blob has to be written with.
+ * @param cache Receives the mapped blob on success.
+ *
+ * @return True if a valid cache was found, false if it is missing, stale or corrupt.
+ */
+bool meshCacheLoad(const std::string& sourcePath, unsigned int flags, MeshCache& cache);
+
+/**
+ * @brief Checks that every index of a cached object addresses one of its vertices, a stale or damaged blob must never
+ * reach glBufferData with indices that draw out of bounds.
+ *
+ * @param object Object of a blob accepted by meshCacheLoad.
+ *
+ * @return True if the object can be used.
+ */
+bool meshCacheObjectValid(const MeshCacheObject& object);
+
+/**
+ * @brief Writes the final vertex/index arrays and material ranges of a parsed OBJ file into its cache blob. Failing
+ * to write (e.g. read-only asset folder) is reported but not an error.
+ *
+ * @param sourcePath Path to the OBJ file the data was parsed from.
+ * @param data Parsed data.
+ * @param flags eModelLoadFlags that were applied to the data.
+ */
+void meshCacheWrite(const std::string& sourcePath, const ObjData& data, unsigned int flags);
+
+/* mesh cache blob that is written object by object (see meshCacheBegin) */
+struct MeshCacheWriter
+{
+    std::string path;
+    std::string tmpPath;
+    std::ofstream out;
+
+    std::uint64_t size = 0;
+    std::uint32_t objectCount = 0;
+};
+
+/**
+ * @brief Starts writing the mesh cache blob of an OBJ file without holding all objects in memory: the header and
+ * material libraries are written to a temporary file right away, objects follow with meshCacheAppend and
+ * meshCacheFinish replaces the old blob. Failing to write is reported but not an error, the writer then ignores the
+ * following calls.
+ *
+ * @param writer Writer to start.
+ * @param sourcePath Path to the OBJ file the data is parsed from.
+ * @param materialLibraries Material library paths of the file.
+ * @param flags eModelLoadFlags that are applied to the data.
+ *
+ * @return True if the blob could be started.
+ */
+bool meshCacheBegin(MeshCacheWriter& writer, const std::string& sourcePath, const std::vector<std::string>& materialLibraries, unsigned int flags);
+
+/**
+ * @brief Appends the final vertex/index arrays and material ranges of one object to a started blob.
+ *
+ * @param writer Started writer.
+ * @param object Object to append.
+ */
+void meshCacheAppend(MeshCacheWriter& writer, const ObjObject& object);
+
+/**
+ * @brief Completes the header of a started blob and moves it into place.
+ *
+ * @param writer Started writer.
+ */
+void meshCacheFinish(MeshCacheWriter& writer);
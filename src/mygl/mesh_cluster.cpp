@@ -0,0 +1,218 @@
+#include "mesh_cluster.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace detail
+{
+
+/* below this normal agreement a cluster that already has its minimum size stops growing */
+const float CLUSTER_GROW_COS = 0.5f;
+
+/* bounding sphere and normal cone of the triangles [begin, end) of a list */
+MeshCluster clusterBounds(const unsigned int* indices, std::size_t begin, std::size_t end, const Vertex* vertices,
+                          const std::vector<Vector3D>& normals, const std::vector<bool>& reliable)
+{
+    MeshCluster cluster;
+
+    Vector3D min = vertices[indices[begin * 3]].pos, max = min;
+    Vector3D axis;
+    for(std::size_t t = begin; t < end; t++)
+    {
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            const Vector3D& p = vertices[indices[t * 3 + k]].pos;
+            for(unsigned int c = 0; c < 3; c++)
+            {
+                min[c] = std::min(min[c], p[c]);
+                max[c] = std::max(max[c], p[c]);
+            }
+        }
+        axis += normals[t];
+    }
+
+    cluster.center = (min + max) * 0.5f;
+    for(std::size_t i = begin * 3; i < end * 3; i++)
+    {
+        cluster.radius = std::max(cluster.radius, length(vertices[indices[i]].pos - cluster.center));
+    }
+
+    /* a cone is only usable if every triangle has a proper normal and a winding that matches its vertex normals */
+    float axisLength = length(axis);
+    cluster.coneAxis = axisLength > 0.0f ? axis / axisLength : Vector3D(0.0f, 0.0f, 1.0f);
+    cluster.coneCos = axisLength > 0.0f ? 1.0f : 0.0f;
+    for(std::size_t t = begin; t < end; t++)
+    {
+        float agreement = reliable[t] ? dot(normals[t], cluster.coneAxis) : 0.0f;
+        cluster.coneCos = std::min(cluster.coneCos, agreement);
+    }
+    return cluster;
+}
+
+}
+
+std::vector<MeshCluster> meshClusterize(unsigned int* indices, std::size_t indexCount, const Vertex* vertices, std::size_t vertexCount, unsigned int indexOffset)
+{
+    const std::size_t triangleCount = indexCount / 3;
+    std::vector<MeshCluster> clusters;
+    if(triangleCount == 0)
+    {
+        return clusters;
+    }
+
+    /* unit face normals, and whether the winding agrees with the vertex normals of the triangle */
+    std::vector<Vector3D> normals(triangleCount);
+    std::vector<bool> reliable(triangleCount, false);
+    for(std::size_t t = 0; t < triangleCount; t++)
+    {
+        const Vertex& a = vertices[indices[t * 3 + 0]];
+        const Vertex& b = vertices[indices[t * 3 + 1]];
+        const Vertex& c = vertices[indices[t * 3 + 2]];
+        Vector3D n = cross(b.pos - a.pos, c.pos - a.pos);
+        float area = length(n);
+        if(area > 0.0f)
+        {
+            normals[t] = n / area;
+            reliable[t] = dot(normals[t], Vector3D(a.normal) + Vector3D(b.normal) + Vector3D(c.normal)) > 0.0f;
+        }
+    }
+
+    /* triangles around each vertex */
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for(std::size_t i = 0; i < triangleCount * 3; i++)
+    {
+        offsets[indices[i] + 1]++;
+    }
+    for(std::size_t v = 0; v < vertexCount; v++)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<unsigned int> adjacent(triangleCount * 3);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for(std::size_t i = 0; i < triangleCount * 3; i++)
+    {
+        adjacent[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+
+    const unsigned int NONE = 0xFFFFFFFFu;
+    std::vector<unsigned int> clusterOf(triangleCount, NONE);   // cluster a triangle was assigned to
+    std::vector<unsigned int> candidateOf(triangleCount, NONE); // last cluster a triangle was a candidate of
+    std::vector<unsigned int> vertexOf(vertexCount, NONE);      // last cluster a vertex was used by
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> clusterStart;
+    std::vector<unsigned int> order;
+    order.reserve(triangleCount);
+
+    /* seeds in list order, so clusters follow the (cache optimized) order of the input */
+    std::size_t seed = 0;
+    while(order.size() < triangleCount)
+    {
+        while(clusterOf[seed] != NONE)
+        {
+            seed++;
+        }
+
+        const unsigned int id = static_cast<unsigned int>(clusterStart.size());
+        clusterStart.push_back(static_cast<unsigned int>(order.size()));
+        candidates.clear();
+        Vector3D axisSum;
+
+        auto add = [&](unsigned int t) {
+            clusterOf[t] = id;
+            order.push_back(t);
+            axisSum += normals[t];
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[t * 3 + k];
+                vertexOf[v] = id;
+                for(unsigned int a = offsets[v]; a < offsets[v + 1]; a++)
+                {
+                    unsigned int u = adjacent[a];
+                    if(clusterOf[u] == NONE && candidateOf[u] != id)
+                    {
+                        candidateOf[u] = id;
+                        candidates.push_back(u);
+                    }
+                }
+            }
+        };
+
+        add(static_cast<unsigned int>(seed));
+        for(unsigned int size = 1; size < CLUSTER_MAX_TRIANGLES; size++)
+        {
+            /* best neighbour: most vertices already in the cluster, then closest to the average normal */
+            float axisLength = length(axisSum);
+            Vector3D axis = axisLength > 0.0f ? axisSum / axisLength : Vector3D();
+            long long best = -1;
+            float bestScore = -1e30f, bestCos = 0.0f;
+            for(std::size_t c = 0; c < candidates.size();)
+            {
+                unsigned int u = candidates[c];
+                if(clusterOf[u] != NONE)
+                {
+                    candidates[c] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+
+                unsigned int shared = (vertexOf[indices[u * 3 + 0]] == id) + (vertexOf[indices[u * 3 + 1]] == id) + (vertexOf[indices[u * 3 + 2]] == id);
+                float agreement = dot(normals[u], axis);
+                float score = static_cast<float>(shared) + agreement;
+                if(score > bestScore)
+                {
+                    bestScore = score;
+                    bestCos = agreement;
+                    best = u;
+                }
+                c++;
+            }
+
+            /* disconnected pieces end a cluster early, bends only once it has its minimum size */
+            if(best < 0 || (size >= CLUSTER_MIN_TRIANGLES && bestCos < detail::CLUSTER_GROW_COS))
+            {
+                break;
+            }
+            add(static_cast<unsigned int>(best));
+        }
+    }
+    clusterStart.push_back(static_cast<unsigned int>(order.size()));
+
+    /* triangles keep their relative input order inside a cluster, which keeps most of the vertex cache order */
+    std::vector<unsigned int> input(indices, indices + triangleCount * 3);
+    for(std::size_t c = 0; c + 1 < clusterStart.size(); c++)
+    {
+        std::sort(order.begin() + clusterStart[c], order.begin() + clusterStart[c + 1]);
+    }
+    std::vector<Vector3D> inputNormals = std::move(normals);
+    std::vector<bool> inputReliable = std::move(reliable);
+    normals.resize(triangleCount);
+    reliable.resize(triangleCount);
+    for(std::size_t t = 0; t < triangleCount; t++)
+    {
+        std::copy(input.begin() + order[t] * 3, input.begin() + order[t] * 3 + 3, indices + t * 3);
+        normals[t] = inputNormals[order[t]];
+        reliable[t] = inputReliable[order[t]];
+    }
+
+    clusters.reserve(clusterStart.size() - 1);
+    for(std::size_t c = 0; c + 1 < clusterStart.size(); c++)
+    {
+        MeshCluster& cluster = clusters.emplace_back(detail::clusterBounds(indices, clusterStart[c], clusterStart[c + 1], vertices, normals, reliable));
+        cluster.indexOffset = indexOffset + clusterStart[c] * 3;
+        cluster.indexCount = (clusterStart[c + 1] - clusterStart[c]) * 3;
+    }
+    return clusters;
+}
+
+bool meshClusterBackfacing(const MeshCluster& cluster, const Vector3D& viewPosition)
+{
+    if(cluster.coneCos <= 0.0f)
+    {
+        return false;
+    }
+
+    /* every normal n within the cone and point p within the sphere satisfy dot(n, p - view) >= 0 */
+    Vector3D d = cluster.center - viewPosition;
+    float coneSin = std::sqrt(std::max(0.0f, 1.0f - cluster.coneCos * cluster.coneCos));
+    return cluster.coneCos * dot(d, cluster.coneAxis) >= coneSin * length(d) + cluster.radius;
+}
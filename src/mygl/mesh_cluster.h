@@ -0,0 +1,53 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cstddef>
+#include <vector>
+
+/* triangle count of the clusters built by meshClusterize */
+#define CLUSTER_MIN_TRIANGLES 64
+#define CLUSTER_MAX_TRIANGLES 128
+
+/* contiguous run of triangles of a material range with bounds for visibility tests */
+struct MeshCluster
+{
+    unsigned int indexOffset = 0;
+    unsigned int indexCount = 0;
+
+    /* bounding sphere of the vertices */
+    Vector3D center;
+    float radius = 0.0f;
+
+    /* normal cone: all triangle normals are within acos(coneCos) of the axis, coneCos <= 0 means the cone is too
+       wide (or the winding unreliable) to ever cull the cluster */
+    Vector3D coneAxis;
+    float coneCos = 0.0f;
+};
+
+/**
+ * @brief Splits a triangle list into clusters of CLUSTER_MIN_TRIANGLES to CLUSTER_MAX_TRIANGLES connected triangles
+ * with similar normals and reorders it so every cluster is a contiguous index run. Clusters grow from a seed
+ * triangle over shared vertices, preferring triangles that keep the normal cone narrow. Inside a cluster the
+ * triangles keep their input order, so a vertex cache optimized list stays mostly cache friendly.
+ *
+ * @param indices Triangle list, reordered in place.
+ * @param indexCount Number of indices.
+ * @param vertices Vertices referenced by the indices.
+ * @param vertexCount Number of vertices.
+ * @param indexOffset Added to the index offsets of the returned clusters (position of the list in the index buffer).
+ *
+ * @return Clusters in the order of the reordered list.
+ */
+std::vector<MeshCluster> meshClusterize(unsigned int* indices, std::size_t indexCount, const Vertex* vertices, std::size_t vertexCount, unsigned int indexOffset);
+
+/**
+ * @brief Conservative backface test of a whole cluster: true only if every triangle of it faces away from the viewer
+ * for any point inside the bounding sphere.
+ *
+ * @param cluster Cluster to test.
+ * @param viewPosition Camera position in the space of the cluster (object space).
+ *
+ * @return True if the cluster can be skipped.
+ */
+bool meshClusterBackfacing(const MeshCluster& cluster, const Vector3D& viewPosition);
@@ -0,0 +1,352 @@
+#include "mesh_optimize.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+
+namespace detail
+{
+
+/* FIFO cache as time stamps: a vertex is cached while less than size misses happened since it was loaded */
+struct FifoCache
+{
+    std::vector<unsigned int> loaded;
+    unsigned int time;
+    unsigned int size;
+
+    FifoCache(std::size_t vertexCount, unsigned int cacheSize)
+        : loaded(vertexCount, 0), time(cacheSize + 1), size(cacheSize)
+    {
+    }
+
+    bool cached(unsigned int v) const
+    {
+        return time - loaded[v] <= size;
+    }
+
+    /* returns true on a miss */
+    bool access(unsigned int v)
+    {
+        if(cached(v))
+        {
+            return false;
+        }
+        loaded[v] = time++;
+        return true;
+    }
+
+    void flush()
+    {
+        time += size + 1;
+    }
+};
+
+/* triangles around each vertex in compressed row form */
+struct Adjacency
+{
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> triangles;
+    std::vector<unsigned int> live;
+};
+
+Adjacency buildAdjacency(const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount)
+{
+    Adjacency adjacency;
+    adjacency.live.assign(vertexCount, 0);
+    for(std::size_t i = 0; i < indexCount; i++)
+    {
+        adjacency.live[indices[i]]++;
+    }
+
+    adjacency.offsets.resize(vertexCount + 1, 0);
+    for(std::size_t v = 0; v < vertexCount; v++)
+    {
+        adjacency.offsets[v + 1] = adjacency.offsets[v] + adjacency.live[v];
+    }
+
+    adjacency.triangles.resize(indexCount);
+    std::vector<unsigned int> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+    for(std::size_t i = 0; i < indexCount; i++)
+    {
+        adjacency.triangles[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+    }
+    return adjacency;
+}
+
+/* area weighted centroid and normal of triangles [begin, end) */
+void clusterBounds(const unsigned int* indices, std::size_t begin, std::size_t end, const Vertex* vertices, Vector3D& centroid, Vector3D& normal)
+{
+    centroid = Vector3D(0.0f, 0.0f, 0.0f);
+    normal = Vector3D(0.0f, 0.0f, 0.0f);
+    float area = 0.0f;
+    for(std::size_t t = begin; t < end; t++)
+    {
+        const Vector3D& a = vertices[indices[t * 3 + 0]].pos;
+        const Vector3D& b = vertices[indices[t * 3 + 1]].pos;
+        const Vector3D& c = vertices[indices[t * 3 + 2]].pos;
+
+        Vector3D n = cross(b - a, c - a);
+        float triangleArea = length(n);
+        centroid += (a + b + c) * (triangleArea / 3.0f);
+        normal += n;
+        area += triangleArea;
+    }
+
+    if(area > 0.0f)
+    {
+        centroid /= area;
+    }
+    if(length(normal) > 0.0f)
+    {
+        normal = normalize(normal);
+    }
+}
+
+}
+
+VertexCacheStats vertexCacheStats(const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    if(indexCount < 3 || vertexCount == 0)
+    {
+        return stats;
+    }
+
+    detail::FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> used(vertexCount, false);
+    std::size_t misses = 0, usedCount = 0;
+    for(std::size_t i = 0; i < indexCount; i++)
+    {
+        misses += cache.access(indices[i]);
+        if(!used[indices[i]])
+        {
+            used[indices[i]] = true;
+            usedCount++;
+        }
+    }
+
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(usedCount);
+    return stats;
+}
+
+void optimizeVertexCache(unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, std::vector<unsigned int>* clusters)
+{
+    const unsigned int cacheSize = VERTEX_CACHE_SIZE;
+    const std::size_t triangleCount = indexCount / 3;
+    if(clusters)
+    {
+        clusters->clear();
+    }
+    if(triangleCount == 0)
+    {
+        return;
+    }
+
+    detail::Adjacency adjacency = detail::buildAdjacency(indices, triangleCount * 3, vertexCount);
+    std::vector<unsigned int> input(indices, indices + triangleCount * 3);
+    std::vector<bool> emitted(triangleCount, false);
+    detail::FifoCache cache(vertexCount, cacheSize);
+
+    std::vector<unsigned int> deadEnd;      // recently used vertices, the fallback when the fan runs dry
+    std::vector<unsigned int> candidates;   // vertices of the triangles emitted for the current fan
+    std::size_t cursor = 0;                 // next vertex to try once the dead end stack is empty
+    std::size_t out = 0;
+
+    /* skips to a vertex that still has triangles: dead end stack first, then in input order */
+    auto skipDeadEnd = [&]() -> long long {
+        while(!deadEnd.empty())
+        {
+            unsigned int v = deadEnd.back();
+            deadEnd.pop_back();
+            if(adjacency.live[v] > 0)
+            {
+                return v;
+            }
+        }
+        while(cursor < vertexCount)
+        {
+            if(adjacency.live[cursor] > 0)
+            {
+                return static_cast<long long>(cursor);
+            }
+            cursor++;
+        }
+        return -1;
+    };
+
+    long long fan = skipDeadEnd();
+    if(clusters)
+    {
+        clusters->push_back(0);
+    }
+
+    while(fan >= 0)
+    {
+        candidates.clear();
+
+        /* emit all remaining triangles around the fanning vertex */
+        for(unsigned int a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1]; a++)
+        {
+            unsigned int t = adjacency.triangles[a];
+            if(emitted[t])
+            {
+                continue;
+            }
+            emitted[t] = true;
+
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int v = input[t * 3 + k];
+                indices[out++] = v;
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                adjacency.live[v]--;
+                cache.access(v);
+            }
+        }
+
+        /* next fan: the candidate that stays in the cache longest once all its triangles are emitted */
+        long long next = -1;
+        long long best = -1;
+        for(unsigned int v : candidates)
+        {
+            if(adjacency.live[v] == 0)
+            {
+                continue;
+            }
+
+            long long priority = 0;
+            long long age = static_cast<long long>(cache.time) - cache.loaded[v];
+            if(age + 2 * static_cast<long long>(adjacency.live[v]) <= cacheSize)
+            {
+                priority = age;
+            }
+            if(priority > best)
+            {
+                best = priority;
+                next = v;
+            }
+        }
+
+        if(next < 0)
+        {
+            next = skipDeadEnd();
+
+            /* the cache effectively restarts here, a natural cluster boundary for overdraw ordering */
+            if(clusters && next >= 0 && out < triangleCount * 3)
+            {
+                clusters->push_back(static_cast<unsigned int>(out / 3));
+            }
+        }
+        fan = next;
+    }
+}
+
+void optimizeOverdraw(unsigned int* indices, std::size_t indexCount, const Vertex* vertices, std::size_t vertexCount, const std::vector<unsigned int>& clusters, float threshold)
+{
+    const std::size_t triangleCount = indexCount / 3;
+    if(triangleCount == 0 || clusters.empty())
+    {
+        return;
+    }
+
+    /* split hard clusters where the running miss ratio already dropped below the cluster average */
+    std::vector<unsigned int> soft;
+    detail::FifoCache cache(vertexCount, VERTEX_CACHE_SIZE);
+    for(std::size_t c = 0; c < clusters.size(); c++)
+    {
+        std::size_t begin = clusters[c];
+        std::size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+        cache.flush();
+        std::size_t clusterMisses = 0;
+        for(std::size_t t = begin; t < end; t++)
+        {
+            clusterMisses += cache.access(indices[t * 3 + 0]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+        }
+        float limit = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - begin);
+
+        cache.flush();
+        soft.push_back(static_cast<unsigned int>(begin));
+        std::size_t start = begin, misses = 0;
+        for(std::size_t t = begin; t < end; t++)
+        {
+            misses += cache.access(indices[t * 3 + 0]) + cache.access(indices[t * 3 + 1]) + cache.access(indices[t * 3 + 2]);
+
+            /* a split restarts the cache, so clusters need a minimum size to pay off */
+            if(t + 1 < end && t + 1 - start >= 32 && static_cast<float>(misses) / static_cast<float>(t + 1 - start) <= limit)
+            {
+                soft.push_back(static_cast<unsigned int>(t + 1));
+                start = t + 1;
+                misses = 0;
+                cache.flush();
+            }
+        }
+    }
+
+    /* outward facing clusters (relative to the range centroid) first */
+    Vector3D meshCentroid, meshNormal;
+    detail::clusterBounds(indices, 0, triangleCount, vertices, meshCentroid, meshNormal);
+
+    std::vector<float> sortKey(soft.size());
+    for(std::size_t c = 0; c < soft.size(); c++)
+    {
+        std::size_t end = c + 1 < soft.size() ? soft[c + 1] : triangleCount;
+        Vector3D centroid, normal;
+        detail::clusterBounds(indices, soft[c], end, vertices, centroid, normal);
+        sortKey[c] = dot(centroid - meshCentroid, normal);
+    }
+
+    std::vector<unsigned int> order(soft.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<unsigned int> input(indices, indices + triangleCount * 3);
+    std::size_t out = 0;
+    for(unsigned int c : order)
+    {
+        std::size_t begin = soft[c] * 3;
+        std::size_t end = c + 1 < soft.size() ? soft[c + 1] * 3 : triangleCount * 3;
+        std::copy(input.begin() + begin, input.begin() + end, indices + out);
+        out += end - begin;
+    }
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    const unsigned int NONE = 0xFFFFFFFFu;
+    std::vector<unsigned int> remap(vertices.size(), NONE);
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for(auto& index : indices)
+    {
+        if(remap[index] == NONE)
+        {
+            remap[index] = static_cast<unsigned int>(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices = std::move(reordered);
+}
+
+void meshOptimize(ObjObject& object)
+{
+    /* objects without 'usemtl' are one range */
+    std::vector<ObjMaterialRange> ranges = object.material;
+    if(ranges.empty())
+    {
+        ranges.push_back(ObjMaterialRange{"", 0, static_cast<unsigned int>(object.indices.size())});
+    }
+
+    std::vector<unsigned int> clusters;
+    for(const auto& range : ranges)
+    {
+        unsigned int* indices = object.indices.data() + range.indexOffset;
+        optimizeVertexCache(indices, range.indexCount, object.vertices.size(), &clusters);
+        optimizeOverdraw(indices, range.indexCount, object.vertices.data(), object.vertices.size(), clusters);
+    }
+    optimizeVertexFetch(object.vertices, object.indices);
+}
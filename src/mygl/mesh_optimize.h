@@ -0,0 +1,70 @@
+#pragma once
+
+#include "model.h"
+
+#include <cstddef>
+
+/* FIFO size the reordering targets, small enough to be pessimistic for current GPUs */
+#define VERTEX_CACHE_SIZE 16
+
+/* post-transform vertex cache efficiency of an index buffer */
+struct VertexCacheStats
+{
+    float acmr = 0.0f; // average cache miss ratio: transformed vertices per triangle (0.5 ideal, 3 worst)
+    float atvr = 0.0f; // average transformed vertex ratio: transformed vertices per vertex (1 ideal)
+};
+
+/**
+ * @brief Simulates a FIFO post-transform vertex cache over an index buffer.
+ *
+ * @param indices Triangle list.
+ * @param indexCount Number of indices.
+ * @param vertexCount Number of vertices referenced by the indices.
+ * @param cacheSize Number of cache entries.
+ *
+ * @return ACMR and ATVR of the index buffer.
+ */
+VertexCacheStats vertexCacheStats(const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+/**
+ * @brief Reorders the triangles of an index range for the post-transform vertex cache (Tipsify, Sander et al. 2007).
+ * Linear in the number of triangles.
+ *
+ * @param indices Triangle list, reordered in place.
+ * @param indexCount Number of indices.
+ * @param vertexCount Number of vertices referenced by the indices.
+ * @param clusters If not null, receives the first triangle of every cluster: runs of triangles after which the cache
+ * had to restart (used by optimizeOverdraw).
+ */
+void optimizeVertexCache(unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, std::vector<unsigned int>* clusters = nullptr);
+
+/**
+ * @brief Sorts the clusters of a cache optimized index range so that outward facing clusters come first, which lets
+ * early depth testing reject more of the later ones. Clusters are split further once the running miss ratio inside
+ * them drops to threshold times the cluster average, so the extra splits barely affect the cache.
+ *
+ * @param indices Triangle list as produced by optimizeVertexCache, reordered in place.
+ * @param indexCount Number of indices.
+ * @param vertices Vertices referenced by the indices.
+ * @param vertexCount Number of vertices.
+ * @param clusters Cluster starts as returned by optimizeVertexCache.
+ * @param threshold Split point relative to the cluster ACMR, higher values split more often.
+ */
+void optimizeOverdraw(unsigned int* indices, std::size_t indexCount, const Vertex* vertices, std::size_t vertexCount, const std::vector<unsigned int>& clusters, float threshold = 1.0f);
+
+/**
+ * @brief Renumbers the vertices in the order the index buffer first references them, so vertex fetches walk through
+ * memory linearly. Unreferenced vertices are dropped.
+ *
+ * @param vertices Vertex array, reordered (and shrunk) in place.
+ * @param indices Index buffer, rewritten in place.
+ */
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+/**
+ * @brief Runs vertex cache and overdraw optimization on every material range of an object, followed by a vertex
+ * fetch reorder of the whole object. Material ranges keep their offset and count.
+ *
+ * @param object Object to optimize.
+ */
+void meshOptimize(ObjObject& object);
@@ -0,0 +1,252 @@
+#include "mesh_simplify.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+
+namespace detail
+{
+
+/* symmetric 4x4 error quadric of a set of planes, error(p) = p^T Q p with p = (x, y, z, 1) */
+struct Quadric
+{
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+    double weight = 0;
+
+    void addPlane(double nx, double ny, double nz, double d, double weight)
+    {
+        a00 += weight * nx * nx; a01 += weight * nx * ny; a02 += weight * nx * nz; a03 += weight * nx * d;
+        a11 += weight * ny * ny; a12 += weight * ny * nz; a13 += weight * ny * d;
+        a22 += weight * nz * nz; a23 += weight * nz * d;
+        a33 += weight * d * d;
+        this->weight += weight;
+    }
+
+    Quadric& operator+=(const Quadric& q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23;
+        a33 += q.a33;
+        weight += q.weight;
+        return *this;
+    }
+
+    double error(const Vector3D& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double e = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+                 + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+                 + a22 * z * z + 2 * a23 * z
+                 + a33;
+        return std::max(e, 0.0);
+    }
+};
+
+struct Collapse
+{
+    unsigned int from;
+    unsigned int to;
+    double cost;
+    double weight;
+};
+
+inline std::uint64_t edgeKey(unsigned int a, unsigned int b)
+{
+    return a < b ? (std::uint64_t(a) << 32) | b : (std::uint64_t(b) << 32) | a;
+}
+
+/* true if replacing 'from' by 'to' keeps the orientation of all triangles around 'from' that survive */
+bool collapseKeepsOrientation(const Vertex* vertices, const std::vector<unsigned int>& indices, const std::vector<unsigned int>& offsets,
+                              const std::vector<unsigned int>& triangles, unsigned int from, unsigned int to)
+{
+    for(unsigned int a = offsets[from]; a < offsets[from + 1]; a++)
+    {
+        const unsigned int* t = &indices[triangles[a] * 3];
+        if(t[0] == to || t[1] == to || t[2] == to)
+        {
+            continue;
+        }
+
+        Vector3D p[3], q[3];
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            p[k] = vertices[t[k]].pos;
+            q[k] = vertices[t[k] == from ? to : t[k]].pos;
+        }
+
+        Vector3D before = cross(p[1] - p[0], p[2] - p[0]);
+        Vector3D after = cross(q[1] - q[0], q[2] - q[0]);
+        if(dot(before, after) <= 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+std::vector<unsigned int> meshSimplify(const Vertex* vertices, std::size_t vertexCount, const unsigned int* indices, std::size_t indexCount,
+                                       std::size_t targetIndexCount, float& error)
+{
+    std::vector<unsigned int> result(indices, indices + indexCount / 3 * 3);
+    double maxError = 0.0;
+    error = 0.0f;
+
+    /* plane quadrics, weighted by triangle area */
+    std::vector<detail::Quadric> quadrics(vertexCount);
+    for(std::size_t i = 0; i < result.size(); i += 3)
+    {
+        const Vector3D& a = vertices[result[i + 0]].pos;
+        const Vector3D& b = vertices[result[i + 1]].pos;
+        const Vector3D& c = vertices[result[i + 2]].pos;
+        Vector3D n = cross(b - a, c - a);
+        float area = length(n);
+        if(area <= 0.0f)
+        {
+            continue;
+        }
+        n /= area;
+        for(unsigned int k = 0; k < 3; k++)
+        {
+            quadrics[result[i + k]].addPlane(n.x, n.y, n.z, -dot(n, a), area * 0.5);
+        }
+    }
+
+    /* vertices on open or non-manifold edges are locked */
+    std::vector<bool> locked(vertexCount, false);
+    {
+        std::unordered_map<std::uint64_t, unsigned int> edgeCount;
+        edgeCount.reserve(result.size());
+        for(std::size_t i = 0; i < result.size(); i += 3)
+        {
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                edgeCount[detail::edgeKey(result[i + k], result[i + (k + 1) % 3])]++;
+            }
+        }
+        for(const auto& [key, count] : edgeCount)
+        {
+            if(count != 2)
+            {
+                locked[key >> 32] = true;
+                locked[key & 0xFFFFFFFFu] = true;
+            }
+        }
+    }
+
+    std::vector<unsigned int> offsets, triangles, fill;
+    std::vector<detail::Collapse> collapses;
+    std::vector<bool> touched(vertexCount);
+    std::vector<unsigned int> remap(vertexCount);
+
+    /* passes of independent collapses, cheapest first, until the target is reached or nothing can collapse */
+    while(result.size() > targetIndexCount)
+    {
+        /* triangles around each vertex */
+        offsets.assign(vertexCount + 1, 0);
+        for(unsigned int v : result)
+        {
+            offsets[v + 1]++;
+        }
+        for(std::size_t v = 0; v < vertexCount; v++)
+        {
+            offsets[v + 1] += offsets[v];
+        }
+        triangles.resize(result.size());
+        fill.assign(offsets.begin(), offsets.end() - 1);
+        for(std::size_t i = 0; i < result.size(); i++)
+        {
+            triangles[fill[result[i]]++] = static_cast<unsigned int>(i / 3);
+        }
+
+        /* collapse candidates along all edges, in both directions */
+        collapses.clear();
+        for(std::size_t i = 0; i < result.size(); i += 3)
+        {
+            for(unsigned int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+                for(auto [from, to] : {std::pair{a, b}, std::pair{b, a}})
+                {
+                    if(!locked[from])
+                    {
+                        detail::Quadric q = quadrics[from];
+                        q += quadrics[to];
+                        collapses.push_back(detail::Collapse{from, to, q.error(vertices[to].pos), q.weight});
+                    }
+                }
+            }
+        }
+        if(collapses.empty())
+        {
+            break;
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const detail::Collapse& a, const detail::Collapse& b) { return a.cost < b.cost; });
+
+        /* every collapse removes about two triangles */
+        std::size_t removeTriangles = (result.size() - targetIndexCount) / 3;
+        std::size_t removed = 0;
+        std::fill(touched.begin(), touched.end(), false);
+        for(std::size_t v = 0; v < vertexCount; v++)
+        {
+            remap[v] = static_cast<unsigned int>(v);
+        }
+
+        for(const auto& collapse : collapses)
+        {
+            if(removed >= removeTriangles)
+            {
+                break;
+            }
+            if(touched[collapse.from] || touched[collapse.to])
+            {
+                continue;
+            }
+            if(!detail::collapseKeepsOrientation(vertices, result, offsets, triangles, collapse.from, collapse.to))
+            {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            maxError = std::max(maxError, collapse.weight > 0.0 ? collapse.cost / collapse.weight : 0.0);
+
+            /* the triangles around 'from' change, their vertices wait for the next pass */
+            for(unsigned int a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++)
+            {
+                const unsigned int* t = &result[triangles[a] * 3];
+                removed += (t[0] == collapse.to || t[1] == collapse.to || t[2] == collapse.to);
+                touched[t[0]] = touched[t[1]] = touched[t[2]] = true;
+            }
+        }
+
+        if(removed == 0)
+        {
+            break;
+        }
+
+        /* apply the collapses and drop the triangles that became degenerate */
+        std::size_t out = 0;
+        for(std::size_t i = 0; i < result.size(); i += 3)
+        {
+            unsigned int a = remap[result[i + 0]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if(a != b && b != c && c != a)
+            {
+                result[out++] = a;
+                result[out++] = b;
+                result[out++] = c;
+            }
+        }
+        result.resize(out);
+    }
+
+    /* quadric error is a sum of squared, area weighted plane distances: dividing by the area gives the mean square */
+    error = static_cast<float>(std::sqrt(maxError));
+    return result;
+}
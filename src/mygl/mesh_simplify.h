@@ -0,0 +1,24 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Simplifies a triangle list with quadric error edge collapses (Garland and Heckbert 1997). Vertices are only
+ * ever collapsed onto other existing vertices, so the result indexes the same vertex buffer and can be appended to
+ * the index buffer of the mesh. Vertices on open or non-manifold edges stay in place, which also keeps UV and normal
+ * seams (welded vertices are split there) intact.
+ *
+ * @param vertices Vertex buffer the indices refer to.
+ * @param vertexCount Number of vertices.
+ * @param indices Triangle list to simplify.
+ * @param indexCount Number of indices.
+ * @param targetIndexCount Number of indices to aim for, the result is larger if no further collapse is possible.
+ * @param error Receives the largest geometric deviation of a collapse (object space units).
+ *
+ * @return Simplified triangle list.
+ */
+std::vector<unsigned int> meshSimplify(const Vertex* vertices, std::size_t vertexCount, const unsigned int* indices, std::size_t indexCount,
+                                       std::size_t targetIndexCount, float& error);
@@ -1,182 +1,680 @@
 #include "model.h"
+#include "draw_ring.h"
+#include "file_map.h"
+#include "glb.h"
+#include "mesh_cache.h"
+#include "mesh_optimize.h"
+#include "mesh_simplify.h"
+#include "thread_pool.h"
 
+#include <algorithm>
 #include <cassert>
-#include <fstream>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <map>
-#include <sstream>
+#include <memory>
 #include <iostream>
 #include <stdexcept>
+#include <string_view>
 
 namespace detail
 {
 
-void tokenize(std::string const &str, const char delim, std::vector<std::string> &out)
+inline bool isBlank(char c)
 {
-    size_t start;
-    size_t end = 0;
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skipBlanks(const char* p, const char* end)
+{
+    while(p < end && isBlank(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+/* returns next whitespace separated token of the current line and advances p behind it */
+inline std::string_view nextToken(const char*& p, const char* end)
+{
+    p = skipBlanks(p, end);
+    const char* start = p;
+    while(p < end && !isBlank(*p))
+    {
+        p++;
+    }
+    return std::string_view(start, static_cast<std::size_t>(p - start));
+}
+
+inline float nextFloat(const char*& p, const char* end)
+{
+    p = skipBlanks(p, end);
+    if(p < end && *p == '+')
+    {
+        p++;
+    }
 
-    while( (start = str.find_first_not_of(delim, end)) != std::string::npos )
+    float value = 0.0f;
+    auto [ptr, ec] = std::from_chars(p, end, value);
+    if(ec != std::errc())
     {
-        end = str.find(delim, start);
-        out.push_back(str.substr(start, end - start));
+        /* behave like a failed stream extraction: value 0, skip the garbage */
+        nextToken(p, end);
+        return 0.0f;
     }
+    p = ptr;
+    return value;
 }
 
+/* one corner of a face: v, v/vt, v//vn or v/vt/vn (1-based, 0 = not present) */
 struct Index
 {
-    enum eType
+    int v = 0;
+    int vt = 0;
+    int vn = 0;
+};
+
+inline bool nextIndex(const char*& p, const char* end, Index& index)
+{
+    p = skipBlanks(p, end);
+
+    index = Index{};
+    auto result = std::from_chars(p, end, index.v);
+    if(result.ec != std::errc())
+    {
+        return false;
+    }
+    p = result.ptr;
+
+    if(p < end && *p == '/')
     {
-        V = 1,
-        VN = 2,
-        VT = 4,
+        p++;
+        if(p < end && *p != '/')
+        {
+            result = std::from_chars(p, end, index.vt);
+            p = result.ptr;
+        }
+        if(p < end && *p == '/')
+        {
+            p++;
+            result = std::from_chars(p, end, index.vn);
+            p = result.ptr;
+        }
+    }
 
-        V_VN = V | VN,
-        V_VT_VN = V | VN | VT
+    /* skip whatever is left of the corner token */
+    while(p < end && !isBlank(*p))
+    {
+        p++;
+    }
+
+    return true;
+}
+
+/* resolves relative (negative) OBJ indices and checks the bounds */
+inline std::size_t resolveIndex(int index, std::size_t count)
+{
+    long long resolved = index < 0 ? static_cast<long long>(count) + index : static_cast<long long>(index) - 1;
+    if(resolved < 0 || resolved >= static_cast<long long>(count))
+    {
+        throw std::runtime_error("[Model] OBJ face index out of range: " + std::to_string(index));
+    }
+    return static_cast<std::size_t>(resolved);
+}
+
+/* flat open addressing hash map (v, vt, vn) -> vertex index, used to weld identical face corners of an object */
+struct VertexWelder
+{
+    static constexpr std::uint32_t NONE = 0xFFFFFFFFu;
+
+    struct Slot
+    {
+        std::uint32_t v = NONE;
+        std::uint32_t vt = NONE;
+        std::uint32_t vn = NONE;
+        std::uint32_t index = NONE;
     };
 
-    eType type = V;
-    unsigned int v = 0;
-    unsigned int vt = 0;
-    unsigned int vn = 0;
+    std::vector<Slot> slots = std::vector<Slot>(1024);
+    std::size_t count = 0;
 
-    friend std::stringstream& operator >>(std::stringstream& in, Index& index)
+    static std::size_t hash(std::uint32_t v, std::uint32_t vt, std::uint32_t vn)
     {
-        std::string data;
-        in >> data;
+        std::uint64_t h = v * 0x9E3779B97F4A7C15ull;
+        h ^= (vt + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+        h ^= (vn + 0x165667B19E3779F9ull) * 0x94D049BB133111EBull;
+        return static_cast<std::size_t>(h ^ (h >> 29));
+    }
 
-        std::vector<std::string> tokens;
-        tokenize(data, '/', tokens);
+    void grow()
+    {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
 
-        if(tokens.empty())
+        std::size_t mask = slots.size() - 1;
+        for(const auto& slot : old)
         {
-            return in;
+            if(slot.index == NONE)
+            {
+                continue;
+            }
+            std::size_t i = hash(slot.v, slot.vt, slot.vn) & mask;
+            while(slots[i].index != NONE)
+            {
+                i = (i + 1) & mask;
+            }
+            slots[i] = slot;
         }
+    }
 
-        index.v = std::stoi( tokens[0] );
-
-        if(tokens.size() == 2)
+    /* returns the index already assigned to the key, or assigns nextIndex and returns it */
+    std::uint32_t insert(std::uint32_t v, std::uint32_t vt, std::uint32_t vn, std::uint32_t nextIndex)
+    {
+        if(2 * (count + 1) > slots.size())
         {
-            index.vn = std::stoi( tokens[1] );
-            index.type = V_VN;
+            grow();
         }
-        else if(tokens.size() == 3)
+
+        std::size_t mask = slots.size() - 1;
+        std::size_t i = hash(v, vt, vn) & mask;
+        while(slots[i].index != NONE)
         {
-            index.vt = std::stoi( tokens[1] );
-            index.vn = std::stoi( tokens[2] );
-            index.type = V_VT_VN;
+            if(slots[i].v == v && slots[i].vt == vt && slots[i].vn == vn)
+            {
+                return slots[i].index;
+            }
+            i = (i + 1) & mask;
         }
 
-        return in;
+        slots[i] = Slot{v, vt, vn, nextIndex};
+        count++;
+        return nextIndex;
     }
 };
 
+inline void closeMaterialRange(ObjObject& object)
+{
+    if(!object.material.empty())
+    {
+        auto& range = object.material.back();
+        range.indexCount = static_cast<unsigned int>(object.indices.size()) - range.indexOffset;
+    }
+}
+
+/* calls line(begin, end) for every line in [begin, end) */
+template<typename F>
+inline void forEachLine(const char* begin, const char* end, F&& line)
+{
+    while(begin < end)
+    {
+        const char* lineEnd = static_cast<const char*>(std::memchr(begin, '\n', static_cast<std::size_t>(end - begin)));
+        if(lineEnd == nullptr)
+        {
+            lineEnd = end;
+        }
+        line(begin, lineEnd);
+        begin = lineEnd + 1;
+    }
 }
 
-std::map<std::string, Material> materialLoad(const std::string &filepath)
+/* number of attribute lines (v, vt, vn), used to place pool entries and to resolve relative indices */
+struct ObjCounts
+{
+    std::size_t v = 0;
+    std::size_t vt = 0;
+    std::size_t vn = 0;
+};
+
+/* counts an attribute line, returns false for any other command */
+inline bool countAttribute(std::string_view code, ObjCounts& counts)
 {
-    std::ifstream materialFile(filepath);
-    if(!materialFile.is_open())
+    if(code == "v")
     {
-        throw std::runtime_error("[Model] Couldn't open OBJ file at " + filepath);
+        counts.v++;
     }
+    else if(code == "vt")
+    {
+        counts.vt++;
+    }
+    else if(code == "vn")
+    {
+        counts.vn++;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
 
-    std::map<std::string, Material> materials;
-    Material* current = nullptr;
+/* byte range of the file handled by one pre-scan/attribute job */
+struct ObjChunk
+{
+    const char* begin = nullptr;
+    const char* end = nullptr;
 
-    /* consume material commands */
-    std::string line;
-    while(std::getline(materialFile, line))
+    /* attribute lines in the chunk, start of every 'o' line with the counts in front of it and material libraries */
+    ObjCounts counts;
+    std::vector<std::pair<const char*, ObjCounts>> objects;
+    std::vector<std::string> libraries;
+};
+
+/* attribute pools shared by all objects of the file, on the heap or spilled to a scratch file */
+struct ObjPools
+{
+    Vector3D* positions = nullptr;
+    Vector3D* normals = nullptr;
+    Vector2D* uvs = nullptr;
+
+    std::vector<float> heap;
+    ScratchMap scratch;
+};
+
+void objPoolsCreate(ObjPools& pools, const ObjCounts& counts, bool spill)
+{
+    std::size_t floats = 3 * counts.v + 3 * counts.vn + 2 * counts.vt;
+    float* storage = nullptr;
+    if(spill)
+    {
+        pools.scratch = scratchMapCreate(floats * sizeof(float));
+        storage = reinterpret_cast<float*>(pools.scratch.data);
+    }
+    else
     {
-        std::stringstream ss(line);
+        pools.heap.resize(floats);
+        storage = pools.heap.data();
+    }
+
+    pools.positions = std::uninitialized_default_construct_n(reinterpret_cast<Vector3D*>(storage), counts.v) - counts.v;
+    pools.normals = std::uninitialized_default_construct_n(reinterpret_cast<Vector3D*>(storage + 3 * counts.v), counts.vn) - counts.vn;
+    pools.uvs = std::uninitialized_default_construct_n(reinterpret_cast<Vector2D*>(storage + 3 * counts.v + 3 * counts.vn), counts.vt) - counts.vt;
+}
+
+/* drops the given pool entries of a spilled pool from memory, they stay in the scratch file */
+void objPoolsRelease(const ObjPools& pools, const ObjCounts& begin, const ObjCounts& counts)
+{
+    auto release = [&](const void* entry, std::size_t size) {
+        scratchMapRelease(pools.scratch, static_cast<std::size_t>(static_cast<const char*>(entry) - pools.scratch.data), size);
+    };
+    release(pools.positions + begin.v, counts.v * sizeof(Vector3D));
+    release(pools.normals + begin.vn, counts.vn * sizeof(Vector3D));
+    release(pools.uvs + begin.vt, counts.vt * sizeof(Vector2D));
+}
+
+void objPrescan(ObjChunk& chunk)
+{
+    forEachLine(chunk.begin, chunk.end, [&](const char* p, const char* lineEnd) {
+        const char* line = p;
+        std::string_view code = nextToken(p, lineEnd);
+        if(countAttribute(code, chunk.counts))
+        {
+            return;
+        }
+        else if(code == "o")
+        {
+            chunk.objects.emplace_back(line, chunk.counts);
+        }
+        /* material file (path in respect to .obj file) */
+        else if(code == "mtllib")
+        {
+            chunk.libraries.emplace_back(nextToken(p, lineEnd));
+        }
+    });
+}
+
+/* parses the attribute lines of a chunk into the pools, starting at the counts of all previous chunks */
+void objParseAttributes(const ObjChunk& chunk, ObjCounts base, ObjPools& pools)
+{
+    forEachLine(chunk.begin, chunk.end, [&](const char* p, const char* lineEnd) {
+        std::string_view code = nextToken(p, lineEnd);
+        if(code == "v")
+        {
+            auto& v = pools.positions[base.v++];
+            v.x = nextFloat(p, lineEnd);
+            v.y = nextFloat(p, lineEnd);
+            v.z = nextFloat(p, lineEnd);
+        }
+        else if(code == "vt")
+        {
+            auto& vt = pools.uvs[base.vt++];
+            vt.x = nextFloat(p, lineEnd);
+            vt.y = nextFloat(p, lineEnd);
+        }
+        else if(code == "vn")
+        {
+            auto& vn = pools.normals[base.vn++];
+            vn.x = nextFloat(p, lineEnd);
+            vn.y = nextFloat(p, lineEnd);
+            vn.z = nextFloat(p, lineEnd);
+        }
+    });
+}
+
+/*
+ * parses one object block ('o' line up to the next one) into welded vertex/index data. Attribute lines are only
+ * counted, so relative indices and bounds resolve exactly as in a front to back parse of the whole file.
+ */
+void objParseObject(const char* begin, const char* end, ObjCounts counts, const ObjPools& pools, ObjObject& object)
+{
+    VertexWelder welder;
 
+    forEachLine(begin, end, [&](const char* p, const char* lineEnd) {
         /* command code */
-        std::string code;
-        ss >> code;
+        std::string_view code = nextToken(p, lineEnd);
+
+        if(code.empty() || code[0] == '#' || countAttribute(code, counts))
+        {
+            return;
+        }
+        /* face definition (polygons are triangulated as fan) */
+        else if(code == "f")
+        {
+            Index corner;
+            unsigned int first = 0;
+            unsigned int previous = 0;
+            for(int i = 0; nextIndex(p, lineEnd, corner); i++)
+            {
+                std::uint32_t v = static_cast<std::uint32_t>(resolveIndex(corner.v, counts.v));
+                std::uint32_t vt = corner.vt != 0 ? static_cast<std::uint32_t>(resolveIndex(corner.vt, counts.vt)) : VertexWelder::NONE;
+                std::uint32_t vn = corner.vn != 0 ? static_cast<std::uint32_t>(resolveIndex(corner.vn, counts.vn)) : VertexWelder::NONE;
+
+                /* reuse the vertex if this (v, vt, vn) triple was already emitted for the object */
+                std::uint32_t count = static_cast<std::uint32_t>(object.vertices.size());
+                std::uint32_t index = welder.insert(v, vt, vn, count);
+                if(index == count)
+                {
+                    Vertex& vertex = object.vertices.emplace_back();
+                    vertex.pos = pools.positions[v];
+                    if(vn != VertexWelder::NONE)
+                    {
+                        vertex.normal = pools.normals[vn];
+                    }
+                    if(vt != VertexWelder::NONE)
+                    {
+                        vertex.uv = pools.uvs[vt];
+                    }
+                }
+
+                if(i == 0)
+                {
+                    first = index;
+                }
+                else if(i >= 2)
+                {
+                    object.indices.push_back(first);
+                    object.indices.push_back(previous);
+                    object.indices.push_back(index);
+                }
+                previous = index;
+            }
+        }
+        /* object name (only the first line of a block) */
+        else if(code == "o")
+        {
+            object.name = nextToken(p, lineEnd);
+        }
+        /* switch to material for next face definitions */
+        else if(code == "usemtl")
+        {
+            closeMaterialRange(object);
+
+            auto& range = object.material.emplace_back();
+            range.material = nextToken(p, lineEnd);
+            range.indexOffset = static_cast<unsigned int>(object.indices.size());
+        }
+    });
+
+    closeMaterialRange(object);
+}
+
+}
+
+std::map<std::string, MaterialData> materialParse(const std::string &filepath)
+{
+    FileMap file = fileMapOpen(filepath);
+    const std::string directory = filepath.substr(0, filepath.find_last_of("\\/")) + "/";
+
+    std::map<std::string, MaterialData> materials;
+    MaterialData* current = nullptr;
+
+    /* consume material commands */
+    detail::forEachLine(file.data, file.data + file.size, [&](const char* p, const char* lineEnd) {
+        /* command code */
+        std::string_view code = detail::nextToken(p, lineEnd);
+
+        auto color = [&](Vector3D& c) {
+            c.x = detail::nextFloat(p, lineEnd);
+            c.y = detail::nextFloat(p, lineEnd);
+            c.z = detail::nextFloat(p, lineEnd);
+        };
+        auto map = [&](std::string& path) {
+            path = directory + std::string(detail::nextToken(p, lineEnd));
+        };
 
         /* create new material */
         if(code == "newmtl")
         {
-            Material material;
-            ss >> material.name;
-
-            materials[material.name] = material;
-            current = &materials[material.name];
+            std::string name(detail::nextToken(p, lineEnd));
+            current = &materials[name];
+            *current = MaterialData{};
+            current->name = name;
+        }
+        else if(current == nullptr)
+        {
+            return;
         }
         /* shininess parameter */
-        else if(code == "Ns" && current)
+        else if(code == "Ns")
         {
-            float ns = 1.0f;
-            ss >> ns;
-
-            current->shininess = ns;
+            current->shininess = detail::nextFloat(p, lineEnd);
         }
         /* ambient color */
-        else if(code == "Ka" && current)
+        else if(code == "Ka")
         {
-            ss >> current->ambient.x >> current->ambient.y >> current->ambient.z;
+            color(current->ambient);
         }
         /* diffuse color */
-        else if(code == "Kd" && current)
+        else if(code == "Kd")
         {
-            ss >> current->diffuse.x >> current->diffuse.y >> current->diffuse.z;
+            color(current->diffuse);
         }
         /* specular color */
-        else if(code == "Ks" && current)
+        else if(code == "Ks")
         {
-            ss >> current->specular.x >> current->specular.y >> current->specular.z;
+            color(current->specular);
         }
         /* emission color */
-        else if(code == "Ke" && current)
+        else if(code == "Ke")
         {
-            ss >> current->emission.x >> current->emission.y >> current->emission.z;
+            color(current->emission);
         }
         /* shininess map */
-        else if(code == "map_Ns" && current)
+        else if(code == "map_Ns")
         {
-            std::string texture_path;
-            ss  >> texture_path;
-            current->map_shininess = textureLoad(filepath.substr(0, filepath.find_last_of("\\/")) + "/" + texture_path);
+            map(current->map_shininess);
         }
         /* diffuse color map */
-        else if(code == "map_Kd" && current)
+        else if(code == "map_Kd")
         {
-            std::string texture_path;
-            ss  >> texture_path;
-            current->map_diffuse = textureLoad(filepath.substr(0, filepath.find_last_of("\\/")) + "/" + texture_path);
+            map(current->map_diffuse);
         }
         /* specular map */
-        else if(code == "map_Ks" && current)
+        else if(code == "map_Ks")
         {
-            std::string texture_path;
-            ss  >> texture_path;
-            current->map_specular = textureLoad(filepath.substr(0, filepath.find_last_of("\\/")) + "/" + texture_path);
+            map(current->map_specular);
         }
         /* normal map */
-        else if(code == "map_Bump" && current)
+        else if(code == "map_Bump")
         {
-            std::string texture_path;
-            ss  >> texture_path;
-            current->map_normal = textureLoad(filepath.substr(0, filepath.find_last_of("\\/")) + "/" + texture_path);
+            map(current->map_normal);
         }
         /* ambient occlusion map */
-        else if(code == "map_Ka" && current)
+        else if(code == "map_Ka")
         {
-            std::string texture_path;
-            ss  >> texture_path;
-            current->map_ambient = textureLoad(filepath.substr(0, filepath.find_last_of("\\/")) + "/" + texture_path);
+            map(current->map_ambient);
         }
         /* emission map */
-        else if(code == "map_Ke" && current)
+        else if(code == "map_Ke")
         {
-            std::string texture_path;
-            ss  >> texture_path;
-            current->map_emission = textureLoad(filepath.substr(0, filepath.find_last_of("\\/")) + "/" + texture_path);
+            map(current->map_emission);
         }
-    }
+    });
 
     return materials;
 }
 
+Material materialUpload(const MaterialData& data)
+{
+    /* the normal maps of the assets are not unit length two channel normals, so they are compressed like color */
+    auto load = [](const std::string& path, eTextureUsage usage, eTexturePriority priority) {
+        return path.empty() ? Texture{} : textureLoad(path, usage, true, priority);
+    };
+
+    Material material;
+    material.name = data.name;
+    material.emission = data.emission;
+    material.ambient = data.ambient;
+    material.diffuse = data.diffuse;
+    material.specular = data.specular;
+    material.shininess = data.shininess;
+
+    material.map_emission = load(data.map_emission, TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
+    material.map_ambient = load(data.map_ambient, TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+    material.map_diffuse = load(data.map_diffuse, TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+    material.map_specular = load(data.map_specular, TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
+    material.map_shininess = load(data.map_shininess, TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+    material.map_normal = load(data.map_normal, TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+
+    material.indexOffset = data.indexOffset;
+    material.indexCount = data.indexCount;
+    material.lod = data.lod;
+    material.clusters = data.clusters;
+    return material;
+}
+
+void materialRetain(const Material& material)
+{
+    textureRetain(material.map_emission);
+    textureRetain(material.map_ambient);
+    textureRetain(material.map_diffuse);
+    textureRetain(material.map_specular);
+    textureRetain(material.map_shininess);
+    textureRetain(material.map_normal);
+    textureRetain(material.map_packed);
+}
+
+bool materialPack(Material& material)
+{
+    if(material.map_packed.id != 0)
+    {
+        return true;
+    }
+
+    std::vector<bool> packed;
+    Texture texture = texturePack({material.map_ambient, material.map_shininess, material.map_specular}, packed);
+    if(!packed[0] || !packed[1])
+    {
+        textureDelete(texture);
+        return false;
+    }
+
+    material.map_packed = texture;
+    material.packedSpecular = packed[2];
+    textureDelete(material.map_ambient);
+    textureDelete(material.map_shininess);
+    material.map_ambient = Texture{};
+    material.map_shininess = Texture{};
+    if(material.packedSpecular)
+    {
+        textureDelete(material.map_specular);
+        material.map_specular = Texture{};
+    }
+    return true;
+}
+
+Texture& materialMap(Material& material, eMaterialMap map)
+{
+    Texture* maps[MATERIAL_MAP_COUNT] = {
+        &material.map_diffuse, &material.map_normal, &material.map_ambient, &material.map_emission, &material.map_shininess, &material.map_specular
+    };
+    return *maps[map];
+}
+
+MaterialFamily materialFamilyCreate(const std::vector<Material*>& materials, const std::vector<std::pair<eMaterialMap, Texture*>>& extra)
+{
+    MaterialFamily family;
+    for(unsigned int slot = 0; slot < MATERIAL_MAP_COUNT; slot++)
+    {
+        std::vector<Texture*> maps;
+        for(Material* material : materials)
+        {
+            maps.push_back(&materialMap(*material, static_cast<eMaterialMap>(slot)));
+        }
+        for(const auto& [map, texture] : extra)
+        {
+            if(map == slot)
+            {
+                maps.push_back(texture);
+            }
+        }
+        if(maps.empty())
+        {
+            continue;
+        }
+
+        /* one handle more than there are maps, for the family itself */
+        std::vector<Texture> textures;
+        for(const Texture* map : maps)
+        {
+            textures.push_back(*map);
+        }
+        textures.push_back(*maps[0]);
+        std::vector<Texture> layers = textureArrayCreate(textures);
+
+        for(std::size_t i = 0; i < maps.size(); i++)
+        {
+            textureDelete(*maps[i]);
+            *maps[i] = layers[i];
+        }
+        family.maps[slot] = layers.back();
+    }
+    return family;
+}
+
+MaterialFamily materialFamilyPrepare(const std::vector<Material*>& materials, const std::vector<std::pair<eMaterialMap, Texture*>>& extra)
+{
+    if(textureCompressionSupported())
+    {
+        return materialFamilyCreate(materials, extra);
+    }
+
+    for(Material* material : materials)
+    {
+        materialPack(*material);
+    }
+    return MaterialFamily{};
+}
+
+void materialFamilyDelete(MaterialFamily& family)
+{
+    for(Texture& map : family.maps)
+    {
+        textureDelete(map);
+        map = Texture{};
+    }
+}
+
+void materialLayers(const Material& material, int layers[MATERIAL_MAP_COUNT])
+{
+    const Texture* maps[MATERIAL_MAP_COUNT] = {
+        &material.map_diffuse, &material.map_normal, &material.map_ambient, &material.map_emission, &material.map_shininess, &material.map_specular
+    };
+    for(unsigned int slot = 0; slot < MATERIAL_MAP_COUNT; slot++)
+    {
+        layers[slot] = static_cast<int>(maps[slot]->layer);
+    }
+}
 
 void materialDelete(std::vector<Material>& materials) {
     for(auto& m : materials)
@@ -190,153 +688,650 @@ void materialDelete(Material& material) {
     textureDelete(material.map_ambient);
     textureDelete(material.map_diffuse);
     textureDelete(material.map_specular);
+    textureDelete(material.map_shininess);
     textureDelete(material.map_normal);
+    textureDelete(material.map_packed);
+}
+
+namespace detail
+{
+
+/* object block of an OBJ file: anything in front of the first 'o' line, then one block per 'o' line */
+struct ObjBlock
+{
+    const char* begin;
+    const char* end;
+    ObjCounts counts;
+};
+
+/* OBJ file with filled attribute pools and located object blocks, ready for objParseObject */
+struct ObjFile
+{
+    FileMap file;
+    ObjPools pools;
+    std::vector<ObjBlock> blocks;
+    std::vector<std::string> libraries;
+};
+
+void objOpen(const std::string &filepath, bool spill, ObjFile& obj)
+{
+    obj.file = fileMapOpen(filepath);
+    const char* const fileBegin = obj.file.data;
+    const char* const fileEnd = obj.file.data + obj.file.size;
+
+    /* split the file into chunks on line boundaries for the pre-scan and the attribute parse, a spilling parse
+       releases every chunk once it is done, so its chunks are kept small */
+    const std::size_t minChunkSize = 256 * 1024;
+    const std::size_t maxSpillChunkSize = 16 * 1024 * 1024;
+    std::size_t chunkCount = std::clamp<std::size_t>(obj.file.size / minChunkSize, 1, 4 * threadPoolSize());
+    if(spill)
+    {
+        chunkCount = std::max(chunkCount, obj.file.size / maxSpillChunkSize + 1);
+    }
+
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* chunkBegin = fileBegin;
+    for(std::size_t i = 0; i < chunkCount; i++)
+    {
+        const char* chunkEnd = fileEnd;
+        if(i + 1 < chunkCount)
+        {
+            chunkEnd = std::max(chunkBegin, fileBegin + obj.file.size / chunkCount * (i + 1));
+            const char* newline = static_cast<const char*>(std::memchr(chunkEnd, '\n', static_cast<std::size_t>(fileEnd - chunkEnd)));
+            chunkEnd = newline ? newline + 1 : fileEnd;
+        }
+        chunks[i].begin = chunkBegin;
+        chunks[i].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+
+    auto release = [&](const ObjChunk& chunk) {
+        if(spill)
+        {
+            fileMapRelease(obj.file, static_cast<std::size_t>(chunk.begin - fileBegin), static_cast<std::size_t>(chunk.end - chunk.begin));
+        }
+    };
+
+    /* pre-scan: attribute counts and 'o' offsets of every chunk */
+    parallelFor(chunks.size(), [&](std::size_t i) {
+        objPrescan(chunks[i]);
+        release(chunks[i]);
+    });
+
+    std::vector<ObjCounts> chunkBase(chunks.size());
+    ObjCounts total;
+    for(std::size_t i = 0; i < chunks.size(); i++)
+    {
+        chunkBase[i] = total;
+        total.v += chunks[i].counts.v;
+        total.vt += chunks[i].counts.vt;
+        total.vn += chunks[i].counts.vn;
+    }
+
+    /* position, normal and uv pools */
+    objPoolsCreate(obj.pools, total, spill);
+    parallelFor(chunks.size(), [&](std::size_t i) {
+        objParseAttributes(chunks[i], chunkBase[i], obj.pools);
+        release(chunks[i]);
+        if(spill)
+        {
+            objPoolsRelease(obj.pools, chunkBase[i], chunks[i].counts);
+        }
+    });
+
+    obj.blocks.push_back(ObjBlock{fileBegin, fileEnd, ObjCounts{}});
+    for(std::size_t i = 0; i < chunks.size(); i++)
+    {
+        for(const auto& [line, counts] : chunks[i].objects)
+        {
+            obj.blocks.back().end = line;
+            obj.blocks.push_back(ObjBlock{line, fileEnd, ObjCounts{chunkBase[i].v + counts.v, chunkBase[i].vt + counts.vt, chunkBase[i].vn + counts.vn}});
+        }
+        obj.libraries.insert(obj.libraries.end(), chunks[i].libraries.begin(), chunks[i].libraries.end());
+    }
 }
 
-std::vector<Model> modelLoad(const std::string &filepath)
+/* faces or materials in front of the first 'o' form an unnamed object, nothing at all there is no object */
+inline bool objSkipBlock(std::size_t block, const ObjObject& object)
 {
-    std::ifstream objFile(filepath);
-    if(!objFile.is_open())
+    return block == 0 && object.indices.empty() && object.material.empty();
+}
+
+}
+
+ObjData objParse(const std::string &filepath)
+{
+    detail::ObjFile obj;
+    detail::objOpen(filepath, false, obj);
+
+    /* faces of all objects into per object vertex arrays */
+    std::vector<ObjObject> objects(obj.blocks.size());
+    parallelFor(obj.blocks.size(), [&](std::size_t i) {
+        detail::objParseObject(obj.blocks[i].begin, obj.blocks[i].end, obj.blocks[i].counts, obj.pools, objects[i]);
+    });
+
+    ObjData data;
+    data.materialLibraries = std::move(obj.libraries);
+    for(std::size_t i = 0; i < objects.size(); i++)
     {
-        throw std::runtime_error("[Model] Couldn't open OBJ file at " + filepath);
+        if(!detail::objSkipBlock(i, objects[i]))
+        {
+            data.objects.push_back(std::move(objects[i]));
+        }
     }
 
-    /* container for GL related stuff */
-    std::vector<Model> models;
-    std::vector<Vertex> glVertices;
-    std::vector<unsigned int> glIndices;
+    return data;
+}
+
+void objStream(const std::string &filepath, const std::function<void(const std::vector<std::string>&)>& libraries,
+               const std::function<void(ObjObject&)>& object)
+{
+    detail::ObjFile obj;
+    detail::objOpen(filepath, true, obj);
+    libraries(obj.libraries);
+
+    for(std::size_t i = 0; i < obj.blocks.size(); i++)
+    {
+        const detail::ObjBlock& block = obj.blocks[i];
+        {
+            ObjObject current;
+            detail::objParseObject(block.begin, block.end, block.counts, obj.pools, current);
+            if(!detail::objSkipBlock(i, current))
+            {
+                object(current);
+            }
+        }
+        /* the block and the pool entries it referenced are paged in again if a later object needs them */
+        fileMapRelease(obj.file, static_cast<std::size_t>(block.begin - obj.file.data), static_cast<std::size_t>(block.end - block.begin));
+        scratchMapRelease(obj.pools.scratch, 0, obj.pools.scratch.size);
+    }
+}
 
-    /* container for OBJ related stuff */
-    std::map<std::string, Material> materials;
-    std::vector<Vector3D> vertices;
-    std::vector<Vector3D> normals;
-    std::vector<Vector2D> uvs;
+namespace detail
+{
 
-    /* consume commonds from obj file */
-    std::string line;
-    while(std::getline(objFile, line))
+/* resolves the material ranges of an object against the loaded material libraries */
+std::vector<MaterialData> objMaterials(const std::vector<ObjMaterialRange>& ranges, std::map<std::string, MaterialData>& materials)
+{
+    std::vector<MaterialData> result;
+    result.reserve(ranges.size());
+    for(const auto& range : ranges)
     {
-        std::stringstream ss(line);
+        auto& material = result.emplace_back(materials[range.material]);
+        material.indexOffset = range.indexOffset;
+        material.indexCount = range.indexCount;
+        material.lod = range.lod;
+        material.clusters = range.clusters;
+    }
+    return result;
+}
 
-        /* command code */
-        std::string code;
-        ss >> code;
+/* optimizes all objects in parallel and reports the vertex cache statistics */
+void objOptimize(const std::string &filepath, std::span<ObjObject> objects)
+{
+    std::vector<VertexCacheStats> before(objects.size()), after(objects.size());
+    parallelFor(objects.size(), [&](std::size_t i) {
+        ObjObject& object = objects[i];
+        before[i] = vertexCacheStats(object.indices.data(), object.indices.size(), object.vertices.size());
+        meshOptimize(object);
+        after[i] = vertexCacheStats(object.indices.data(), object.indices.size(), object.vertices.size());
+    });
+
+    for(std::size_t i = 0; i < objects.size(); i++)
+    {
+        std::cout << "[Model] " << filepath << " '" << objects[i].name << "': ACMR " << before[i].acmr << " -> " << after[i].acmr
+                  << ", ATVR " << before[i].atvr << " -> " << after[i].atvr << " (FIFO " << VERTEX_CACHE_SIZE << ")" << std::endl;
+    }
+}
 
-        if(code == "")
+/* splits the material ranges of all objects into culling clusters and reports their number */
+void objCluster(const std::string &filepath, std::span<ObjObject> objects)
+{
+    parallelFor(objects.size(), [&](std::size_t i) {
+        ObjObject& object = objects[i];
+        for(auto& range : object.material)
         {
-            continue;
+            range.clusters = meshClusterize(object.indices.data() + range.indexOffset, range.indexCount, object.vertices.data(), object.vertices.size(), range.indexOffset);
         }
-        /* create new object */
-        else if(code == "o")
+    });
+
+    for(const auto& object : objects)
+    {
+        std::size_t clusters = 0, triangles = 0, cullable = 0;
+        for(const auto& range : object.material)
         {
-            if(!models.empty())
+            clusters += range.clusters.size();
+            triangles += range.indexCount / 3;
+            cullable += std::count_if(range.clusters.begin(), range.clusters.end(), [](const MeshCluster& c) { return c.coneCos > 0.0f; });
+        }
+        std::cout << "[Model] " << filepath << " '" << object.name << "': " << clusters << " clusters of "
+                  << (clusters ? triangles / clusters : 0) << " triangles on average, " << cullable << " with a usable normal cone" << std::endl;
+    }
+}
+
+/* appends up to three simplified levels per material range of every object and reports the triangle counts */
+void objLod(const std::string &filepath, std::span<ObjObject> objects, unsigned int flags)
+{
+    const unsigned int maxLevels = 3;
+
+    parallelFor(objects.size(), [&](std::size_t i) {
+        ObjObject& object = objects[i];
+        for(auto& range : object.material)
+        {
+            range.lod.clear();
+            std::vector<unsigned int> previous(object.indices.begin() + range.indexOffset, object.indices.begin() + range.indexOffset + range.indexCount);
+            float previousError = 0.0f;
+
+            for(unsigned int level = 0; level < maxLevels; level++)
             {
-                Model& model = models.back();
-                model.mesh = meshCreate(glVertices, glIndices, GL_STATIC_DRAW, GL_STATIC_DRAW);
+                float error = 0.0f;
+                std::vector<unsigned int> indices = meshSimplify(object.vertices.data(), object.vertices.size(), previous.data(), previous.size(), previous.size() / 2 / 3 * 3, error);
 
-                if(!model.material.empty())
+                /* locked borders stop the simplification at some point, levels that barely shrink aren't worth the memory */
+                if(indices.empty() || indices.size() * 10 > previous.size() * 9)
                 {
-                    auto& material = model.material.back();
-                    material.indexCount = glVertices.size() - material.indexOffset;
+                    break;
+                }
+                if(flags & MODEL_LOAD_OPTIMIZE)
+                {
+                    optimizeVertexCache(indices.data(), indices.size(), object.vertices.size());
                 }
 
-                glVertices.clear();
-                glIndices.clear();
+                /* every level is simplified from the one before, so the deviations add up */
+                previousError += error;
+                range.lod.push_back(MaterialLod{static_cast<unsigned int>(object.indices.size()), static_cast<unsigned int>(indices.size()), previousError});
+                object.indices.insert(object.indices.end(), indices.begin(), indices.end());
+                previous = std::move(indices);
             }
-
-            Model& model = models.emplace_back();
-            ss >> model.name;
         }
-        /* vertex postion */
-        else if(code == "v")
+    });
+
+    for(const auto& object : objects)
+    {
+        std::cout << "[Model] " << filepath << " '" << object.name << "': LOD triangles";
+        for(const auto& range : object.material)
         {
-            auto& v = vertices.emplace_back();
-            ss >> v.x >> v.y >> v.z;
+            std::cout << " [" << range.indexCount / 3;
+            for(const auto& lod : range.lod)
+            {
+                std::cout << " -> " << lod.indexCount / 3 << " (" << lod.error << ")";
+            }
+            std::cout << "]";
         }
-        /* vertex texture coordinates */
-        else if(code == "vt")
+        std::cout << std::endl;
+    }
+}
+
+std::map<std::string, MaterialData> objMaterialLibraries(const std::string &filepath, const std::vector<std::string>& libraries)
+{
+    /* load material files (path in respect to .obj file) */
+    std::map<std::string, MaterialData> materials;
+    for(const auto& library : libraries)
+    {
+        materials.merge(materialParse(filepath.substr(0, filepath.find_last_of("\\/")) + "/" + library));
+    }
+    return materials;
+}
+
+}
+
+std::vector<MeshData> modelParse(const std::string &filepath, unsigned int flags)
+{
+    std::vector<MeshData> meshes;
+
+    /* only flags that change the parsed data are part of the cache key */
+    flags &= MODEL_LOAD_OPTIMIZE | MODEL_LOAD_LOD | MODEL_LOAD_CLUSTER;
+
+    /* a valid binary cache blob is used in place, the mapping lives as long as the returned data */
+    auto cache = std::make_shared<MeshCache>();
+    if(meshCacheLoad(filepath, flags, *cache))
+    {
+        auto materials = detail::objMaterialLibraries(filepath, cache->materialLibraries);
+        for(const auto& object : cache->objects)
         {
-            auto& vt = uvs.emplace_back();
-            ss >> vt.x >> vt.y;
+            if(!meshCacheObjectValid(object))
+            {
+                std::cerr << "[MeshCache] '" << object.name << "' of " << filepath << " has out of range indices, parsing the OBJ file" << std::endl;
+                meshes.clear();
+                break;
+            }
+            meshes.push_back(MeshData{object.name, {object.vertices, object.vertexCount}, {object.indices, object.indexCount},
+                                      detail::objMaterials(object.material, materials), cache});
         }
-        /* vertex normal */
-        else if(code == "vn")
+        if(meshes.size() == cache->objects.size())
         {
-            auto& vn = normals.emplace_back();
-            ss >> vn.x >> vn.y >> vn.z;
+            std::cout << "[Model] " << filepath << " loaded from mesh cache" << std::endl;
+            return meshes;
         }
-        /* face definition (currently only triangles) */
-        else if(code == "f")
-        {
-            detail::Index _idx[3];
-            ss >> _idx[0] >> _idx[1] >> _idx[2];
+    }
 
-            for(int i = 0; i < 3; i++)
-            {
-                glIndices.emplace_back(glVertices.size());
+    /* reported before objLod appends the index ranges of the coarser levels, like modelParseStream does */
+    auto data = std::make_shared<ObjData>(objParse(filepath));
+    for(const auto& object : data->objects)
+    {
+        std::cout << "[Model] " << filepath << " '" << object.name << "': " << object.indices.size()
+                  << " vertices before welding, " << object.vertices.size() << " after" << std::endl;
+    }
+    if(flags & MODEL_LOAD_OPTIMIZE)
+    {
+        detail::objOptimize(filepath, data->objects);
+    }
+    if(flags & MODEL_LOAD_CLUSTER)
+    {
+        detail::objCluster(filepath, data->objects);
+    }
+    if(flags & MODEL_LOAD_LOD)
+    {
+        detail::objLod(filepath, data->objects, flags);
+    }
+    meshCacheWrite(filepath, *data, flags);
 
-                Vertex& vertex = glVertices.emplace_back();
-                vertex.pos = vertices[_idx[i].v - 1];
+    auto materials = detail::objMaterialLibraries(filepath, data->materialLibraries);
+    for(const auto& object : data->objects)
+    {
+        meshes.push_back(MeshData{object.name, object.vertices, object.indices, detail::objMaterials(object.material, materials), data});
+    }
+    return meshes;
+}
 
-                if(_idx[i].type == detail::Index::V_VN)
+void modelParseStream(const std::string &filepath, unsigned int flags, const std::function<void(const MeshData&)>& mesh)
+{
+    flags &= MODEL_LOAD_OPTIMIZE | MODEL_LOAD_LOD | MODEL_LOAD_CLUSTER;
+
+    /* cached objects are handed out straight from the mapping and dropped from memory once they are consumed. An object
+       with out of range indices ends the stream, the OBJ file then delivers the objects that are still missing. */
+    std::size_t delivered = 0;
+    {
+        MeshCache cache;
+        if(meshCacheLoad(filepath, flags, cache))
+        {
+            auto materials = detail::objMaterialLibraries(filepath, cache.materialLibraries);
+            for(const auto& object : cache.objects)
+            {
+                if(!meshCacheObjectValid(object))
                 {
-                    vertex.normal = normals[_idx[i].vn - 1];
+                    std::cerr << "[MeshCache] '" << object.name << "' of " << filepath << " has out of range indices, parsing the OBJ file" << std::endl;
+                    break;
                 }
-                else if(_idx[i].type == detail::Index::V_VT_VN)
+                mesh(MeshData{object.name, {object.vertices, object.vertexCount}, {object.indices, object.indexCount},
+                              detail::objMaterials(object.material, materials), nullptr});
+                delivered++;
+
+                const char* begin = reinterpret_cast<const char*>(object.vertices);
+                const char* end = reinterpret_cast<const char*>(object.indices + object.indexCount);
+                if(begin && end > begin)
                 {
-                    vertex.normal = normals[_idx[i].vn - 1];
-                    vertex.uv = uvs[_idx[i].vt - 1];
+                    fileMapRelease(cache.file, static_cast<std::size_t>(begin - cache.file.data), static_cast<std::size_t>(end - begin));
                 }
             }
+            if(delivered == cache.objects.size())
+            {
+                std::cout << "[Model] " << filepath << " streamed from mesh cache" << std::endl;
+                return;
+            }
         }
-        /* load material file (path in respect to .obj file) */
-        else if(code == "mtllib")
-        {
-            std::string file;
-            ss >> file;
-            materials = materialLoad( filepath.substr(0, filepath.find_last_of("\\/")) + "/" + file );
-        }
-        /* switch to material for next face definitions */
-        else if(code == "usemtl")
-        {
-            auto& model = models.back();
-            std::string name;
-            ss >> name;
+    }
+
+    /* all objects are parsed for the new blob, the ones the cache already delivered are not handed out again */
+    std::size_t parsed = 0;
+    MeshCacheWriter writer;
+    std::map<std::string, MaterialData> materials;
+    objStream(filepath,
+        [&](const std::vector<std::string>& libraries) {
+            materials = detail::objMaterialLibraries(filepath, libraries);
+            meshCacheBegin(writer, filepath, libraries, flags);
+        },
+        [&](ObjObject& object) {
+            std::cout << "[Model] " << filepath << " '" << object.name << "': " << object.indices.size()
+                      << " vertices before welding, " << object.vertices.size() << " after" << std::endl;
 
-            if(!model.material.empty())
+            if(flags & MODEL_LOAD_OPTIMIZE)
             {
-                auto& material = model.material.back();
-                material.indexCount = glVertices.size() - material.indexOffset;
+                detail::objOptimize(filepath, std::span<ObjObject>(&object, 1));
             }
+            if(flags & MODEL_LOAD_CLUSTER)
+            {
+                detail::objCluster(filepath, std::span<ObjObject>(&object, 1));
+            }
+            if(flags & MODEL_LOAD_LOD)
+            {
+                detail::objLod(filepath, std::span<ObjObject>(&object, 1), flags);
+            }
+            meshCacheAppend(writer, object);
+            if(parsed++ >= delivered)
+            {
+                mesh(MeshData{object.name, object.vertices, object.indices, detail::objMaterials(object.material, materials), nullptr});
+            }
+        });
+    meshCacheFinish(writer);
+}
 
-            auto& material = model.material.emplace_back( materials[name] );
-            material.indexOffset = glVertices.size();
+namespace detail
+{
+
+/* creates the GL mesh and materials of one parsed model, materials already in 'uploaded' are shared */
+Model meshUpload(const MeshData& mesh, eVertexFormat format, std::map<std::string, Material>& uploaded)
+{
+    Model model;
+    model.name = mesh.name;
+    model.mesh = meshCreate(mesh.vertices.data(), (unsigned int) mesh.vertices.size(), mesh.indices.data(), (unsigned int) mesh.indices.size(), GL_STATIC_DRAW, GL_STATIC_DRAW, format);
+
+    /* bounding sphere around the center of the bounding box */
+    if(!mesh.vertices.empty())
+    {
+        Vector3D min = mesh.vertices[0].pos, max = min;
+        for(const auto& vertex : mesh.vertices)
+        {
+            for(unsigned int c = 0; c < 3; c++)
+            {
+                min[c] = std::min(min[c], vertex.pos[c]);
+                max[c] = std::max(max[c], vertex.pos[c]);
+            }
+        }
+        model.boundsCenter = (min + max) * 0.5f;
+        for(const auto& vertex : mesh.vertices)
+        {
+            model.boundsRadius = std::max(model.boundsRadius, length(vertex.pos - model.boundsCenter));
+        }
+    }
+
+    for(const auto& data : mesh.material)
+    {
+        /* every model releases its materials, so a shared one holds one texture reference per model */
+        auto it = uploaded.find(data.name);
+        if(it == uploaded.end())
+        {
+            it = uploaded.emplace(data.name, materialUpload(data)).first;
+        }
+        else
+        {
+            materialRetain(it->second);
         }
+
+        auto& material = model.material.emplace_back(it->second);
+        material.indexOffset = data.indexOffset;
+        material.indexCount = data.indexCount;
+        material.lod = data.lod;
+        material.clusters = data.clusters;
+        material.indexType = model.mesh.indexType;
+    }
+    return model;
+}
+
+}
+
+std::vector<Model> modelUpload(const std::vector<MeshData>& meshes, unsigned int flags)
+{
+    /* materials used by several objects load their textures only once and share them */
+    std::map<std::string, Material> uploaded;
+
+    eVertexFormat format = (flags & MODEL_LOAD_COMPACT) ? VERTEX_FORMAT_COMPACT : VERTEX_FORMAT_FLOAT;
+    std::size_t floatBytes = 0, uploadedBytes = 0;
+
+    std::vector<Model> models;
+    models.reserve(meshes.size());
+    for(const auto& mesh : meshes)
+    {
+        const Model& model = models.emplace_back(detail::meshUpload(mesh, format, uploaded));
+        floatBytes += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned int);
+        uploadedBytes += meshByteSize(model.mesh);
     }
 
-    /* finnish up last object */
-    Model& model = models.back();
-    model.mesh = meshCreate(glVertices, glIndices, GL_STATIC_DRAW, GL_STATIC_DRAW);
-    if(!model.material.empty())
+    if(format == VERTEX_FORMAT_COMPACT)
     {
-        auto& material = model.material.back();
-        material.indexCount = glVertices.size() - material.indexOffset;
+        std::cout << "[Model] compact vertex format: " << floatBytes / 1024 << " KB -> " << uploadedBytes / 1024 << " KB of vertex and index data" << std::endl;
     }
 
     return models;
 }
 
+std::vector<Model> modelLoad(const std::string &filepath, unsigned int flags)
+{
+    if(filepath.size() >= 4 && filepath.compare(filepath.size() - 4, 4, ".glb") == 0)
+    {
+        return glbLoad(filepath);
+    }
+
+    /* streamed objects go to the GPU one by one, only the current one is kept in memory */
+    if(flags & MODEL_LOAD_STREAM)
+    {
+        std::map<std::string, Material> uploaded;
+        eVertexFormat format = (flags & MODEL_LOAD_COMPACT) ? VERTEX_FORMAT_COMPACT : VERTEX_FORMAT_FLOAT;
+
+        std::vector<Model> models;
+        modelParseStream(filepath, flags, [&](const MeshData& mesh) { models.push_back(detail::meshUpload(mesh, format, uploaded)); });
+        return models;
+    }
+    return modelUpload(modelParse(filepath, flags), flags);
+}
+
+void modelDraw(const Model& model, const Material& material, unsigned int lod, unsigned int record)
+{
+    if(material.vao != 0)
+    {
+        glBindVertexArray(material.vao);
+    }
+
+    unsigned int indexOffset = material.indexOffset;
+    unsigned int indexCount = material.indexCount;
+    if(lod > 0 && !material.lod.empty())
+    {
+        const MaterialLod& level = material.lod[std::min<std::size_t>(lod, material.lod.size()) - 1];
+        indexOffset = level.indexOffset;
+        indexCount = level.indexCount;
+    }
+
+    std::size_t indexSize = material.indexType == GL_UNSIGNED_BYTE ? 1 : material.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    drawRingElements(material.indexType, indexCount, (const void*) (indexOffset * indexSize), record);
+}
+
+unsigned int modelDrawCulled(const Model& model, const Material& material, const Vector3D& viewPosition, unsigned int lod, unsigned int record)
+{
+    if(lod > 0 || material.clusters.empty())
+    {
+        modelDraw(model, material, lod, record);
+        return (lod > 0 && !material.lod.empty() ? material.lod[std::min<std::size_t>(lod, material.lod.size()) - 1].indexCount : material.indexCount) / 3;
+    }
+
+    /* visible clusters are contiguous index runs, neighbouring ones are merged into a single draw; the arrays are
+       reused from call to call so culling doesn't allocate every frame */
+    static std::vector<GLsizei> counts;
+    static std::vector<const void*> offsets;
+    counts.clear();
+    offsets.clear();
+
+    std::size_t indexSize = material.indexType == GL_UNSIGNED_BYTE ? 1 : material.indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    unsigned int runEnd = 0, triangles = 0;
+    for(const auto& cluster : material.clusters)
+    {
+        if(meshClusterBackfacing(cluster, viewPosition))
+        {
+            continue;
+        }
+
+        if(!counts.empty() && runEnd == cluster.indexOffset)
+        {
+            counts.back() += static_cast<GLsizei>(cluster.indexCount);
+        }
+        else
+        {
+            counts.push_back(static_cast<GLsizei>(cluster.indexCount));
+            offsets.push_back((const void*) (cluster.indexOffset * indexSize));
+        }
+        runEnd = cluster.indexOffset + cluster.indexCount;
+        triangles += cluster.indexCount / 3;
+    }
+
+    if(!counts.empty())
+    {
+        if(material.vao != 0)
+        {
+            glBindVertexArray(material.vao);
+        }
+        /* multi draws have no base instance, the record is a constant attribute for all runs (the per instance array
+           of the draw ring is switched off for the call) */
+        bool instanced = drawRingBaseInstance();
+        if(instanced)
+        {
+            glDisableVertexAttribArray(eDataIdx::DrawID);
+        }
+        glVertexAttribI1i(eDataIdx::DrawID, static_cast<GLint>(record));
+        glMultiDrawElements(GL_TRIANGLES, counts.data(), material.indexType, offsets.data(), static_cast<GLsizei>(counts.size()));
+        if(instanced)
+        {
+            glEnableVertexAttribArray(eDataIdx::DrawID);
+        }
+    }
+    return triangles;
+}
+
+unsigned int modelSelectLod(const Model& model, float maxError)
+{
+    /* levels are ordered by error, the first one that is too coarse for any material ends the search */
+    unsigned int lod = 0;
+    for(unsigned int level = 1; ; level++)
+    {
+        bool exists = false;
+        for(const auto& material : model.material)
+        {
+            if(material.lod.empty())
+            {
+                continue;
+            }
+            const MaterialLod& coarse = material.lod[std::min<std::size_t>(level, material.lod.size()) - 1];
+            if(coarse.error > maxError)
+            {
+                return lod;
+            }
+            exists = exists || level <= material.lod.size();
+        }
+        if(!exists)
+        {
+            return lod;
+        }
+        lod = level;
+    }
+}
+
 void modelDelete(std::vector<Model> &models)
 {
     for(auto& m : models)
     {
-        meshDelete(m.mesh);
-        materialDelete(m.material);
+        modelDelete(m);
     }
 }
 
 void modelDelete(Model &model)
 {
+    /* vertex arrays of GLB primitives, the first one is also the mesh's */
+    for(auto& material : model.material)
+    {
+        if(material.vao != 0 && material.vao != model.mesh.vao)
+        {
+            glDeleteVertexArrays(1, &material.vao);
+        }
+    }
+
     meshDelete(model.mesh);
     materialDelete(model.material);
 }
@@ -1,8 +1,22 @@
 #pragma once
 
 #include "mesh.h"
+#include "mesh_cluster.h"
 #include "texture.h"
 
+#include <functional>
+#include <map>
+#include <memory>
+#include <span>
+
+/* coarser index range of a material, stored behind the full detail ranges in the same index buffer */
+struct MaterialLod
+{
+    unsigned int indexOffset = 0;
+    unsigned int indexCount = 0;
+    float error = 0.0f;     // largest geometric deviation from the full detail range, object space units
+};
+
 struct Material
 {
     std::string name;
@@ -20,19 +34,325 @@ struct Material
     Texture map_shininess;
     Texture map_normal;
 
+    /* scalar maps packed by materialPack: r ambient occlusion, g shininess, b specular if packedSpecular (the packed
+       maps themselves are released) */
+    Texture map_packed;
+    bool packedSpecular = false;
+
     unsigned int indexOffset;
     unsigned int indexCount;
+    std::vector<MaterialLod> lod;
+    std::vector<MeshCluster> clusters;
+
+    /* GLB primitives keep their own vertex layout and index type, vao 0 means the mesh of the model is used */
+    GLuint vao = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    /* element of the material table the draw records of this material point to (see MaterialRecord) */
+    unsigned int record = 0;
 };
 void materialDelete(std::vector<Material>& materials);
 void materialDelete(Material& material);
 
+/**
+ * @brief Packs the scalar maps of a material (ambient occlusion, shininess and, if it is grey, specular) into
+ * map_packed and releases the separate textures, which saves texture memory and binds. Shaders have to read the
+ * packed channels instead (color.frag with PACKED_MAPS).
+ *
+ * @param material Material to pack.
+ *
+ * @return True if ambient occlusion and shininess could be packed, otherwise the material is left as it is.
+ */
+bool materialPack(Material& material);
+
+/**
+ * @brief Adds a reference to all texture maps of a material, for each additional copy that is deleted separately.
+ *
+ * @param material Material to keep alive.
+ */
+void materialRetain(const Material& material);
+
+/* map slots of a material, in the order of the texture units the color shaders read them from */
+enum eMaterialMap
+{
+    MATERIAL_MAP_DIFFUSE = 0,
+    MATERIAL_MAP_NORMAL,
+    MATERIAL_MAP_AMBIENT,
+    MATERIAL_MAP_EMISSION,
+    MATERIAL_MAP_SHININESS,
+    MATERIAL_MAP_SPECULAR,
+    MATERIAL_MAP_COUNT
+};
+
+/* texture arrays shared by a family of materials, one per map slot (see materialFamilyCreate) */
+struct MaterialFamily
+{
+    Texture maps[MATERIAL_MAP_COUNT];
+};
+
+/**
+ * @brief Returns the map of a material in a slot.
+ *
+ * @param material Material.
+ * @param map Slot of the map.
+ *
+ * @return The map (a texture array layer once the material belongs to a family).
+ */
+Texture& materialMap(Material& material, eMaterialMap map);
+
+/**
+ * @brief Moves the maps of a family of materials (e.g. all parts of one object) into one texture array per map slot
+ * (see textureArrayCreate): every map is replaced by its layer and the separate textures are released. The family is
+ * then drawn with one bind per slot and the draws only pick the layers of their material (see materialLayers), shaders
+ * read the maps with color.frag's TEXTURE_ARRAYS variant. Packed maps (materialPack) are not part of a family.
+ *
+ * @param materials Materials of the family.
+ * @param extra Further maps the materials switch to later on (e.g. a black emission map for lights that are turned
+ * off), they become layers of the same arrays.
+ *
+ * @return Texture arrays of the family, release them with materialFamilyDelete.
+ */
+MaterialFamily materialFamilyCreate(const std::vector<Material*>& materials, const std::vector<std::pair<eMaterialMap, Texture*>>& extra = {});
+
+/**
+ * @brief Sets up the maps of a family of materials for drawing with the format the driver offers. With s3tc (see
+ * textureCompressionSupported) they become texture arrays like with materialFamilyCreate. Without it every layer would
+ * be a full size RGBA8 image, the small constant maps included, so the maps stay separate textures and the scalar ones
+ * of every material are packed instead (see materialPack), read by color.frag's PACKED_MAPS variant.
+ *
+ * @param materials Materials of the family.
+ * @param extra Further maps the materials switch to later on, see materialFamilyCreate.
+ *
+ * @return Texture arrays of the family, all ids 0 if the maps stay separate textures.
+ */
+MaterialFamily materialFamilyPrepare(const std::vector<Material*>& materials, const std::vector<std::pair<eMaterialMap, Texture*>>& extra = {});
+
+/**
+ * @brief Releases the references a family holds to its texture arrays, the materials hold their own.
+ *
+ * @param family Family to delete.
+ */
+void materialFamilyDelete(MaterialFamily& family);
+
+/**
+ * @brief Layers of the maps of a material that belongs to a family, in the order of eMaterialMap.
+ *
+ * @param material Material of a family.
+ * @param layers Receives one layer per map slot.
+ */
+void materialLayers(const Material& material, int layers[MATERIAL_MAP_COUNT]);
+
 struct Model
 {
     Mesh mesh;
     std::string name;
     std::vector<Material> material;
+
+    /* bounding sphere of the vertices in object space, used for LOD selection */
+    Vector3D boundsCenter;
+    float boundsRadius = 0.0f;
+};
+
+/* material range of an OBJ object as referenced by 'usemtl' */
+struct ObjMaterialRange
+{
+    std::string material;
+
+    unsigned int indexOffset = 0;
+    unsigned int indexCount = 0;
+    std::vector<MaterialLod> lod;
+    std::vector<MeshCluster> clusters;
+};
+
+/* optional processing steps of modelParse/modelLoad for OBJ files, can be combined */
+enum eModelLoadFlags
+{
+    MODEL_LOAD_DEFAULT  = 0,
+    MODEL_LOAD_OPTIMIZE = 1 << 0,   // vertex cache, overdraw and vertex fetch order of every material range (meshOptimize)
+    MODEL_LOAD_COMPACT  = 1 << 1,   // upload as VERTEX_FORMAT_COMPACT with 16 bit indices where possible
+    MODEL_LOAD_LOD      = 1 << 2,   // append simplified index ranges (about 1/2, 1/4 and 1/8 of the triangles) to every material range
+    MODEL_LOAD_STREAM   = 1 << 3,   // modelLoad goes through modelParseStream, for files that don't fit into memory as a whole
+    MODEL_LOAD_CLUSTER  = 1 << 4,   // split every material range into clusters with bounds for backface culling (modelDrawCulled)
+};
+
+/* CPU side data of one OBJ object ('o' block) */
+struct ObjObject
+{
+    std::string name;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<ObjMaterialRange> material;
+};
+
+/* CPU side content of a whole OBJ file */
+struct ObjData
+{
+    std::vector<std::string> materialLibraries;
+    std::vector<ObjObject> objects;
 };
 
-std::vector<Model> modelLoad(const std::string &filepath);
+/**
+ * @brief Parses an OBJ file into plain vertex/index data without touching OpenGL. The file is memory mapped and
+ * scanned in place, numbers are converted with std::from_chars. Face corners with the same (v, vt, vn) triple are
+ * welded into one vertex per object, so the index buffer actually shares vertices.
+ *
+ * The work is spread over the shared thread pool: a pre-scan finds the 'o' blocks and the v/vt/vn lines, the
+ * attribute pools are filled chunk by chunk and every object builds its vertex arrays concurrently.
+ *
+ * @param filepath Path to the OBJ file.
+ *
+ * @return Objects of the file in order of appearance; material library paths are relative to the OBJ file.
+ */
+ObjData objParse(const std::string &filepath);
+
+/**
+ * @brief Streaming variant of objParse for files that are too large to hold all objects in memory. The attribute
+ * pools are spilled to a memory mapped scratch file instead of the heap, and every object is handed to the callback
+ * and freed as soon as its block is parsed. Peak memory is thereby bounded by the largest object, not by the file.
+ *
+ * @param filepath Path to the OBJ file.
+ * @param libraries Called once with the material library paths of the whole file (relative to the OBJ file), before
+ * the first object.
+ * @param object Called for every object in order of appearance, the object is destroyed after the call.
+ */
+void objStream(const std::string &filepath, const std::function<void(const std::vector<std::string>&)>& libraries,
+               const std::function<void(ObjObject&)>& object);
+
+/* CPU side material as read from an MTL file, texture maps are paths relative to the working directory (empty if unset) */
+struct MaterialData
+{
+    std::string name;
+
+    Vector3D emission;
+    Vector3D ambient;
+    Vector3D diffuse;
+    Vector3D specular;
+    float shininess = 0.0f;
+
+    std::string map_emission;
+    std::string map_ambient;
+    std::string map_diffuse;
+    std::string map_specular;
+    std::string map_shininess;
+    std::string map_normal;
+
+    unsigned int indexOffset = 0;
+    unsigned int indexCount = 0;
+    std::vector<MaterialLod> lod;
+    std::vector<MeshCluster> clusters;
+};
+
+/* CPU side data of one model, ready to be uploaded */
+struct MeshData
+{
+    std::string name;
+
+    std::span<const Vertex> vertices;
+    std::span<const unsigned int> indices;
+    std::vector<MaterialData> material;
+
+    /* keeps the memory behind vertices/indices alive (parsed arrays or the mapped mesh cache blob) */
+    std::shared_ptr<const void> storage;
+};
+
+/**
+ * @brief Parses an MTL file without touching OpenGL.
+ *
+ * @param filepath Path to the MTL file.
+ *
+ * @return Materials by name, texture paths are resolved relative to the MTL file.
+ */
+std::map<std::string, MaterialData> materialParse(const std::string &filepath);
+
+/**
+ * @brief CPU stage of modelLoad: reads an OBJ file (or its valid mesh cache blob) and its material libraries into
+ * plain data. Does not need an OpenGL context, so it can run on any thread. The optional processing steps are
+ * stored in the mesh cache, so they only cost time when the cache is rebuilt.
+ *
+ * @param filepath Path to the OBJ file.
+ * @param flags Combination of eModelLoadFlags.
+ *
+ * @return One entry per object of the file.
+ */
+std::vector<MeshData> modelParse(const std::string &filepath, unsigned int flags = MODEL_LOAD_DEFAULT);
+
+/**
+ * @brief Streaming variant of modelParse built on objStream. Every object is processed (optimization, LOD), appended
+ * to the mesh cache blob and handed to the callback right after it is parsed. A valid mesh cache blob is streamed
+ * as well, each object's pages are dropped from memory after the callback returns. If a cached object turns out to be
+ * damaged, the objects that are still missing come from the OBJ file, no object is handed out twice.
+ *
+ * @param filepath Path to the OBJ file.
+ * @param flags Combination of eModelLoadFlags.
+ * @param mesh Called for every object in file order, the data is only valid during the call.
+ */
+void modelParseStream(const std::string &filepath, unsigned int flags, const std::function<void(const MeshData&)>& mesh);
+
+/**
+ * @brief GL stage of modelLoad: creates the meshes and loads the textures of parsed models.
+ *
+ * @param meshes Parsed models (see modelParse).
+ * @param flags Combination of eModelLoadFlags, only MODEL_LOAD_COMPACT matters here.
+ *
+ * @return Models that can be drawn with OpenGL.
+ */
+std::vector<Model> modelUpload(const std::vector<MeshData>& meshes, unsigned int flags = MODEL_LOAD_DEFAULT);
+
+/**
+ * @brief Creates a material from parsed data and loads its texture maps.
+ *
+ * @param data Parsed material.
+ *
+ * @return Material with uploaded textures.
+ */
+Material materialUpload(const MaterialData& data);
+
+/**
+ * @brief Loads an OBJ file with its materials, equivalent to modelUpload(modelParse(filepath)). Files ending in .glb
+ * are passed on to glbLoad.
+ *
+ * @param filepath Path to the OBJ or GLB file.
+ * @param flags Combination of eModelLoadFlags (OBJ only, GLB buffers are used as stored).
+ *
+ * @return One model per object of the file.
+ */
+std::vector<Model> modelLoad(const std::string &filepath, unsigned int flags = MODEL_LOAD_DEFAULT);
+
+/**
+ * @brief Draws the index range of one material of a model. The vertex array of the model has to be bound already,
+ * ranges with their own vertex array (GLB primitives) bind it themselves.
+ *
+ * @param model Model the material belongs to.
+ * @param material Material range to draw.
+ * @param lod Level of detail, 0 is the full range; levels the material doesn't have fall back to its coarsest one.
+ * @param record Per draw record in the bound window of the draw ring (see drawRingPush).
+ */
+void modelDraw(const Model& model, const Material& material, unsigned int lod = 0, unsigned int record = 0);
+
+/**
+ * @brief Draws the index range of one material like modelDraw, but skips the clusters (see MODEL_LOAD_CLUSTER) that
+ * face away from the viewer. The remaining clusters are merged into runs, which are issued with one
+ * glMultiDrawElements call. Materials without clusters and coarser levels of detail are drawn as a whole.
+ *
+ * @param model Model the material belongs to.
+ * @param material Material range to draw.
+ * @param viewPosition Camera position in the object space of the model.
+ * @param lod Level of detail, see modelDraw.
+ * @param record Per draw record, see modelDraw.
+ *
+ * @return Number of triangles submitted.
+ */
+unsigned int modelDrawCulled(const Model& model, const Material& material, const Vector3D& viewPosition, unsigned int lod = 0, unsigned int record = 0);
+
+/**
+ * @brief Picks the coarsest level of detail of a model whose error stays below a limit in all of its materials.
+ *
+ * @param model Model loaded with MODEL_LOAD_LOD (other models always return 0).
+ * @param maxError Largest acceptable geometric error in object space units, usually the size of a pixel at the
+ * distance of the model.
+ *
+ * @return Level to pass to modelDraw.
+ */
+unsigned int modelSelectLod(const Model& model, float maxError);
 void modelDelete(std::vector<Model>& models);
 void modelDelete(Model& model);
@@ -1,5 +1,10 @@
 #include "shader.h"
+#include "shader_cache.h"
+#include "thread_pool.h"
+#include "uniform_buffer.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -9,10 +14,14 @@ namespace detail
 {
     void compile(GLuint handle, const char* source, const int size)
     {
-        GLint compileResult = 0;
-
         glShaderSource(handle, 1, &source, &size);
         glCompileShader(handle);
+    }
+
+    /* the status queries wait for the driver, so they are only made once the program is needed (see resolve) */
+    void checkCompile(GLuint handle)
+    {
+        GLint compileResult = 0;
         glGetShaderiv(handle, GL_COMPILE_STATUS, &compileResult);
 
         if(compileResult == GL_FALSE)
@@ -31,10 +40,8 @@ namespace detail
         }
     }
 
-    void link(GLuint handle)
+    void checkLink(GLuint handle)
     {
-        glLinkProgram(handle);
-
         GLint result;
         glGetProgramiv(handle, GL_LINK_STATUS, &result);
 
@@ -57,31 +64,242 @@ namespace detail
             throw std::runtime_error((std::string("[Shader] ERROR link shaderprogram: \n") + programLog));
         }
     }
+
+    /* fills the uniform table of a linked program, the only place that queries uniform locations */
+    void reflectUniforms(ShaderProgram& program)
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program.id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program.id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::size_t tableSize = 1;
+        while(tableSize < 2 * static_cast<std::size_t>(count))
+        {
+            tableSize *= 2;
+        }
+        program._uniforms.assign(tableSize, ShaderUniform{});
+        std::vector<std::string> names(tableSize);
+
+        std::string name(static_cast<std::size_t>(std::max(maxLength, 1)), '\0');
+        for(GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            ShaderUniform uniform;
+            glGetActiveUniform(program.id, static_cast<GLuint>(i), maxLength, &length, &uniform.size, &uniform.type, &name[0]);
+            std::string uniformName = name.substr(0, static_cast<std::size_t>(length));
+
+            /* members of uniform blocks have no location and are set through their buffer */
+            uniform.location = glGetUniformLocation(program.id, uniformName.c_str());
+            if(uniform.location < 0)
+            {
+                continue;
+            }
+
+            /* arrays are reported as name[0] and set from their first element */
+            if(uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0)
+            {
+                uniformName.resize(uniformName.size() - 3);
+            }
+            uniform.hash = uniformHash(uniformName);
+
+            std::size_t mask = tableSize - 1;
+            std::size_t slot = uniform.hash & mask;
+            while(program._uniforms[slot].location >= 0)
+            {
+                if(program._uniforms[slot].hash == uniform.hash)
+                {
+                    throw std::runtime_error("[Shader] uniforms " + names[slot] + " and " + uniformName + " have the same name hash");
+                }
+                slot = (slot + 1) & mask;
+            }
+            program._uniforms[slot] = uniform;
+            names[slot] = uniformName;
+        }
+    }
 }
 
-ShaderProgram shaderCreate(const std::string &vertexSource, const std::string &fragmentSource)
+namespace detail
 {
-    ShaderProgram program{glCreateProgram(), glCreateShader(GL_VERTEX_SHADER), glCreateShader(GL_FRAGMENT_SHADER)};
+    /* inserts a #define for every macro after the #version line (which has to stay the first statement) */
+    std::string addDefines(const std::string& source, const std::vector<std::string>& defines)
+    {
+        if(defines.empty())
+        {
+            return source;
+        }
+
+        std::string lines;
+        for(const auto& define : defines)
+        {
+            lines += "#define " + define + "\n";
+        }
+
+        std::size_t version = source.find("#version");
+        std::size_t insert = version == std::string::npos ? 0 : source.find('\n', version);
+        insert = insert == std::string::npos ? source.size() : insert + (version == std::string::npos ? 0 : 1);
+        return source.substr(0, insert) + lines + source.substr(insert);
+    }
+}
 
-    if(!program._vertexID || !program._fragmentID || !program.id)
+namespace detail
+{
+    /* compiler threads from the environment variable MYGL_SHADER_THREADS, the size of the worker pool if it isn't set */
+    unsigned int compilerThreads()
     {
-        std::cerr << "[Shader] Couldn't create shader program!" << std::endl;
-        std::cerr.flush();
-        throw std::runtime_error("[Shader] Couldn't create shader program!");
+        if(const char* env = std::getenv("MYGL_SHADER_THREADS"))
+        {
+            int threads = std::atoi(env);
+            if(threads > 0)
+            {
+                return static_cast<unsigned int>(threads);
+            }
+        }
+        return threadPoolSize();
+    }
+
+    bool parallelCompileSupported()
+    {
+        return GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+    }
+
+    /* lets the driver compile and link on its own threads, once per context */
+    void parallelCompileEnable()
+    {
+        static bool enabled = false;
+        if(enabled)
+        {
+            return;
+        }
+        enabled = true;
+
+        if(GLAD_GL_KHR_parallel_shader_compile)
+        {
+            glMaxShaderCompilerThreadsKHR(compilerThreads());
+        }
+        else if(GLAD_GL_ARB_parallel_shader_compile)
+        {
+            glMaxShaderCompilerThreadsARB(compilerThreads());
+        }
     }
 
-    detail::compile(program._vertexID, vertexSource.c_str(), vertexSource.size());
-    glAttachShader(program.id, program._vertexID);
+    /* starts compiling and linking a program without waiting for the driver. A cached binary skips compiling and
+       linking, the program then has no shader objects. */
+    ShaderProgram submit(const std::string& vertexSource, const std::string& fragmentSource)
+    {
+        ShaderProgram program{glCreateProgram()};
 
-    detail::compile(program._fragmentID, fragmentSource.c_str(), fragmentSource.size());
-    glAttachShader(program.id, program._fragmentID);
+        if(!program.id)
+        {
+            std::cerr << "[Shader] Couldn't create shader program!" << std::endl;
+            std::cerr.flush();
+            throw std::runtime_error("[Shader] Couldn't create shader program!");
+        }
 
-    detail::link(program.id);
+        program._pending = true;
+        program._submitTime = glfwGetTime();
+        bool cached = shaderCacheSupported();
+        program._cacheKey = cached ? shaderCacheKey(vertexSource, fragmentSource) : 0;
+        if(cached && shaderCacheLoad(program._cacheKey, program.id))
+        {
+            return program;
+        }
 
+        program._vertexID = glCreateShader(GL_VERTEX_SHADER);
+        program._fragmentID = glCreateShader(GL_FRAGMENT_SHADER);
+        if(!program._vertexID || !program._fragmentID)
+        {
+            std::cerr << "[Shader] Couldn't create shader program!" << std::endl;
+            std::cerr.flush();
+            throw std::runtime_error("[Shader] Couldn't create shader program!");
+        }
+
+        compile(program._vertexID, vertexSource.c_str(), vertexSource.size());
+        glAttachShader(program.id, program._vertexID);
+
+        compile(program._fragmentID, fragmentSource.c_str(), fragmentSource.size());
+        glAttachShader(program.id, program._fragmentID);
+
+        if(cached)
+        {
+            glProgramParameteri(program.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(program.id);
+        return program;
+    }
+
+    /* waits for a submitted program, reports its errors and reflects its uniforms */
+    void resolve(ShaderProgram& program)
+    {
+        if(program._vertexID != 0)
+        {
+            checkCompile(program._vertexID);
+            checkCompile(program._fragmentID);
+            checkLink(program.id);
+
+            /* the time until the compile was seen finished, shaderReady may have seen it before */
+            if(program._compileSeconds < 0.0)
+            {
+                program._compileSeconds = glfwGetTime() - program._submitTime;
+            }
+            shaderCacheStore(program._cacheKey, program.id, program._compileSeconds);
+        }
+
+        reflectUniforms(program);
+        uniformBlockBind(program.id);
+        program._pending = false;
+    }
+}
+
+ShaderProgram shaderCreate(const std::string &vertexSource, const std::string &fragmentSource)
+{
+    ShaderProgram program = detail::submit(vertexSource, fragmentSource);
+    detail::resolve(program);
     return program;
 }
 
-ShaderProgram shaderLoad(const std::string &vertexPath, const std::string &fragmentPath)
+std::vector<ShaderProgram> shaderCreateAsync(const std::vector<ShaderSource>& sources)
+{
+    detail::parallelCompileEnable();
+
+    std::vector<ShaderProgram> programs;
+    programs.reserve(sources.size());
+    for(const auto& source : sources)
+    {
+        programs.push_back(detail::submit(source.vertex, source.fragment));
+    }
+    return programs;
+}
+
+bool shaderReady(ShaderProgram& program)
+{
+    if(!program._pending || program._vertexID == 0)
+    {
+        return true;
+    }
+    if(!detail::parallelCompileSupported())
+    {
+        return false;
+    }
+
+    GLint done = GL_FALSE;
+    glGetProgramiv(program.id, GL_COMPLETION_STATUS_KHR, &done);
+    if(done == GL_TRUE && program._compileSeconds < 0.0)
+    {
+        program._compileSeconds = glfwGetTime() - program._submitTime;
+    }
+    return done == GL_TRUE;
+}
+
+void shaderUse(ShaderProgram& program)
+{
+    if(program._pending)
+    {
+        detail::resolve(program);
+    }
+    glUseProgram(program.id);
+}
+
+ShaderSource shaderSourceLoad(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines)
 {
     std::ifstream vertexFile(vertexPath);
     std::ifstream fragmentFile(fragmentPath);
@@ -106,15 +324,28 @@ ShaderProgram shaderLoad(const std::string &vertexPath, const std::string &fragm
     std::stringstream fragmentSourceBuffer;
     fragmentSourceBuffer << fragmentFile.rdbuf();
 
-    return shaderCreate(vertexSourceBuffer.str(), fragmentSourceBuffer.str());
+    return ShaderSource{detail::addDefines(vertexSourceBuffer.str(), defines), detail::addDefines(fragmentSourceBuffer.str(), defines)};
+}
+
+ShaderProgram shaderLoad(const std::string &vertexPath, const std::string &fragmentPath, const std::vector<std::string>& defines)
+{
+    ShaderSource source = shaderSourceLoad(vertexPath, fragmentPath, defines);
+    return shaderCreate(source.vertex, source.fragment);
 }
 
 void shaderDelete(const ShaderProgram &program)
 {
-    glDetachShader(program.id, program._vertexID);
-    glDetachShader(program.id, program._fragmentID);
-    glDeleteShader(program._vertexID);
-    glDeleteShader(program._fragmentID);
+    /* programs loaded from the binary cache have no shader objects */
+    if(program._vertexID != 0)
+    {
+        glDetachShader(program.id, program._vertexID);
+        glDeleteShader(program._vertexID);
+    }
+    if(program._fragmentID != 0)
+    {
+        glDetachShader(program.id, program._fragmentID);
+        glDeleteShader(program._fragmentID);
+    }
 
     glDeleteProgram(program.id);
 }
@@ -123,55 +354,118 @@ void shaderDelete(const ShaderProgram &program)
 namespace detail
 {
 
-GLint uniform_index(ShaderProgram &shader, const std::string &name)
+/* whether a value of the type a setter passes to glUniform* can be stored in a uniform of a declared type */
+bool uniformTypeMatches(GLenum declared, GLenum value)
+{
+    switch(declared)
+    {
+        case GL_BOOL: return value == GL_INT || value == GL_FLOAT;
+        case GL_BOOL_VEC2: return value == GL_FLOAT_VEC2;
+        case GL_BOOL_VEC3: return value == GL_FLOAT_VEC3;
+        case GL_BOOL_VEC4: return value == GL_FLOAT_VEC4;
+        case GL_FLOAT:
+        case GL_FLOAT_VEC2:
+        case GL_FLOAT_VEC3:
+        case GL_FLOAT_VEC4:
+        case GL_FLOAT_MAT4: return value == declared;
+        /* int and sampler uniforms are set with glUniform1i */
+        default: return value == GL_INT;
+    }
+}
+
+const ShaderUniform& uniformFind(const ShaderProgram& shader, UniformName name, GLenum value)
+{
+    if(shader._pending)
+    {
+        std::cerr << "[Shader] Uniform " << name.name << " set before the program was resolved by shaderUse" << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error(std::string("[Shader] Uniform ") + name.name + " set before the program was resolved by shaderUse");
+    }
+
+    const std::vector<ShaderUniform>& table = shader._uniforms;
+    if(!table.empty())
+    {
+        std::size_t mask = table.size() - 1;
+        for(std::size_t slot = name.hash & mask; table[slot].location >= 0; slot = (slot + 1) & mask)
+        {
+            if(table[slot].hash == name.hash)
+            {
+                if(!uniformTypeMatches(table[slot].type, value))
+                {
+                    std::cerr << "[Shader] Value for uniform " << name.name << " has the wrong type" << std::endl;
+                    std::cerr.flush();
+                    throw std::runtime_error(std::string("[Shader] Value for uniform ") + name.name + " has the wrong type");
+                }
+                return table[slot];
+            }
+        }
+    }
+
+    std::cerr << "[Shader] Couldn't set value for uniform " << name.name << std::endl;
+    std::cerr.flush();
+    throw std::runtime_error(std::string("[Shader] Couldn't set value for uniform ") + name.name);
+}
+
+/* array setters may set fewer elements than the array has, but not more */
+GLsizei uniformCount(const ShaderUniform& uniform, UniformName name, int count)
 {
-    GLint index = glGetUniformLocation(shader.id, name.c_str());
-    if(index < 0)
+    if(count < 0 || count > uniform.size)
     {
-        std::cerr << "[Shader] Couldn't set value for uniform " << name << std::endl;
+        std::cerr << "[Shader] Too many values for uniform array " << name.name << std::endl;
         std::cerr.flush();
-        throw std::runtime_error("[Shader] Couldn't set value for uniform " + name);
+        throw std::runtime_error(std::string("[Shader] Too many values for uniform array ") + name.name);
     }
+    return static_cast<GLsizei>(count);
+}
 
-    return index;
 }
 
+void shaderUniform(const ShaderProgram& shader, UniformName name, const Matrix4D& value)
+{
+    glUniformMatrix4fv(detail::uniformFind(shader, name, GL_FLOAT_MAT4).location, 1, GL_FALSE, value.ptr());
 }
 
-void shaderUniform(ShaderProgram &shader, const std::string &name, const Matrix4D& value)
+void shaderUniform(const ShaderProgram& shader, UniformName name, int value)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniformMatrix4fv(index, 1, GL_FALSE, value.ptr());
+    glUniform1i(detail::uniformFind(shader, name, GL_INT).location, value);
 }
 
-void shaderUniform(ShaderProgram &shader, const std::string &name, int value)
+void shaderUniform(const ShaderProgram& shader, UniformName name, const int* values, int count)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniform1i(index, value);
+    const ShaderUniform& uniform = detail::uniformFind(shader, name, GL_INT);
+    glUniform1iv(uniform.location, detail::uniformCount(uniform, name, count), values);
 }
 
-void shaderUniform(ShaderProgram &shader, const std::string &name, const Vector2D& vec)
+void shaderUniform(const ShaderProgram& shader, UniformName name, const float* values, int count)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniform2f(index, vec.x, vec.y);
+    const ShaderUniform& uniform = detail::uniformFind(shader, name, GL_FLOAT);
+    glUniform1fv(uniform.location, detail::uniformCount(uniform, name, count), values);
 }
 
+void shaderUniform(const ShaderProgram& shader, UniformName name, const Vector2D* values, int count)
+{
+    static_assert(sizeof(Vector2D) == 2 * sizeof(float), "Vector2D arrays are passed to glUniform2fv as floats");
+
+    const ShaderUniform& uniform = detail::uniformFind(shader, name, GL_FLOAT_VEC2);
+    glUniform2fv(uniform.location, detail::uniformCount(uniform, name, count), &values[0].x);
+}
 
-void shaderUniform(ShaderProgram &shader, const std::string &name, const Vector3D& vec)
+void shaderUniform(const ShaderProgram& shader, UniformName name, const Vector2D& vec)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniform3f(index, vec.x, vec.y, vec.z);
+    glUniform2f(detail::uniformFind(shader, name, GL_FLOAT_VEC2).location, vec.x, vec.y);
 }
 
-void shaderUniform(ShaderProgram &shader, const std::string &name, const Vector4D& vec)
+void shaderUniform(const ShaderProgram& shader, UniformName name, const Vector3D& vec)
 {
-    GLint index = detail::uniform_index(shader, name);
+    glUniform3f(detail::uniformFind(shader, name, GL_FLOAT_VEC3).location, vec.x, vec.y, vec.z);
+}
 
-    glUniform4f(index, vec.x, vec.y, vec.z, vec.w);
+void shaderUniform(const ShaderProgram& shader, UniformName name, const Vector4D& vec)
+{
+    glUniform4f(detail::uniformFind(shader, name, GL_FLOAT_VEC4).location, vec.x, vec.y, vec.z, vec.w);
 }
 
-void shaderUniform(ShaderProgram &shader, const std::string &name, float value)
+void shaderUniform(const ShaderProgram& shader, UniformName name, float value)
 {
-    GLint index = detail::uniform_index(shader, name);
-    glUniform1f(index, value);
+    glUniform1f(detail::uniformFind(shader, name, GL_FLOAT).location, value);
 }
@@ -2,11 +2,68 @@
 
 #include "base.h"
 
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief 32 bit FNV-1a hash of a uniform name, the key of the uniform table of a shader program.
+ *
+ * @param name Uniform name, array uniforms without the [0] suffix.
+ *
+ * @return Hash value.
+ */
+constexpr std::uint32_t uniformHash(std::string_view name)
+{
+    std::uint32_t hash = 2166136261u;
+    for(char c : name)
+    {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+/* name of a uniform as passed to shaderUniform, string literals are hashed at compile time so setting a uniform never
+   builds or hashes a string at run time */
+struct UniformName
+{
+    const char* name;
+    std::uint32_t hash;
+
+    consteval UniformName(const char* name) : name(name), hash(uniformHash(name)) {}
+};
+
+/* active uniform of a linked shader program */
+struct ShaderUniform
+{
+    std::uint32_t hash = 0;
+    GLint location = -1;    // -1 marks an empty slot of the table
+    GLenum type = 0;
+    GLint size = 0;         // number of array elements, 1 for plain uniforms
+};
+
 struct ShaderProgram
 {
     GLuint id = 0;
-    GLuint _vertexID = 0;
+    GLuint _vertexID = 0;       // 0 if the program was loaded from the binary cache
     GLuint _fragmentID = 0;
+
+    /* active uniforms reflected once after linking, open addressed by name hash (power of two size, at most half full) */
+    std::vector<ShaderUniform> _uniforms;
+
+    /* compile and link of shaderCreateAsync are still in flight, shaderUse resolves them */
+    bool _pending = false;
+    std::uint64_t _cacheKey = 0;
+    double _submitTime = 0.0;
+    double _compileSeconds = -1.0;  // time until the compile was seen finished, -1 while unknown
+};
+
+/* vertex and fragment source of a program, defines already inserted */
+struct ShaderSource
+{
+    std::string vertex;
+    std::string fragment;
 };
 
 /**
@@ -14,13 +71,28 @@ struct ShaderProgram
  *
  * @param vertexPath Path to vertex shader file.
  * @param fragmentPath Path to fragment shader file.
+ * @param defines Macros defined in both shaders right after their #version line, to compile variants of a shader.
  *
  * @return Shader program.
  */
-ShaderProgram shaderLoad(const std::string& vertexPath, const std::string& fragmentPath);
+ShaderProgram shaderLoad(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines = {});
 
 /**
- * @brief Function to compile and link vertex and fragement source strings to create shader program.
+ * @brief Function to load vertex and fragment shader from file without compiling them (see shaderCreateAsync).
+ *
+ * @param vertexPath Path to vertex shader file.
+ * @param fragmentPath Path to fragment shader file.
+ * @param defines Macros defined in both shaders right after their #version line, see shaderLoad.
+ *
+ * @return Sources of the program.
+ */
+ShaderSource shaderSourceLoad(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines = {});
+
+/**
+ * @brief Function to compile and link vertex and fragement source strings to create shader program. If the binary
+ * cache (see shader_cache.h) holds the program for these sources and this driver, it is loaded from there instead;
+ * programs compiled from source are added to it. The active uniforms of the linked program are reflected into its
+ * uniform table and its uniform blocks get their fixed binding points (see eUniformBlock).
  *
  * @param vertexSource Source string holding vertex shader code.
  * @param fragmentSource Source string holding fragment shader code.
@@ -29,6 +101,39 @@ ShaderProgram shaderLoad(const std::string& vertexPath, const std::string& fragm
  */
 ShaderProgram shaderCreate(const std::string& vertexSource, const std::string& fragmentSource);
 
+/**
+ * @brief Submits the compile and link of several programs at once without waiting for any of them. With
+ * GL_KHR_parallel_shader_compile (or the ARB version) the driver works on them concurrently on MYGL_SHADER_THREADS
+ * threads (the size of the worker pool if it isn't set) while the caller goes on. Programs in the binary cache are
+ * loaded right away. Compile and link errors are only reported when a program is first used (see shaderUse).
+ *
+ * @param sources Sources of the programs.
+ *
+ * @return Submitted programs, in the order of their sources.
+ */
+std::vector<ShaderProgram> shaderCreateAsync(const std::vector<ShaderSource>& sources);
+
+/**
+ * @brief Polls whether the driver is done with a program of shaderCreateAsync, without waiting for it
+ * (GL_COMPLETION_STATUS_KHR). Without the parallel compile extension the state can't be polled and programs
+ * compiled from source only report true once shaderUse resolved them.
+ *
+ * @param program Shader program.
+ *
+ * @return True if using the program doesn't wait for the compiler.
+ */
+bool shaderReady(ShaderProgram& program);
+
+/**
+ * @brief Makes a program current. The first use of a program of shaderCreateAsync waits for it if it isn't ready
+ * yet, reports its errors and reflects its uniforms; uniforms can only be set after that.
+ *
+ * @param program Shader program.
+ *
+ * @throws std::runtime_error If the program failed to compile or link.
+ */
+void shaderUse(ShaderProgram& program);
+
 /**
  * @brief Cleanup and delete all shaders of a shader program and the program itself. Has to be called for each shader program after it is not used anymore.
  *
@@ -37,55 +142,89 @@ ShaderProgram shaderCreate(const std::string& vertexSource, const std::string& f
 void shaderDelete(const ShaderProgram& program);
 
 /**
- * @brief Function to set uniform in shader program.
+ * @brief Function to set uniform in shader program. The uniform is looked up in the table the program reflected when
+ * it was linked, no string is built and the driver is not queried for its location.
  *
  * @param shader Shader program.
- * @param name Uniform naem.
+ * @param name Uniform name.
  * @param value Value to which the uniform should be set.
+ *
+ * @throws std::runtime_error If the program has no active uniform of that name or its type doesn't match the value, or
+ * if it is a program of shaderCreateAsync that shaderUse hasn't resolved yet.
  */
-void shaderUniform(ShaderProgram& shader, const std::string& name, const Matrix4D& value);
+void shaderUniform(const ShaderProgram& shader, UniformName name, const Matrix4D& value);
 
 /**
  * @brief Function to set uniform in shader program.
  *
  * @param shader Shader program.
- * @param name Uniform naem.
+ * @param name Uniform name.
  * @param value Value to which the uniform should be set.
  */
-void shaderUniform(ShaderProgram &shader, const std::string &name, const Vector2D& vec);
+void shaderUniform(const ShaderProgram& shader, UniformName name, const Vector2D& vec);
 
 /**
  * @brief Function to set uniform in shader program.
  *
  * @param shader Shader program.
- * @param name Uniform naem.
+ * @param name Uniform name.
  * @param value Value to which the uniform should be set.
  */
-void shaderUniform(ShaderProgram& shader, const std::string& name, const Vector3D& vec);
+void shaderUniform(const ShaderProgram& shader, UniformName name, const Vector3D& vec);
 
 /**
  * @brief Function to set uniform in shader program.
  *
  * @param shader Shader program.
- * @param name Uniform naem.
+ * @param name Uniform name.
  * @param value Value to which the uniform should be set.
  */
-void shaderUniform(ShaderProgram& shader, const std::string& name, const Vector4D& vec);
+void shaderUniform(const ShaderProgram& shader, UniformName name, const Vector4D& vec);
 
 /**
- * @brief Function to set uniform in shader program.
+ * @brief Function to set uniform in shader program (int, bool or sampler uniforms).
  *
  * @param shader Shader program.
- * @param name Uniform naem.
+ * @param name Uniform name.
  * @param value Value to which the uniform should be set.
  */
-void shaderUniform(ShaderProgram& shader, const std::string& name, int value);
+void shaderUniform(const ShaderProgram& shader, UniformName name, int value);
 
 /**
  * @brief Function to set uniform in shader program.
  *
  * @param shader Shader program.
- * @param name Uniform naem.
+ * @param name Uniform name.
  * @param value Value to which the uniform should be set.
  */
-void shaderUniform(ShaderProgram& shader, const std::string& name, float value);
+void shaderUniform(const ShaderProgram& shader, UniformName name, float value);
+
+/**
+ * @brief Function to set an int array uniform in shader program with one call.
+ *
+ * @param shader Shader program.
+ * @param name Uniform name (of the array, without [0]).
+ * @param values Values to which the array elements should be set, starting at element 0.
+ * @param count Number of values, at most the array size.
+ */
+void shaderUniform(const ShaderProgram& shader, UniformName name, const int* values, int count);
+
+/**
+ * @brief Function to set a float array uniform in shader program with one call.
+ *
+ * @param shader Shader program.
+ * @param name Uniform name (of the array, without [0]).
+ * @param values Values to which the array elements should be set, starting at element 0.
+ * @param count Number of values, at most the array size.
+ */
+void shaderUniform(const ShaderProgram& shader, UniformName name, const float* values, int count);
+
+/**
+ * @brief Function to set a vec2 array uniform in shader program with one call.
+ *
+ * @param shader Shader program.
+ * @param name Uniform name (of the array, without [0]).
+ * @param values Values to which the array elements should be set, starting at element 0.
+ * @param count Number of values, at most the array size.
+ */
+void shaderUniform(const ShaderProgram& shader, UniformName name, const Vector2D* values, int count);
@@ -0,0 +1,197 @@
+#include "shader_cache.h"
+#include "hash.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+#include <vector>
+
+namespace detail
+{
+
+const char SHADER_CACHE_MAGIC[8] = {'M', 'Y', 'G', 'L', 'P', 'R', 'O', 'G'};
+
+struct ShaderCacheHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t format;
+    std::uint64_t key;
+    std::uint64_t binarySize;
+    std::uint64_t binaryHash;
+    double compileSeconds;
+};
+
+ShaderCacheStats shaderCacheStats;
+
+std::string shaderCachePath(std::uint64_t key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.progcache", static_cast<unsigned long long>(key));
+    return (std::filesystem::path(shaderCacheDirectory()) / name).string();
+}
+
+/* a file that can't be used is removed, so the next store replaces it */
+void shaderCacheDrop(const std::string& path)
+{
+    std::error_code error;
+    std::filesystem::remove(path, error);
+}
+
+}
+
+const std::string& shaderCacheDirectory()
+{
+    static const std::string directory = []() {
+        const char* env = std::getenv("MYGL_SHADER_CACHE");
+        return std::string(env ? env : "shader_cache");
+    }();
+    return directory;
+}
+
+bool shaderCacheSupported()
+{
+    if(shaderCacheDirectory().empty() || !GLAD_GL_ARB_get_program_binary)
+    {
+        return false;
+    }
+
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+std::uint64_t shaderCacheKey(const std::string& vertexSource, const std::string& fragmentSource)
+{
+    std::uint64_t key = hash64(vertexSource.data(), vertexSource.size(), SHADER_CACHE_VERSION);
+    key = hash64(fragmentSource.data(), fragmentSource.size(), key);
+    for(GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+    {
+        const char* value = reinterpret_cast<const char*>(glGetString(name));
+        key = hash64(value, value ? std::strlen(value) : 0, key);
+    }
+    return key;
+}
+
+bool shaderCacheLoad(std::uint64_t key, GLuint program)
+{
+    std::string path = detail::shaderCachePath(key);
+    std::ifstream in(path, std::ios::binary);
+    if(!in.is_open())
+    {
+        return false;
+    }
+
+    double loadTime = glfwGetTime();
+    detail::ShaderCacheHeader header;
+    std::vector<char> binary;
+    bool valid = static_cast<bool>(in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+                 && std::memcmp(header.magic, detail::SHADER_CACHE_MAGIC, sizeof(header.magic)) == 0
+                 && header.version == SHADER_CACHE_VERSION
+                 && header.key == key
+                 && header.binarySize > 0 && header.binarySize < (1ull << 30);
+    if(valid)
+    {
+        binary.resize(static_cast<std::size_t>(header.binarySize));
+        valid = in.read(binary.data(), static_cast<std::streamsize>(binary.size()))
+                && hash64(binary.data(), binary.size()) == header.binaryHash;
+    }
+    in.close();
+
+    if(!valid)
+    {
+        std::cerr << "[ShaderCache] " << path << " is corrupt, compiling from source" << std::endl;
+        detail::shaderCacheDrop(path);
+        detail::shaderCacheStats.rejected++;
+        return false;
+    }
+
+    /* drivers reject binaries of other driver builds or hardware, the program is simply compiled again then */
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if(linked == GL_FALSE)
+    {
+        /* an unknown format is also reported as a GL error, which isn't one of the program */
+        while(glGetError() != GL_NO_ERROR)
+        {
+        }
+        std::cerr << "[ShaderCache] driver rejected " << path << ", compiling from source" << std::endl;
+        detail::shaderCacheDrop(path);
+        detail::shaderCacheStats.rejected++;
+        return false;
+    }
+
+    loadTime = glfwGetTime() - loadTime;
+    detail::shaderCacheStats.hits++;
+    detail::shaderCacheStats.loadSeconds += loadTime;
+    detail::shaderCacheStats.savedSeconds += header.compileSeconds - loadTime;
+    return true;
+}
+
+void shaderCacheStore(std::uint64_t key, GLuint program, double compileSeconds)
+{
+    detail::shaderCacheStats.compiles++;
+    detail::shaderCacheStats.compileSeconds += compileSeconds;
+
+    if(!shaderCacheSupported())
+    {
+        return;
+    }
+
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if(size <= 0)
+    {
+        return;
+    }
+
+    detail::ShaderCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::vector<char> binary(static_cast<std::size_t>(size));
+    GLsizei length = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, size, &length, &format, binary.data());
+    binary.resize(static_cast<std::size_t>(length));
+
+    std::memcpy(header.magic, detail::SHADER_CACHE_MAGIC, sizeof(header.magic));
+    header.version = SHADER_CACHE_VERSION;
+    header.format = format;
+    header.key = key;
+    header.binarySize = binary.size();
+    header.binaryHash = hash64(binary.data(), binary.size());
+    header.compileSeconds = compileSeconds;
+
+    /* write to a temporary file first so a crash never leaves a truncated binary behind */
+    std::error_code error;
+    std::filesystem::create_directories(shaderCacheDirectory(), error);
+    std::string path = detail::shaderCachePath(key);
+    std::string tmpPath = path + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+    out.close();
+
+    if(!out)
+    {
+        std::cerr << "[ShaderCache] couldn't write cache file " << tmpPath << std::endl;
+        detail::shaderCacheDrop(tmpPath);
+        return;
+    }
+
+    std::filesystem::rename(tmpPath, path, error);
+    if(error)
+    {
+        std::cerr << "[ShaderCache] couldn't write cache file " << path << ": " << error.message() << std::endl;
+        detail::shaderCacheDrop(tmpPath);
+    }
+}
+
+ShaderCacheStats shaderCacheStats()
+{
+    return detail::shaderCacheStats;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "base.h"
+
+#include <cstdint>
+#include <string>
+
+/* version of the program binary cache format, bump whenever the file layout changes */
+#define SHADER_CACHE_VERSION 1
+
+/* counters of the program binary cache since startup */
+struct ShaderCacheStats
+{
+    unsigned int hits = 0;          // programs loaded from a cached binary
+    unsigned int compiles = 0;      // programs compiled and linked from source
+    unsigned int rejected = 0;      // of these, programs whose cached binary was corrupt or rejected by the driver
+    double compileSeconds = 0.0;    // time spent compiling and linking from source
+    double loadSeconds = 0.0;       // time spent loading cached binaries
+    double savedSeconds = 0.0;      // compile time the hits took when they were cached, minus their load time
+};
+
+/**
+ * @brief Directory of the program binary cache. Defaults to the environment variable MYGL_SHADER_CACHE, "shader_cache"
+ * if it isn't set; an empty value turns the cache off.
+ *
+ * @return Path to the directory, empty if the cache is off.
+ */
+const std::string& shaderCacheDirectory();
+
+/**
+ * @brief Whether the cache can be used: it isn't turned off and the driver offers at least one program binary format
+ * (GL_ARB_get_program_binary).
+ *
+ * @return True if binaries are loaded and stored.
+ */
+bool shaderCacheSupported();
+
+/**
+ * @brief Key of a program in the cache: a hash of both sources and the GL vendor, renderer and version strings, so a
+ * driver update never sees binaries of another driver.
+ *
+ * @param vertexSource Vertex shader source (defines included).
+ * @param fragmentSource Fragment shader source (defines included).
+ *
+ * @return Cache key.
+ */
+std::uint64_t shaderCacheKey(const std::string& vertexSource, const std::string& fragmentSource);
+
+/**
+ * @brief Loads the cached binary of a key into a program object. Corrupt files and binaries the driver rejects are
+ * deleted, the caller compiles the program from source then.
+ *
+ * @param key Cache key (see shaderCacheKey).
+ * @param program Program object without attached shaders.
+ *
+ * @return True if the program is linked from the binary.
+ */
+bool shaderCacheLoad(std::uint64_t key, GLuint program);
+
+/**
+ * @brief Counts a program compiled from source and stores its binary under a key. The program has to be linked with
+ * GL_PROGRAM_BINARY_RETRIEVABLE_HINT set. Failing to write (e.g. read-only working directory) is reported but not an
+ * error.
+ *
+ * @param key Cache key (see shaderCacheKey).
+ * @param program Linked program.
+ * @param compileSeconds Time compiling and linking took, stored to report the time later hits save.
+ */
+void shaderCacheStore(std::uint64_t key, GLuint program, double compileSeconds);
+
+/**
+ * @brief Counters of the cache since startup.
+ *
+ * @return Cache statistics.
+ */
+ShaderCacheStats shaderCacheStats();
@@ -1,17 +1,559 @@
 #include "texture.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
+#include <filesystem>
+#include <future>
 #include <stdexcept>
 #include <iostream>
+#include <unordered_map>
 
 #include <stb_image/stb_image.h>
 
-Texture textureLoad(const std::string &path)
+#include "image_cache.h"
+#include "texture_compress.h"
+#include "thread_pool.h"
+
+namespace detail
+{
+
+/* the texture budget never shrinks a texture below this size on its longer side */
+const unsigned int TEXTURE_BUDGET_MIN_SIZE = 64;
+
+/* streamed textures start with the levels up to this size on their longer side, the larger ones follow frame by frame */
+const unsigned int TEXTURE_STREAM_RESIDENT_SIZE = 64;
+
+/* bytes uploaded per textureStreamUpdate unless MYGL_TEXTURE_STREAM says otherwise */
+const std::size_t TEXTURE_STREAM_DEFAULT_BUDGET = 4 * 1024 * 1024;
+
+/* reference count and cache key of a live texture */
+struct TextureEntry
+{
+    std::string key;
+    unsigned int references = 0;
+    std::size_t bytes = 0;
+    eTextureFormat format = TEXTURE_FORMAT_RGBA8;
+
+    /* source of textures loaded from file, or the channels that were filled of packed ones */
+    std::string path;
+    eTextureUsage usage = TEXTURE_USAGE_DATA;
+    bool flipVertically = false;
+    unsigned int packedChannels = 0;
+
+    /* texture budget: size and VRAM per level of the full chain, and how many of its top levels are left out */
+    std::string name;
+    int priority = TEXTURE_PRIORITY_PRIMARY;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    std::vector<std::size_t> levelBytes;
+    unsigned int skipped = 0;
+};
+
+/* budget from the environment variable MYGL_TEXTURE_BUDGET in MB, 0 (unlimited) if it isn't set */
+std::size_t textureBudgetFromEnvironment()
+{
+    if(const char* env = std::getenv("MYGL_TEXTURE_BUDGET"))
+    {
+        long long megabytes = std::atoll(env);
+        if(megabytes > 0)
+        {
+            return static_cast<std::size_t>(megabytes) * 1024 * 1024;
+        }
+    }
+    return 0;
+}
+
+/* per frame upload budget from the environment variable MYGL_TEXTURE_STREAM in MB, 0 turns streaming off */
+std::size_t textureStreamBudgetFromEnvironment()
+{
+    if(const char* env = std::getenv("MYGL_TEXTURE_STREAM"))
+    {
+        long long megabytes = std::atoll(env);
+        return megabytes > 0 ? static_cast<std::size_t>(megabytes) * 1024 * 1024 : 0;
+    }
+    return TEXTURE_STREAM_DEFAULT_BUDGET;
+}
+
+/* texture whose larger levels are still on their way, the levels are uploaded from the smallest missing one upwards
+ * in whole (block) rows, so a large level can be spread over several frames */
+struct TextureStream
+{
+    GLuint id = 0;
+    int priority = TEXTURE_PRIORITY_PRIMARY;
+    unsigned int skip = 0;      // chain levels left out by the texture budget, chain level skip is GL level 0
+    unsigned int level = 0;     // chain level that is uploaded next
+    unsigned int rows = 0;      // texel rows of that level that are done
+    std::shared_ptr<ImageMips> mips;
+
+    /* texture arrays stream every layer on its own */
+    GLenum target = GL_TEXTURE_2D;
+    unsigned int layer = 0;
+};
+
+/* textures by key (canonical path or color plus parameters) and bookkeeping of all live textures by id */
+struct TextureCache
+{
+    std::unordered_map<std::string, Texture> textures;
+    std::unordered_map<GLuint, TextureEntry> entries;
+    TextureCacheStats stats;
+
+    std::size_t budget = textureBudgetFromEnvironment();
+    bool budgetExceeded = false;
+
+    std::vector<TextureStream> streams;
+    std::size_t streamBudget = textureStreamBudgetFromEnvironment();
+    GLuint streamBuffer = 0;
+};
+
+TextureCache& textureCache()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+/* GPU size of an RGBA8 texture, optionally with its full mip chain */
+std::size_t textureBytes(unsigned int width, unsigned int height, bool mipmaps)
+{
+    std::size_t bytes = std::size_t(width) * height * 4;
+    while(mipmaps && (width > 1 || height > 1))
+    {
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+        bytes += std::size_t(width) * height * 4;
+    }
+    return bytes;
+}
+
+/* starts the bookkeeping of a new texture with one reference */
+void textureRegister(const Texture& texture, const std::string& key, std::size_t bytes)
+{
+    TextureCache& cache = textureCache();
+    TextureEntry& entry = cache.entries[texture.id] = TextureEntry{key, 1, bytes};
+    entry.width = texture.width;
+    entry.height = texture.height;
+    if(!key.empty())
+    {
+        cache.textures[key] = texture;
+    }
+    cache.stats.uploadBytes += bytes;
+    cache.stats.residentBytes += bytes;
+}
+
+/* VRAM of every level of a mip chain */
+std::vector<std::size_t> textureLevelBytes(const ImageMips& mips)
+{
+    std::vector<std::size_t> bytes(mips.levels.size());
+    for(std::size_t level = 0; level < mips.levels.size(); level++)
+    {
+        bytes[level] = textureFormatSize(mips.format, mips.levels[level].width, mips.levels[level].height);
+    }
+    return bytes;
+}
+
+/* number of top levels a texture can leave out without getting smaller than TEXTURE_BUDGET_MIN_SIZE */
+unsigned int textureMaxSkip(unsigned int width, unsigned int height, std::size_t levelCount)
+{
+    unsigned int skip = 0;
+    while(skip + 1 < levelCount && std::max(width >> (skip + 1), height >> (skip + 1)) >= TEXTURE_BUDGET_MIN_SIZE)
+    {
+        skip++;
+    }
+    return skip;
+}
+
+/* first chain level a streamed texture starts with: the largest one that is not above TEXTURE_STREAM_RESIDENT_SIZE */
+unsigned int textureStreamFirst(const std::vector<ImageLevel>& levels, unsigned int skip)
+{
+    unsigned int first = skip;
+    while(first + 1 < levels.size() && std::max(levels[first].width, levels[first].height) > TEXTURE_STREAM_RESIDENT_SIZE)
+    {
+        first++;
+    }
+    return first;
+}
+
+/* specifies levels [skip, end) of a chain as levels [0, end - skip) of the bound texture and returns their VRAM. Only
+ * the levels from first on get their data, the ones above are allocated and left out of sampling with the base level. */
+std::size_t textureUploadLevels(const std::vector<ImageLevel>& levels, eTextureFormat format, unsigned int skip, unsigned int first)
+{
+    std::size_t bytes = 0;
+    for(std::size_t level = skip; level < levels.size(); level++)
+    {
+        GLint target = (GLint) (level - skip);
+        std::size_t size = textureFormatSize(format, levels[level].width, levels[level].height);
+        const unsigned char* pixels = level >= first ? levels[level].pixels : nullptr;
+        if(format == TEXTURE_FORMAT_RGBA8)
+        {
+            glTexImage2D(GL_TEXTURE_2D, target, GL_RGBA8, levels[level].width, levels[level].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+        else
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, target, textureInternalFormat(format), levels[level].width, levels[level].height, 0, (GLsizei) size, pixels);
+        }
+        bytes += size;
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, (GLint) (first - skip));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) (levels.size() - skip) - 1);
+    glCheckError();
+    return bytes;
+}
+
+/* stops streaming a texture, e.g. because it is deleted or uploaded again as a whole */
+void textureStreamCancel(GLuint id)
+{
+    std::vector<TextureStream>& streams = textureCache().streams;
+    streams.erase(std::remove_if(streams.begin(), streams.end(), [id](const TextureStream& stream) { return stream.id == id; }), streams.end());
+}
+
+/* re-specifies a live file texture without its top levels (read again, usually from the disk cache) to free their VRAM */
+void textureDropLevels(GLuint id, unsigned int skip)
+{
+    TextureCache& cache = textureCache();
+    TextureEntry& entry = cache.entries[id];
+    ImageMips mips = imageLoadMips(entry.path, entry.usage, entry.flipVertically);
+    if(mips.levels.size() != entry.levelBytes.size())
+    {
+        std::cerr << "[Texture] " << entry.path << " changed on disk, its levels are kept" << std::endl;
+        return;
+    }
+
+    /* the levels past the shorter chain are released with empty images, levels that were still streaming come along */
+    textureStreamCancel(id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    std::size_t bytes = textureUploadLevels(mips.levels, mips.format, skip, skip);
+    for(std::size_t level = mips.levels.size() - skip; level < mips.levels.size() - entry.skipped; level++)
+    {
+        glTexImage2D(GL_TEXTURE_2D, (GLint) level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glCheckError();
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    cache.stats.uploadBytes += bytes;
+    cache.stats.residentBytes = cache.stats.residentBytes - entry.bytes + bytes;
+    cache.stats.droppedLevels += skip - entry.skipped;
+    entry.bytes = bytes;
+    entry.skipped = skip;
+}
+
+/* a texture that competes for the budget: one that is about to be created (id 0), or a live one that can still shrink */
+struct BudgetCandidate
+{
+    GLuint id = 0;
+    int priority = TEXTURE_PRIORITY_PRIMARY;
+    const std::vector<std::size_t>* levelBytes = nullptr;
+    unsigned int skipped = 0;
+    unsigned int maxSkip = 0;
+};
+
+/* leaves out top levels of the least important (then largest) textures until the incoming ones fit into the budget.
+ * The skips of the incoming candidates are filled in, live textures are shrunk right away. */
+void textureBudgetPlan(std::vector<BudgetCandidate>& incoming)
+{
+    TextureCache& cache = textureCache();
+    if(cache.budget == 0)
+    {
+        return;
+    }
+
+    std::size_t total = cache.stats.residentBytes;
+    for(const BudgetCandidate& candidate : incoming)
+    {
+        for(std::size_t level = candidate.skipped; level < candidate.levelBytes->size(); level++)
+        {
+            total += (*candidate.levelBytes)[level];
+        }
+    }
+    if(total <= cache.budget)
+    {
+        return;
+    }
+
+    std::vector<BudgetCandidate> live;
+    for(const auto& [id, entry] : cache.entries)
+    {
+        unsigned int maxSkip = textureMaxSkip(entry.width, entry.height, entry.levelBytes.size());
+        if(!entry.path.empty() && entry.skipped < maxSkip)
+        {
+            live.push_back(BudgetCandidate{id, entry.priority, &entry.levelBytes, entry.skipped, maxSkip});
+        }
+    }
+
+    /* one level at a time, so equally important textures shrink evenly; on ties incoming textures go first, that
+     * saves uploading live ones again */
+    while(total > cache.budget)
+    {
+        BudgetCandidate* victim = nullptr;
+        for(auto* candidates : {&incoming, &live})
+        {
+            for(BudgetCandidate& candidate : *candidates)
+            {
+                if(candidate.skipped < candidate.maxSkip
+                   && (victim == nullptr || candidate.priority < victim->priority
+                       || (candidate.priority == victim->priority && (*candidate.levelBytes)[candidate.skipped] > (*victim->levelBytes)[victim->skipped])))
+                {
+                    victim = &candidate;
+                }
+            }
+        }
+        if(victim == nullptr)
+        {
+            if(!cache.budgetExceeded)
+            {
+                std::cerr << "[Texture] texture budget of " << cache.budget / (1024 * 1024) << " MB exceeded with every texture at its minimum size" << std::endl;
+                cache.budgetExceeded = true;
+            }
+            break;
+        }
+
+        total -= (*victim->levelBytes)[victim->skipped];
+        victim->skipped++;
+    }
+
+    for(const BudgetCandidate& candidate : live)
+    {
+        if(candidate.skipped != cache.entries[candidate.id].skipped)
+        {
+            textureDropLevels(candidate.id, candidate.skipped);
+        }
+    }
+}
+
+/* usage a texture is really loaded with, without s3tc everything stays RGBA8 */
+eTextureUsage textureUsage(eTextureUsage usage)
+{
+    return textureCompressionSupported() ? usage : TEXTURE_USAGE_DATA;
+}
+
+/* cache key of a texture file, equivalent spellings of a path (./, ../, symlinks) share one texture */
+std::string textureKey(const std::string& path, eTextureUsage usage, bool flipVertically)
+{
+    std::error_code error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    return "file:" + (error ? path : canonical.string()) + "|usage" + std::to_string(usage) + (flipVertically ? "|flip" : "") + "|mipmaps";
+}
+
+/* creates a texture from levels [skip, end) of a chain with data from level first on, the texture keeps the size of
+ * the full level 0 */
+Texture textureCreateLevels(const std::vector<ImageLevel>& levels, eTextureFormat format, unsigned int skip, unsigned int first)
+{
+    /* upload data, all levels are already there */
+    GLuint id = 0;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D, id);
+    std::size_t bytes = textureUploadLevels(levels, format, skip, first);
+
+    /* single channel maps are read as grey like the RGBA8 maps they replace */
+    if(format == TEXTURE_FORMAT_BC4)
+    {
+        const GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glCheckError();
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    Texture texture{id, levels[0].width, levels[0].height};
+    textureRegister(texture, "", bytes);
+    textureCache().entries[id].format = format;
+    return texture;
+}
+
+/* shared textures keep the highest priority any of their users asked for */
+void textureRaisePriority(const Texture& texture, int priority)
+{
+    TextureEntry& entry = textureCache().entries[texture.id];
+    entry.priority = std::max(entry.priority, priority);
+}
+
+/* makes a texture that was just created from a file the cached one for key */
+void textureInsert(const Texture& texture, const std::string& key, const std::string& path, eTextureUsage usage, bool flipVertically,
+                   int priority, const ImageMips& mips, unsigned int skip)
+{
+    TextureCache& cache = textureCache();
+    TextureEntry& entry = cache.entries[texture.id];
+    entry.key = key;
+    entry.path = path;
+    entry.usage = usage;
+    entry.flipVertically = flipVertically;
+    entry.name = path;
+    entry.priority = priority;
+    entry.width = texture.width;
+    entry.height = texture.height;
+    entry.levelBytes = textureLevelBytes(mips);
+    entry.skipped = skip;
+    cache.stats.droppedLevels += skip;
+    cache.textures[key] = texture;
+    if(mips.file.data != nullptr)
+    {
+        cache.stats.diskLoads++;
+    }
+    else
+    {
+        cache.stats.decodes++;
+    }
+    if(mips.format != TEXTURE_FORMAT_RGBA8)
+    {
+        cache.stats.compressed++;
+    }
+}
+
+/* creates the texture of a file from its decoded chain, with streaming on only the small levels are uploaded right away */
+Texture textureCreateFromFile(ImageMips&& mips, unsigned int skip, const std::string& key, const std::string& path, eTextureUsage usage,
+                              bool flipVertically, int priority)
+{
+    TextureCache& cache = textureCache();
+    unsigned int first = cache.streamBudget != 0 ? textureStreamFirst(mips.levels, skip) : skip;
+    Texture texture = textureCreateLevels(mips.levels, mips.format, skip, first);
+    textureInsert(texture, key, path, usage, flipVertically, priority, mips, skip);
+    if(first > skip)
+    {
+        cache.streams.push_back(TextureStream{texture.id, priority, skip, first - 1, 0, std::make_shared<ImageMips>(std::move(mips))});
+    }
+    return texture;
+}
+
+/* returns the cached texture for key with one more reference, or an empty texture */
+Texture textureFind(const std::string& key)
+{
+    TextureCache& cache = textureCache();
+    auto it = cache.textures.find(key);
+    if(it == cache.textures.end())
+    {
+        return Texture{};
+    }
+
+    TextureEntry& entry = cache.entries[it->second.id];
+    entry.references++;
+    cache.stats.hits++;
+    cache.stats.savedBytes += entry.bytes;
+    return it->second;
+}
+
+/* chain of a single colored texture array layer: every level repeats one texel (RGBA8) or one encoded 4x4 block */
+ImageMips textureArrayConstantLayer(const unsigned char* rgba, unsigned int width, unsigned int height, eTextureFormat format)
+{
+    unsigned char texels[4 * 4 * 4];
+    for(unsigned int p = 0; p < 4 * 4; p++)
+    {
+        std::memcpy(texels + p * 4, rgba, 4);
+    }
+    ImageMips block;
+    block.levels = {ImageLevel{4, 4, texels}};
+    block = imageCompress(block, format);
+    const std::size_t unitBytes = format == TEXTURE_FORMAT_RGBA8 ? 4 : textureFormatSize(format, 4, 4);
+
+    ImageMips mips;
+    mips.format = format;
+    std::size_t bytes = 0;
+    for(unsigned int w = width, h = height;; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u))
+    {
+        mips.levels.push_back(ImageLevel{w, h, nullptr});
+        bytes += textureFormatSize(format, w, h);
+        if(w == 1 && h == 1)
+        {
+            break;
+        }
+    }
+
+    /* BCn levels are padded to whole blocks, so every level is a multiple of the unit */
+    mips.storage.resize(bytes);
+    for(std::size_t offset = 0; offset < bytes; offset += unitBytes)
+    {
+        std::memcpy(mips.storage.data() + offset, block.levels[0].pixels, unitBytes);
+    }
+    unsigned char* out = mips.storage.data();
+    for(ImageLevel& level : mips.levels)
+    {
+        level.pixels = out;
+        out += textureFormatSize(format, level.width, level.height);
+    }
+    return mips;
+}
+
+/* chain of a texture array layer from an RGBA8 image of any size: single colored images are repeated, all others are
+ * scaled to the array size with nearest sampling and compressed to the array format */
+ImageMips textureArrayConvertLayer(const ImageLevel& image, unsigned int width, unsigned int height, eTextureFormat format)
+{
+    const std::size_t texels = std::size_t(image.width) * image.height;
+    bool constant = true;
+    for(std::size_t p = 1; constant && p < texels; p++)
+    {
+        constant = std::memcmp(image.pixels + p * 4, image.pixels, 4) == 0;
+    }
+    if(constant)
+    {
+        return textureArrayConstantLayer(image.pixels, width, height, format);
+    }
+
+    auto buffer = std::make_shared<std::vector<unsigned char>>(std::size_t(width) * height * 4);
+    for(unsigned int y = 0; y < height; y++)
+    {
+        for(unsigned int x = 0; x < width; x++)
+        {
+            std::size_t sx = std::size_t(x) * image.width / width, sy = std::size_t(y) * image.height / height;
+            std::memcpy(buffer->data() + (std::size_t(y) * width + x) * 4, image.pixels + (sy * image.width + sx) * 4, 4);
+        }
+    }
+    return imageCompress(imageMipChain(ImageData{width, height, std::shared_ptr<const unsigned char>(buffer, buffer->data())}), format);
+}
+
+/* specifies levels [skip, end) of the layer chains as levels of the bound texture array and returns their VRAM. Like
+ * textureUploadLevels only the levels from first on get their data. */
+std::size_t textureArrayUploadLevels(const std::vector<std::shared_ptr<ImageMips>>& layers, eTextureFormat format, unsigned int skip, unsigned int first)
+{
+    const std::vector<ImageLevel>& levels = layers[0]->levels;
+    const GLsizei depth = (GLsizei) layers.size();
+    std::size_t bytes = 0;
+    for(std::size_t level = skip; level < levels.size(); level++)
+    {
+        GLint target = (GLint) (level - skip);
+        std::size_t size = textureFormatSize(format, levels[level].width, levels[level].height);
+        if(format == TEXTURE_FORMAT_RGBA8)
+        {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, target, GL_RGBA8, levels[level].width, levels[level].height, depth, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        else
+        {
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, target, textureInternalFormat(format), levels[level].width, levels[level].height, depth, 0,
+                                   (GLsizei) (size * layers.size()), nullptr);
+        }
+        bytes += size * layers.size();
+
+        for(std::size_t layer = 0; level >= first && layer < layers.size(); layer++)
+        {
+            const unsigned char* pixels = layers[layer]->levels[level].pixels;
+            if(format == TEXTURE_FORMAT_RGBA8)
+            {
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, target, 0, 0, (GLint) layer, levels[level].width, levels[level].height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            }
+            else
+            {
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, target, 0, 0, (GLint) layer, levels[level].width, levels[level].height, 1,
+                                          textureInternalFormat(format), (GLsizei) size, pixels);
+            }
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, (GLint) (first - skip));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint) (levels.size() - skip) - 1);
+    glCheckError();
+    return bytes;
+}
+
+}
+
+ImageData imageLoad(const std::string &path, bool flipVertically)
 {
     int width = 0, height = 0, components = 0;
 
-    /* flip image to match opengl's texture coordinates */
-    stbi_set_flip_vertically_on_load(true);
+    /* flip image to match opengl's texture coordinates (per thread, images may be decoded concurrently) */
+    stbi_set_flip_vertically_on_load_thread(flipVertically);
 
     /* load image (required components=4 -> always RGBA returned)*/
     unsigned char* data = stbi_load(path.c_str(), &width, &height, &components, 4);
@@ -22,11 +564,33 @@ Texture textureLoad(const std::string &path)
         throw std::runtime_error("[Texture] couldn't load image file " + path);
     }
 
+    return ImageData{(unsigned int) width, (unsigned int) height, std::shared_ptr<const unsigned char>(data, stbi_image_free)};
+}
+
+ImageData imageLoad(const unsigned char* data, std::size_t size, bool flipVertically)
+{
+    int width = 0, height = 0, components = 0;
+
+    stbi_set_flip_vertically_on_load_thread(flipVertically);
+
+    unsigned char* pixels = stbi_load_from_memory(data, (int) size, &width, &height, &components, 4);
+    if(pixels == nullptr)
+    {
+        std::cerr << "[Texture] couldn't decode embedded image: " << stbi_failure_reason() << std::endl;
+        std::cerr.flush();
+        throw std::runtime_error("[Texture] couldn't decode embedded image");
+    }
+
+    return ImageData{(unsigned int) width, (unsigned int) height, std::shared_ptr<const unsigned char>(pixels, stbi_image_free)};
+}
+
+Texture textureCreate(const ImageData &image)
+{
     /* upload data */
     GLuint id = 0;
     glGenTextures(1, &id);
     glBindTexture(GL_TEXTURE_2D, id);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.get());
     glGenerateMipmap(GL_TEXTURE_2D);
     glCheckError();
 
@@ -36,22 +600,439 @@ Texture textureLoad(const std::string &path)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glCheckError();
 
-    stbi_image_free(data);
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    return Texture{id, (unsigned int) width, (unsigned int) height};
+    Texture texture{id, image.width, image.height};
+    detail::textureRegister(texture, "", detail::textureBytes(image.width, image.height, true));
+    return texture;
+}
+
+Texture textureCreate(const std::vector<ImageLevel>& levels, eTextureFormat format)
+{
+    return detail::textureCreateLevels(levels, format, 0, 0);
+}
+
+bool textureCompressionSupported()
+{
+    return GLAD_GL_EXT_texture_compression_s3tc != 0;
+}
+
+GLenum textureInternalFormat(eTextureFormat format)
+{
+    const GLenum formats[] = {GL_RGBA8, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_COMPRESSED_RED_RGTC1, GL_COMPRESSED_RG_RGTC2};
+    return formats[format];
+}
+
+Texture textureLoad(const std::string &path, eTextureUsage usage, bool flipVertically, int priority)
+{
+    usage = detail::textureUsage(usage);
+    std::string key = detail::textureKey(path, usage, flipVertically);
+    Texture texture = detail::textureFind(key);
+    if(texture.id != 0)
+    {
+        detail::textureRaisePriority(texture, priority);
+        return texture;
+    }
+
+    ImageMips mips = imageLoadMips(path, usage, flipVertically);
+    unsigned int skip = textureBudgetFit(detail::textureLevelBytes(mips), mips.levels[0].width, mips.levels[0].height, priority);
+    return detail::textureCreateFromFile(std::move(mips), skip, key, path, usage, flipVertically, priority);
+}
+
+std::vector<Texture> textureLoadBatch(const std::vector<TextureRequest>& requests, bool flipVertically)
+{
+    /* cache hits are only referenced, every other file is decoded once even if it is listed several times */
+    std::vector<Texture> textures(requests.size());
+    std::vector<std::string> keys(requests.size());
+    std::vector<eTextureUsage> usage(requests.size());
+    std::vector<int> priority(requests.size());
+    std::vector<std::size_t> decodes;
+    std::unordered_map<std::string, std::size_t> pending;
+    for(std::size_t i = 0; i < requests.size(); i++)
+    {
+        usage[i] = detail::textureUsage(requests[i].usage);
+        keys[i] = detail::textureKey(requests[i].path, usage[i], flipVertically);
+        priority[i] = requests[i].priority;
+        textures[i] = detail::textureFind(keys[i]);
+        if(textures[i].id != 0)
+        {
+            detail::textureRaisePriority(textures[i], priority[i]);
+            continue;
+        }
+
+        auto [first, inserted] = pending.emplace(keys[i], i);
+        if(inserted)
+        {
+            decodes.push_back(i);
+        }
+        priority[first->second] = std::max(priority[first->second], priority[i]);
+    }
+
+    /* workers decode (and compress), this thread uploads in list order as soon as the next image is ready */
+    std::vector<std::future<ImageMips>> images;
+    images.reserve(decodes.size());
+    for(std::size_t i : decodes)
+    {
+        images.push_back(threadPoolAsync([path = requests[i].path, usage = usage[i], flipVertically]() { return imageLoadMips(path, usage, flipVertically); }));
+    }
+
+    auto upload = [&](std::size_t i, ImageMips&& mips, unsigned int skip) {
+        textures[i] = detail::textureCreateFromFile(std::move(mips), skip, keys[i], requests[i].path, usage[i], flipVertically, priority[i]);
+    };
+
+    /* with a budget the levels to leave out are planned for all images together, so they have to be decoded first */
+    const bool budget = textureBudget() != 0;
+    std::vector<ImageMips> decoded(budget ? decodes.size() : 0);
+    std::exception_ptr error;
+    for(std::size_t d = 0; d < decodes.size(); d++)
+    {
+        try
+        {
+            ImageMips mips = images[d].get();
+            if(error)
+            {
+                continue;
+            }
+
+            if(budget)
+            {
+                decoded[d] = std::move(mips);
+            }
+            else
+            {
+                upload(decodes[d], std::move(mips), 0);
+            }
+        }
+        catch(...)
+        {
+            /* the remaining decodes still have to finish before the batch is unwound */
+            if(!error)
+            {
+                error = std::current_exception();
+            }
+        }
+    }
+
+    if(budget && !error)
+    {
+        std::vector<std::vector<std::size_t>> levelBytes(decodes.size());
+        std::vector<detail::BudgetCandidate> incoming(decodes.size());
+        for(std::size_t d = 0; d < decodes.size(); d++)
+        {
+            const ImageLevel& base = decoded[d].levels[0];
+            levelBytes[d] = detail::textureLevelBytes(decoded[d]);
+            incoming[d] = detail::BudgetCandidate{0, priority[decodes[d]], &levelBytes[d], 0, detail::textureMaxSkip(base.width, base.height, levelBytes[d].size())};
+        }
+        detail::textureBudgetPlan(incoming);
+
+        for(std::size_t d = 0; d < decodes.size(); d++)
+        {
+            upload(decodes[d], std::move(decoded[d]), incoming[d].skipped);
+        }
+    }
+
+    if(error)
+    {
+        for(const Texture& texture : textures)
+        {
+            textureDelete(texture);
+        }
+        std::rethrow_exception(error);
+    }
+
+    /* files listed more than once */
+    for(std::size_t i = 0; i < requests.size(); i++)
+    {
+        if(textures[i].id == 0)
+        {
+            textures[i] = detail::textureFind(keys[i]);
+        }
+    }
+    return textures;
+}
+
+Texture texturePack(const std::vector<Texture>& sources, std::vector<bool>& packed)
+{
+    if(sources.size() > 4)
+    {
+        throw std::runtime_error("[Texture] at most four textures can be packed into one");
+    }
+    packed.assign(sources.size(), false);
+
+    /* only textures loaded from file can be packed, their files are read again (from the disk cache if possible) */
+    detail::TextureCache& cache = detail::textureCache();
+    std::vector<const detail::TextureEntry*> entries(sources.size(), nullptr);
+    std::string key = "pack:";
+    for(std::size_t i = 0; i < sources.size(); i++)
+    {
+        auto it = cache.entries.find(sources[i].id);
+        if(it != cache.entries.end() && !it->second.path.empty())
+        {
+            entries[i] = &it->second;
+            key += it->second.key;
+        }
+        key += ";";
+    }
+
+    Texture texture = detail::textureFind(key);
+    if(texture.id != 0)
+    {
+        for(std::size_t i = 0; i < sources.size(); i++)
+        {
+            packed[i] = (cache.entries[texture.id].packedChannels >> i) & 1u;
+        }
+        return texture;
+    }
+
+    std::vector<ImageMips> images(sources.size());
+    parallelFor(sources.size(), [&](std::size_t i) {
+        if(entries[i] != nullptr)
+        {
+            images[i] = imageLoadMips(entries[i]->path, TEXTURE_USAGE_DATA, entries[i]->flipVertically);
+        }
+    });
+
+    /* a map is scalar if its color channels agree, small differences are compression noise */
+    const int SCALAR_TOLERANCE = 8;
+    unsigned int width = 0, height = 0, channels = 0;
+    for(std::size_t i = 0; i < sources.size(); i++)
+    {
+        if(images[i].levels.empty())
+        {
+            continue;
+        }
+
+        const ImageLevel& level = images[i].levels[0];
+        bool scalar = true;
+        for(std::size_t p = 0; scalar && p < std::size_t(level.width) * level.height; p++)
+        {
+            const unsigned char* rgb = level.pixels + p * 4;
+            scalar = std::abs(rgb[0] - rgb[1]) <= SCALAR_TOLERANCE && std::abs(rgb[1] - rgb[2]) <= SCALAR_TOLERANCE;
+        }
+        if(scalar)
+        {
+            packed[i] = true;
+            channels |= 1u << i;
+            width = std::max(width, level.width);
+            height = std::max(height, level.height);
+        }
+    }
+    if(channels == 0)
+    {
+        return Texture{};
+    }
+
+    /* smaller maps (e.g. 8x8 constant ones) are scaled up to the largest one with nearest sampling */
+    auto buffer = std::make_shared<std::vector<unsigned char>>(std::size_t(width) * height * 4, 0);
+    for(unsigned int y = 0; y < height; y++)
+    {
+        for(unsigned int x = 0; x < width; x++)
+        {
+            unsigned char* out = buffer->data() + (std::size_t(y) * width + x) * 4;
+            out[3] = 255;
+            for(std::size_t i = 0; i < sources.size(); i++)
+            {
+                if(packed[i])
+                {
+                    const ImageLevel& level = images[i].levels[0];
+                    std::size_t sx = std::size_t(x) * level.width / width, sy = std::size_t(y) * level.height / height;
+                    out[i] = level.pixels[(sy * level.width + sx) * 4];
+                }
+            }
+        }
+    }
+
+    ImageMips mips = imageMipChain(ImageData{width, height, std::shared_ptr<const unsigned char>(buffer, buffer->data())});
+    texture = textureCreate(mips.levels);
+    detail::TextureEntry& entry = cache.entries[texture.id];
+    entry.key = key;
+    entry.packedChannels = channels;
+    cache.textures[key] = texture;
+    return texture;
+}
+
+std::vector<Texture> textureArrayCreate(const std::vector<Texture>& textures)
+{
+    detail::TextureCache& cache = detail::textureCache();
+    if(textures.empty())
+    {
+        return {};
+    }
+
+    /* one layer per distinct texture, missing ones (id 0) share one black layer */
+    std::vector<GLuint> sources;
+    std::vector<unsigned int> layerOf(textures.size());
+    for(std::size_t i = 0; i < textures.size(); i++)
+    {
+        auto it = std::find(sources.begin(), sources.end(), textures[i].id);
+        layerOf[i] = static_cast<unsigned int>(it - sources.begin());
+        if(it == sources.end())
+        {
+            sources.push_back(textures[i].id);
+        }
+    }
+
+    std::vector<const detail::TextureEntry*> entries(sources.size(), nullptr);
+    const detail::TextureEntry* largest = nullptr;
+    for(std::size_t l = 0; l < sources.size(); l++)
+    {
+        auto it = cache.entries.find(sources[l]);
+        if(it == cache.entries.end())
+        {
+            continue;
+        }
+
+        /* textures loaded from file decide the size before any other */
+        entries[l] = &it->second;
+        const detail::TextureEntry& entry = it->second;
+        if(largest == nullptr || (largest->path.empty() && !entry.path.empty())
+           || (largest->path.empty() == entry.path.empty() && std::size_t(entry.width) * entry.height > std::size_t(largest->width) * largest->height))
+        {
+            largest = &entry;
+        }
+    }
+    const unsigned int width = largest != nullptr ? largest->width : 1;
+    const unsigned int height = largest != nullptr ? largest->height : 1;
+    const eTextureFormat format = largest != nullptr ? largest->format : TEXTURE_FORMAT_RGBA8;
+
+    /* textures that don't come from a file are read back as RGBA8 (which decodes BCn), on this thread */
+    std::vector<std::vector<unsigned char>> readback(sources.size());
+    for(std::size_t l = 0; l < sources.size(); l++)
+    {
+        if(entries[l] != nullptr && entries[l]->path.empty())
+        {
+            readback[l].resize(std::size_t(entries[l]->width) * entries[l]->height * 4);
+            glBindTexture(GL_TEXTURE_2D, sources[l]);
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, readback[l].data());
+            glBindTexture(GL_TEXTURE_2D, 0);
+            glCheckError();
+        }
+    }
+
+    /* the chains of all layers, files that match the array are taken as they are (from the disk cache if possible) */
+    std::vector<std::shared_ptr<ImageMips>> layers(sources.size());
+    std::vector<bool> copied(sources.size(), false);
+    parallelFor(sources.size(), [&](std::size_t l) {
+        const detail::TextureEntry* entry = entries[l];
+        if(entry == nullptr)
+        {
+            const unsigned char black[4] = {0, 0, 0, 255};
+            layers[l] = std::make_shared<ImageMips>(detail::textureArrayConstantLayer(black, width, height, format));
+            return;
+        }
+        if(entry->path.empty())
+        {
+            ImageLevel image{entry->width, entry->height, readback[l].data()};
+            layers[l] = std::make_shared<ImageMips>(detail::textureArrayConvertLayer(image, width, height, format));
+            return;
+        }
+
+        if(entry->width == width && entry->height == height && entry->format == format)
+        {
+            ImageMips mips = imageLoadMips(entry->path, entry->usage, entry->flipVertically);
+            if(mips.format == format && mips.levels.size() == entry->levelBytes.size())
+            {
+                layers[l] = std::make_shared<ImageMips>(std::move(mips));
+                copied[l] = true;
+                return;
+            }
+        }
+        ImageMips rgba = imageLoadMips(entry->path, TEXTURE_USAGE_DATA, entry->flipVertically);
+        layers[l] = std::make_shared<ImageMips>(detail::textureArrayConvertLayer(rgba.levels[0], width, height, format));
+    });
+
+    /* as sharp as the sharpest texture that was taken as it is under the budget, as important as the most important one */
+    unsigned int skip = 0;
+    bool skipSet = false;
+    int priority = TEXTURE_PRIORITY_DETAIL;
+    for(std::size_t l = 0; l < sources.size(); l++)
+    {
+        if(entries[l] != nullptr)
+        {
+            priority = std::max(priority, entries[l]->priority);
+        }
+        if(copied[l])
+        {
+            skip = skipSet ? std::min(skip, entries[l]->skipped) : entries[l]->skipped;
+            skipSet = true;
+        }
+    }
+    std::string name = largest != nullptr && !largest->name.empty() ? largest->name : "texture array";
+
+    const std::vector<ImageLevel>& levels = layers[0]->levels;
+    unsigned int first = cache.streamBudget != 0 ? detail::textureStreamFirst(levels, skip) : skip;
+    GLuint id = 0;
+    glGenTextures(1, &id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+    std::size_t bytes = detail::textureArrayUploadLevels(layers, format, skip, first);
+    if(format == TEXTURE_FORMAT_BC4)
+    {
+        const GLint swizzle[] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+        glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glCheckError();
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    /* bookkeeping like a tracked texture: counts against the budget, but its levels are never dropped later on */
+    Texture array{id, width, height};
+    detail::textureRegister(array, "", bytes);
+    detail::TextureEntry& entry = cache.entries[id];
+    entry.references = static_cast<unsigned int>(textures.size());
+    entry.format = format;
+    entry.name = name + " (array of " + std::to_string(sources.size()) + ")";
+    entry.priority = priority;
+    entry.levelBytes.resize(levels.size());
+    for(std::size_t level = 0; level < levels.size(); level++)
+    {
+        entry.levelBytes[level] = textureFormatSize(format, levels[level].width, levels[level].height) * sources.size();
+    }
+    entry.skipped = skip;
+    cache.stats.arrays++;
+    cache.stats.arrayLayers += static_cast<unsigned int>(sources.size());
+
+    for(unsigned int layer = 0; first > skip && layer < layers.size(); layer++)
+    {
+        cache.streams.push_back(detail::TextureStream{id, priority, skip, first - 1, 0, layers[layer], GL_TEXTURE_2D_ARRAY, layer});
+    }
+
+    std::vector<Texture> handles(textures.size());
+    for(std::size_t i = 0; i < textures.size(); i++)
+    {
+        handles[i] = Texture{id, width, height, layerOf[i]};
+    }
+    return handles;
 }
 
 Texture textureCreateSingleColor(unsigned int width, unsigned int height, const Vector3D& color)
 {
+    const unsigned char rgba[4] = {
+        static_cast<unsigned char>(color.x * 255),
+        static_cast<unsigned char>(color.y * 255),
+        static_cast<unsigned char>(color.z * 255),
+        255
+    };
+
+    /* default textures (e.g. black 1x1 emission) are shared by everyone asking for the same size and color */
+    std::string key = "color:" + std::to_string(width) + "x" + std::to_string(height) + ":" + std::to_string(rgba[0]) + ","
+                    + std::to_string(rgba[1]) + "," + std::to_string(rgba[2]);
+    Texture texture = detail::textureFind(key);
+    if(texture.id != 0)
+    {
+        return texture;
+    }
+
     // create texture with size widht height and color
     std::vector<unsigned char> data(width * height * 4);
     for(unsigned int i = 0; i < width * height; i++)
     {
-        data[i * 4 + 0] = static_cast<unsigned char>(color.x * 255);
-        data[i * 4 + 1] = static_cast<unsigned char>(color.y * 255);
-        data[i * 4 + 2] = static_cast<unsigned char>(color.z * 255);
-        data[i * 4 + 3] = 255;
+        data[i * 4 + 0] = rgba[0];
+        data[i * 4 + 1] = rgba[1];
+        data[i * 4 + 2] = rgba[2];
+        data[i * 4 + 3] = rgba[3];
     }
 
     /* upload data */
@@ -69,10 +1050,262 @@ Texture textureCreateSingleColor(unsigned int width, unsigned int height, const
 
     glBindTexture(GL_TEXTURE_2D, 0);
 
-    return Texture{id, (unsigned int) width, (unsigned int) height};
+    texture = Texture{id, (unsigned int) width, (unsigned int) height};
+    detail::textureRegister(texture, key, detail::textureBytes(width, height, false));
+    return texture;
+}
+
+void textureReplace(Texture& texture, const std::string& path, eTextureUsage usage, int priority)
+{
+    /* load first, so a texture replaced by itself never drops to zero references in between */
+    Texture loaded = textureLoad(path, usage, true, priority);
+    textureDelete(texture);
+    texture = loaded;
+}
+
+void textureRetain(const Texture& texture)
+{
+    detail::TextureCache& cache = detail::textureCache();
+    auto it = cache.entries.find(texture.id);
+    if(it != cache.entries.end())
+    {
+        it->second.references++;
+    }
 }
 
 void textureDelete(const Texture &texture)
 {
+    detail::TextureCache& cache = detail::textureCache();
+    auto it = cache.entries.find(texture.id);
+    if(it == cache.entries.end() || --it->second.references > 0)
+    {
+        return;
+    }
+
+    if(!it->second.key.empty())
+    {
+        cache.textures.erase(it->second.key);
+    }
+    cache.stats.residentBytes -= it->second.bytes;
+    cache.entries.erase(it);
+    detail::textureStreamCancel(texture.id);
     glDeleteTextures(1, &texture.id);
 }
+
+TextureCacheStats textureCacheStats()
+{
+    return detail::textureCache().stats;
+}
+
+std::size_t textureBudget()
+{
+    return detail::textureCache().budget;
+}
+
+void textureSetBudget(std::size_t bytes)
+{
+    detail::TextureCache& cache = detail::textureCache();
+    cache.budget = bytes;
+    cache.budgetExceeded = false;
+}
+
+unsigned int textureBudgetFit(const std::vector<std::size_t>& levelBytes, unsigned int width, unsigned int height, int priority)
+{
+    std::vector<detail::BudgetCandidate> incoming = {
+        detail::BudgetCandidate{0, priority, &levelBytes, 0, detail::textureMaxSkip(width, height, levelBytes.size())}
+    };
+    detail::textureBudgetPlan(incoming);
+    return incoming[0].skipped;
+}
+
+void textureTrack(const Texture& texture, const std::string& name, const std::vector<std::size_t>& levelBytes, unsigned int skipped, int priority)
+{
+    std::size_t bytes = 0;
+    for(std::size_t level = skipped; level < levelBytes.size(); level++)
+    {
+        bytes += levelBytes[level];
+    }
+    detail::textureRegister(texture, "", bytes);
+
+    detail::TextureCache& cache = detail::textureCache();
+    detail::TextureEntry& entry = cache.entries[texture.id];
+    entry.name = name;
+    entry.priority = priority;
+    entry.width = texture.width;
+    entry.height = texture.height;
+    entry.levelBytes = levelBytes;
+    entry.skipped = skipped;
+    cache.stats.droppedLevels += skipped;
+}
+
+std::vector<TextureResidency> textureResidency()
+{
+    std::vector<TextureResidency> residency;
+    for(const auto& [id, entry] : detail::textureCache().entries)
+    {
+        if(entry.levelBytes.empty())
+        {
+            continue;
+        }
+
+        residency.push_back(TextureResidency{entry.name, entry.priority, entry.width, entry.height,
+                                             std::max(entry.width >> entry.skipped, 1u), std::max(entry.height >> entry.skipped, 1u), entry.bytes});
+    }
+
+    std::sort(residency.begin(), residency.end(), [](const TextureResidency& a, const TextureResidency& b) {
+        return a.priority != b.priority ? a.priority > b.priority : a.name < b.name;
+    });
+    return residency;
+}
+
+std::size_t textureStreamBudget()
+{
+    return detail::textureCache().streamBudget;
+}
+
+void textureSetStreamBudget(std::size_t bytes)
+{
+    detail::textureCache().streamBudget = bytes;
+}
+
+std::size_t textureStreamPending()
+{
+    return detail::textureCache().streams.size();
+}
+
+std::size_t textureStreamUpdate()
+{
+    detail::TextureCache& cache = detail::textureCache();
+    if(cache.streams.empty())
+    {
+        return 0;
+    }
+
+    /* one piece of a level, copied into the pixel buffer at offset (the chain stays alive until then) */
+    struct Upload
+    {
+        std::shared_ptr<ImageMips> mips;
+        GLuint id;
+        GLenum target;
+        unsigned int layer;
+        eTextureFormat format;
+        GLint level;
+        unsigned int width;
+        unsigned int y;
+        unsigned int rows;
+        const unsigned char* pixels;
+        std::size_t offset;
+        std::size_t bytes;
+        bool complete;
+    };
+
+    /* smallest missing level first (the more important texture on ties), so every texture sharpens step by step. At
+     * least one row is uploaded per call even if it doesn't fit into the budget. */
+    const std::size_t budget = cache.streamBudget != 0 ? cache.streamBudget : detail::TEXTURE_STREAM_DEFAULT_BUDGET;
+    std::vector<Upload> uploads;
+    std::size_t total = 0;
+    while(!cache.streams.empty())
+    {
+        auto next = std::min_element(cache.streams.begin(), cache.streams.end(), [](const detail::TextureStream& a, const detail::TextureStream& b) {
+            const ImageLevel& levelA = a.mips->levels[a.level];
+            const ImageLevel& levelB = b.mips->levels[b.level];
+            std::size_t sizeA = std::size_t(levelA.width) * levelA.height, sizeB = std::size_t(levelB.width) * levelB.height;
+            return sizeA != sizeB ? sizeA < sizeB : a.priority > b.priority;
+        });
+
+        /* BCn levels go in rows of 4x4 blocks, the last one may be shorter at the edge of the level */
+        detail::TextureStream& stream = *next;
+        const ImageLevel& level = stream.mips->levels[stream.level];
+        const eTextureFormat format = stream.mips->format;
+        const unsigned int unit = format == TEXTURE_FORMAT_RGBA8 ? 1 : 4;
+        const std::size_t unitBytes = textureFormatSize(format, level.width, unit);
+        std::size_t units = total < budget ? (budget - total) / unitBytes : 0;
+        if(units == 0 && !uploads.empty())
+        {
+            break;
+        }
+
+        unsigned int rows = static_cast<unsigned int>(std::min<std::size_t>(level.height - stream.rows, std::max<std::size_t>(units, 1) * unit));
+        std::size_t offset = textureFormatSize(format, level.width, stream.rows);
+        std::size_t bytes = textureFormatSize(format, level.width, stream.rows + rows) - offset;
+        stream.rows += rows;
+
+        /* a level of a texture array is complete once the last of its layers has it */
+        bool complete = stream.rows == level.height
+                     && std::none_of(cache.streams.begin(), cache.streams.end(), [&stream](const detail::TextureStream& other) {
+                            return &other != &stream && other.id == stream.id && other.level >= stream.level;
+                        });
+        uploads.push_back(Upload{stream.mips, stream.id, stream.target, stream.layer, format, (GLint) (stream.level - stream.skip), level.width, stream.rows - rows, rows,
+                                 level.pixels + offset, total, bytes, complete});
+        total += bytes;
+
+        if(stream.rows == level.height)
+        {
+            stream.rows = 0;
+            if(stream.level == stream.skip)
+            {
+                cache.streams.erase(next);
+            }
+            else
+            {
+                stream.level--;
+            }
+        }
+    }
+
+    /* orphaning the buffer every call lets the driver hand out fresh memory instead of waiting for the last uploads */
+    if(cache.streamBuffer == 0)
+    {
+        glGenBuffers(1, &cache.streamBuffer);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, cache.streamBuffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr) total, nullptr, GL_STREAM_DRAW);
+    auto* mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr) total, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if(mapped == nullptr)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        throw std::runtime_error("[Texture] couldn't map the texture streaming buffer");
+    }
+    for(const Upload& upload : uploads)
+    {
+        std::memcpy(mapped + upload.offset, upload.pixels, upload.bytes);
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    /* a level is only sampled once it is complete, by moving the base level down to it */
+    for(const Upload& upload : uploads)
+    {
+        glBindTexture(upload.target, upload.id);
+        const void* source = reinterpret_cast<const void*>(upload.offset);
+        if(upload.target == GL_TEXTURE_2D_ARRAY && upload.format == TEXTURE_FORMAT_RGBA8)
+        {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, upload.level, 0, (GLint) upload.y, (GLint) upload.layer, (GLsizei) upload.width, (GLsizei) upload.rows, 1,
+                            GL_RGBA, GL_UNSIGNED_BYTE, source);
+        }
+        else if(upload.target == GL_TEXTURE_2D_ARRAY)
+        {
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, upload.level, 0, (GLint) upload.y, (GLint) upload.layer, (GLsizei) upload.width, (GLsizei) upload.rows, 1,
+                                      textureInternalFormat(upload.format), (GLsizei) upload.bytes, source);
+        }
+        else if(upload.format == TEXTURE_FORMAT_RGBA8)
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, (GLint) upload.y, (GLsizei) upload.width, (GLsizei) upload.rows, GL_RGBA, GL_UNSIGNED_BYTE, source);
+        }
+        else
+        {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, (GLint) upload.y, (GLsizei) upload.width, (GLsizei) upload.rows,
+                                      textureInternalFormat(upload.format), (GLsizei) upload.bytes, source);
+        }
+        if(upload.complete)
+        {
+            glTexParameteri(upload.target, GL_TEXTURE_BASE_LEVEL, upload.level);
+        }
+        glBindTexture(upload.target, 0);
+    }
+    glCheckError();
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    cache.stats.streamedBytes += total;
+    return total;
+}
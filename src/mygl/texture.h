@@ -2,28 +2,351 @@
 
 #include "base.h"
 
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
 struct Texture
 {
     GLuint id = 0;
 
     unsigned int width = 0;
     unsigned int height = 0;
+
+    /* layer of a texture array (GL_TEXTURE_2D_ARRAY, see textureArrayCreate), 0 for 2D textures */
+    unsigned int layer = 0;
+};
+
+/* decoded image in CPU memory, always RGBA with 8 bit per channel */
+struct ImageData
+{
+    unsigned int width = 0;
+    unsigned int height = 0;
+
+    std::shared_ptr<const unsigned char> pixels;
+};
+
+/* GPU storage format of a texture: uncompressed or one of the BCn block formats (4x4 texel blocks) */
+enum eTextureFormat
+{
+    TEXTURE_FORMAT_RGBA8 = 0,
+    TEXTURE_FORMAT_BC1,         // RGB, 8 bytes per block (DXT1)
+    TEXTURE_FORMAT_BC3,         // RGBA, 16 bytes per block (DXT5)
+    TEXTURE_FORMAT_BC4,         // R, 8 bytes per block (RGTC1), sampled as grey
+    TEXTURE_FORMAT_BC5          // RG, 16 bytes per block (RGTC2)
+};
+
+/* what a texture holds, decides the block format textureLoad compresses it to */
+enum eTextureUsage
+{
+    TEXTURE_USAGE_DATA = 0,     // kept as RGBA8 (displacement, lookup data, ...)
+    TEXTURE_USAGE_COLOR,        // albedo, emission, specular color: BC1, or BC3 if it has alpha
+    TEXTURE_USAGE_SCALAR,       // grey maps like AO or gloss: BC4
+    TEXTURE_USAGE_NORMAL        // unit normal maps: BC5, only x and y are kept (blue samples as 0), so the caller's
+                                // shader has to rebuild z = sqrt(1 - dot(xy, xy)); color.frag and flag.frag don't
+};
+
+/* importance of a texture by material role when the texture budget forces mip levels to be dropped, the least
+ * important textures lose their top levels first. The object that owns a texture can add its own priority on top. */
+enum eTexturePriority
+{
+    TEXTURE_PRIORITY_DETAIL = 0,    // AO, gloss and other maps that only add detail
+    TEXTURE_PRIORITY_SURFACE = 1,   // emission and specular color
+    TEXTURE_PRIORITY_PRIMARY = 2    // albedo and normal maps, and every texture loaded without a priority
+};
+
+/* texture file to load with textureLoadBatch */
+struct TextureRequest
+{
+    std::string path;
+    eTextureUsage usage = TEXTURE_USAGE_DATA;
+    int priority = TEXTURE_PRIORITY_PRIMARY;
+};
+
+/* effective resolution of a texture under the texture budget */
+struct TextureResidency
+{
+    std::string name;
+    int priority = TEXTURE_PRIORITY_PRIMARY;
+
+    unsigned int width = 0;         // size of the full level 0
+    unsigned int height = 0;
+    unsigned int loadedWidth = 0;   // size of the largest level that is on the GPU
+    unsigned int loadedHeight = 0;
+    std::size_t bytes = 0;          // VRAM of the loaded levels
+};
+
+/* one level of a mip chain, RGBA with 8 bit per channel tightly packed, or BCn blocks row by row */
+struct ImageLevel
+{
+    unsigned int width = 0;
+    unsigned int height = 0;
+
+    const unsigned char* pixels = nullptr;
 };
 
 /**
- * @brief Initialize OpenGL texture and load it from file.
+ * @brief Decodes an image file into CPU memory without touching OpenGL.
  *
- * @param path Path to texture file.
+ * @param path Path to image file.
+ * @param flipVertically Flip the image to match OpenGL's texture coordinates.
+ *
+ * @return Decoded image.
+ */
+ImageData imageLoad(const std::string& path, bool flipVertically = true);
+
+/**
+ * @brief Decodes an encoded image (PNG, JPEG, ...) that is already in memory, e.g. embedded in a GLB file.
+ *
+ * @param data Encoded image bytes.
+ * @param size Number of bytes.
+ * @param flipVertically Flip the image to match OpenGL's texture coordinates.
+ *
+ * @return Decoded image.
+ */
+ImageData imageLoad(const unsigned char* data, std::size_t size, bool flipVertically = true);
+
+/* counters of the texture cache since program start */
+struct TextureCacheStats
+{
+    unsigned int decodes = 0;       // images decoded and uploaded by textureLoad
+    unsigned int diskLoads = 0;     // images uploaded from the texture disk cache instead
+    unsigned int compressed = 0;    // of these, images stored in a BCn format
+    unsigned int hits = 0;          // textureLoad/textureCreateSingleColor calls answered with a shared texture
+    std::size_t uploadBytes = 0;    // texel bytes uploaded, mip levels included
+    std::size_t savedBytes = 0;     // VRAM the hits would have taken as separate textures
+    std::size_t residentBytes = 0;  // VRAM of all live textures right now
+    unsigned int droppedLevels = 0; // top mip levels left out (or released again) to stay within the texture budget
+    std::size_t streamedBytes = 0;  // texel bytes uploaded by textureStreamUpdate
+    unsigned int arrays = 0;        // texture arrays created by textureArrayCreate
+    unsigned int arrayLayers = 0;   // layers of these arrays
+};
+
+/**
+ * @brief Initialize OpenGL texture from a decoded image and generate its mipmaps. The texture is not shared, but it
+ * is reference counted like cached ones (see textureRetain).
+ *
+ * @param image Decoded image.
+ *
+ * @return Initialized texture object.
+ */
+Texture textureCreate(const ImageData& image);
+
+/**
+ * @brief Initialize OpenGL texture from a complete mip chain (e.g. from the texture disk cache, see imageLoadMips),
+ * every level is uploaded as it is instead of generating the mipmaps on the GPU. Reference counted like textureCreate.
+ *
+ * @param levels Mip levels, level 0 first, down to 1x1.
+ * @param format Format of the levels.
  *
  * @return Initialized texture object.
  */
-Texture textureLoad(const std::string& path);
+Texture textureCreate(const std::vector<ImageLevel>& levels, eTextureFormat format = TEXTURE_FORMAT_RGBA8);
 
+/**
+ * @brief Whether textureLoad compresses textures. Needs GL_EXT_texture_compression_s3tc for BC1/BC3, without it all
+ * textures are kept as RGBA8.
+ *
+ * @return True if the extension is available.
+ */
+bool textureCompressionSupported();
+
+/**
+ * @brief OpenGL internal format of a texture format, e.g. for uploading levels of a texture kind textureCreate
+ * doesn't cover (cube maps).
+ *
+ * @param format Texture format.
+ *
+ * @return Internal format for glTexImage2D/glCompressedTexImage2D.
+ */
+GLenum textureInternalFormat(eTextureFormat format);
+
+/**
+ * @brief Loads a texture from file (imageLoadMips followed by textureCreate) through the texture cache: loading the
+ * same file (by canonical path) with the same parameters again returns the texture that is already on the GPU and only
+ * adds a reference to it. The decoded image and its mip chain come from the texture disk cache if it is up to date.
+ * Depending on the usage the levels are compressed to a BCn format on the CPU (and cached on disk like that). If the
+ * texture doesn't fit into the texture budget (see textureSetBudget), the top levels of the least important textures
+ * (this one included) are left out. A shared texture keeps the highest priority any of its users asked for. With
+ * streaming on (see textureSetStreamBudget) only the levels up to 64 texels are uploaded right away, the texture is
+ * usable at once and textureStreamUpdate brings in the larger levels.
+ *
+ * @param path Path to texture file.
+ * @param usage What the texture holds, see eTextureUsage.
+ * @param flipVertically Flip the image to match OpenGL's texture coordinates.
+ * @param priority Importance for the texture budget, see eTexturePriority.
+ *
+ * @return Initialized texture object, shared with other users of the same file.
+ */
+Texture textureLoad(const std::string& path, eTextureUsage usage = TEXTURE_USAGE_DATA, bool flipVertically = true, int priority = TEXTURE_PRIORITY_PRIMARY);
+
+/**
+ * @brief Loads a list of texture files like textureLoad, but decodes all files that are not cached yet concurrently
+ * on the shared worker pool. The calling thread (which has to own the OpenGL context) only uploads, in list order as
+ * soon as the next image is decoded. With a texture budget all images are decoded first, so the levels to leave out
+ * are chosen for the whole batch at once. If a file can't be loaded, nothing of the batch is kept and the first error
+ * is rethrown.
+ *
+ * @param requests Texture files with their usage and priority, duplicates are decoded once.
+ * @param flipVertically Flip the images to match OpenGL's texture coordinates.
+ *
+ * @return One texture (reference) per request, in the order of the requests.
+ */
+std::vector<Texture> textureLoadBatch(const std::vector<TextureRequest>& requests, bool flipVertically = true);
+
+/**
+ * @brief Packs the first channel of up to four scalar textures (e.g. the AO, gloss and specular maps of a material)
+ * into one RGBA texture, source i ends up in channel i. Only textures loaded from file whose color channels agree are
+ * packed, the channels of the others stay 0 (alpha 255). Smaller maps are scaled up to the largest one. Packing the
+ * same files again shares the texture (see textureLoad).
+ *
+ * @param sources Textures to pack, at most four.
+ * @param packed Receives for every source whether it was packed.
+ *
+ * @return Packed texture, id 0 if none of the sources could be packed.
+ */
+Texture texturePack(const std::vector<Texture>& sources, std::vector<bool>& packed);
+
+/**
+ * @brief Collects textures into the layers of one texture array (GL_TEXTURE_2D_ARRAY), e.g. the diffuse maps of all
+ * materials of an object, so they are drawn with a single bind. The array takes the size and format of the largest
+ * texture loaded from file. Textures that already have them are read again (usually from the disk cache) and copied in
+ * as they are, all others (e.g. 8x8 constant maps, other block formats, textures not loaded from file) are scaled to
+ * the array size and compressed to its format; single colored ones just repeat one encoded block. Textures that appear
+ * more than once share a layer, textures with id 0 read as black like an unbound texture. The array keeps the
+ * resolution its textures have under the texture budget and streams its larger levels like textureLoad.
+ *
+ * @param textures Textures to collect, they keep their own references.
+ *
+ * @return One handle per texture: the array with the layer of the texture, each holding one reference to the array.
+ */
+std::vector<Texture> textureArrayCreate(const std::vector<Texture>& textures);
+
+/**
+ * @brief Creates (or shares, see textureLoad) a texture filled with one color, e.g. a neutral default map.
+ *
+ * @param width Width in texels.
+ * @param height Height in texels.
+ * @param color Color with channels in [0, 1].
+ *
+ * @return Initialized texture object, shared with other users of the same size and color.
+ */
 Texture textureCreateSingleColor(unsigned int width, unsigned int height, const Vector3D& color);
 
 /**
- * @brief Delete texture object. Has to be called for each texture after it is not used anymore.
+ * @brief Replaces a texture by one loaded through the cache and releases the one it replaces, which makes overriding
+ * a texture that was already loaded from the same file free.
+ *
+ * @param texture Texture to replace (released with textureDelete).
+ * @param path Path to texture file.
+ * @param usage What the texture holds, see eTextureUsage.
+ * @param priority Importance for the texture budget, see eTexturePriority.
+ */
+void textureReplace(Texture& texture, const std::string& path, eTextureUsage usage = TEXTURE_USAGE_DATA, int priority = TEXTURE_PRIORITY_PRIMARY);
+
+/**
+ * @brief Adds a reference to a texture, for code that stores another copy of the handle and deletes it separately.
+ *
+ * @param texture Texture to keep alive.
+ */
+void textureRetain(const Texture& texture);
+
+/**
+ * @brief Releases a reference to a texture, the OpenGL texture is deleted when the last one is gone. Has to be
+ * called for each texture (and each textureRetain) after it is not used anymore. Textures that are already deleted
+ * are ignored.
  *
  * @param texture Texture to delete.
  */
 void textureDelete(const Texture& texture);
+
+/**
+ * @brief Returns the counters of the texture cache.
+ *
+ * @return Decodes, cache hits, uploaded bytes and saved VRAM since program start.
+ */
+TextureCacheStats textureCacheStats();
+
+/**
+ * @brief VRAM all textures together may take. Defaults to the environment variable MYGL_TEXTURE_BUDGET (in MB),
+ * 0 (unlimited) if it isn't set.
+ *
+ * @return Budget in bytes, 0 for unlimited.
+ */
+std::size_t textureBudget();
+
+/**
+ * @brief Changes the texture budget for textures loaded from now on. Textures that are already loaded only lose
+ * levels when later loads need the room, they never get their levels back.
+ *
+ * @param bytes Budget in bytes, 0 for unlimited.
+ */
+void textureSetBudget(std::size_t bytes);
+
+/**
+ * @brief Makes room for a texture that is created outside of textureLoad (e.g. a cube map) within the texture budget:
+ * levels of less important live textures are dropped, or the new texture has to leave out its own top levels.
+ * Textures never drop below 64 texels on their longer side.
+ *
+ * @param levelBytes VRAM of each level of the new texture, level 0 first.
+ * @param width Width of level 0.
+ * @param height Height of level 0.
+ * @param priority Importance of the new texture, see eTexturePriority.
+ *
+ * @return Number of top levels the new texture has to leave out.
+ */
+unsigned int textureBudgetFit(const std::vector<std::size_t>& levelBytes, unsigned int width, unsigned int height, int priority);
+
+/**
+ * @brief Adds a texture that was created outside of textureLoad (e.g. a cube map) to the texture bookkeeping, so it
+ * counts against the budget, shows up in textureResidency and is released with textureDelete. Its levels can't be
+ * dropped later on.
+ *
+ * @param texture Texture with the size of its full level 0.
+ * @param name Name for the residency report.
+ * @param levelBytes VRAM of each level of the full chain, level 0 first.
+ * @param skipped Number of top levels that were left out (see textureBudgetFit).
+ * @param priority Importance of the texture, see eTexturePriority.
+ */
+void textureTrack(const Texture& texture, const std::string& name, const std::vector<std::size_t>& levelBytes, unsigned int skipped, int priority);
+
+/**
+ * @brief Lists the effective resolution of every texture loaded from file (or tracked with textureTrack).
+ *
+ * @return One entry per texture, most important first.
+ */
+std::vector<TextureResidency> textureResidency();
+
+/**
+ * @brief Bytes textureStreamUpdate uploads per call. Defaults to the environment variable MYGL_TEXTURE_STREAM (in
+ * MB), 4 MB if it isn't set.
+ *
+ * @return Budget in bytes, 0 if textures are uploaded completely at load.
+ */
+std::size_t textureStreamBudget();
+
+/**
+ * @brief Changes the streaming budget for textures loaded from now on, 0 turns streaming off. Textures that are
+ * streaming already keep streaming.
+ *
+ * @param bytes Bytes per textureStreamUpdate call.
+ */
+void textureSetStreamBudget(std::size_t bytes);
+
+/**
+ * @brief Number of textures that still wait for some of their levels.
+ *
+ * @return Number of streaming textures.
+ */
+std::size_t textureStreamPending();
+
+/**
+ * @brief Uploads the next piece of the streaming textures, meant to be called once per frame. The smallest missing
+ * level of all textures goes first, in whole rows through a pixel buffer object until the streaming budget is used
+ * up, so a large level may take several calls. A level is sampled once it is complete: the base level of its texture
+ * is moved down to it.
+ *
+ * @return Bytes uploaded.
+ */
+std::size_t textureStreamUpdate();
@@ -0,0 +1,331 @@
+#include "texture_compress.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MYGL_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace detail
+{
+
+/* the 16 texels of a 4x4 block, one array per channel */
+struct TexelBlock
+{
+    alignas(16) float c[4][16];
+};
+
+/* texels outside of the level (sizes that aren't multiples of 4) repeat the last row/column */
+void loadBlock(const ImageLevel& level, unsigned int bx, unsigned int by, TexelBlock& block)
+{
+    for(unsigned int y = 0; y < 4; y++)
+    {
+        const unsigned char* row = level.pixels + std::size_t(std::min(by * 4 + y, level.height - 1)) * level.width * 4;
+        for(unsigned int x = 0; x < 4; x++)
+        {
+            const unsigned char* texel = row + std::size_t(std::min(bx * 4 + x, level.width - 1)) * 4;
+            for(unsigned int c = 0; c < 4; c++)
+            {
+                block.c[c][y * 4 + x] = texel[c];
+            }
+        }
+    }
+}
+
+/* steps[i] = round(clamp(dot(texel i - origin, axis), 0, maxStep)) over channelCount channels starting at first */
+void projectSteps(const TexelBlock& block, unsigned int first, unsigned int channelCount, const float* origin, const float* axis, float maxStep, int* steps)
+{
+#ifdef MYGL_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 top = _mm_set1_ps(maxStep);
+    for(unsigned int i = 0; i < 16; i += 4)
+    {
+        __m128 d = zero;
+        for(unsigned int c = 0; c < channelCount; c++)
+        {
+            __m128 v = _mm_sub_ps(_mm_load_ps(&block.c[first + c][i]), _mm_set1_ps(origin[c]));
+            d = _mm_add_ps(d, _mm_mul_ps(v, _mm_set1_ps(axis[c])));
+        }
+        d = _mm_min_ps(_mm_max_ps(d, zero), top);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(steps + i), _mm_cvtps_epi32(d));
+    }
+#else
+    for(unsigned int i = 0; i < 16; i++)
+    {
+        float d = 0.0f;
+        for(unsigned int c = 0; c < channelCount; c++)
+        {
+            d += (block.c[first + c][i] - origin[c]) * axis[c];
+        }
+        steps[i] = static_cast<int>(std::lround(std::min(std::max(d, 0.0f), maxStep)));
+    }
+#endif
+}
+
+std::uint16_t pack565(const float* color)
+{
+    auto quantize = [](float v, float range) {
+        return static_cast<std::uint16_t>(std::lround(std::min(std::max(v, 0.0f), 255.0f) * range / 255.0f));
+    };
+    return static_cast<std::uint16_t>((quantize(color[0], 31.0f) << 11) | (quantize(color[1], 63.0f) << 5) | quantize(color[2], 31.0f));
+}
+
+void unpack565(std::uint16_t packed, float* color)
+{
+    unsigned int r = (packed >> 11) & 31u, g = (packed >> 5) & 63u, b = packed & 31u;
+    color[0] = static_cast<float>((r << 3) | (r >> 2));
+    color[1] = static_cast<float>((g << 2) | (g >> 4));
+    color[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+/* BC1 color block: endpoints at the ends of the principal axis of the texel colors, always in 4 color mode */
+void encodeColorBlock(const TexelBlock& block, unsigned char* out)
+{
+    float mean[3] = {0.0f, 0.0f, 0.0f}, min[3], max[3];
+    for(unsigned int c = 0; c < 3; c++)
+    {
+        min[c] = max[c] = block.c[c][0];
+        for(unsigned int i = 0; i < 16; i++)
+        {
+            mean[c] += block.c[c][i];
+            min[c] = std::min(min[c], block.c[c][i]);
+            max[c] = std::max(max[c], block.c[c][i]);
+        }
+        mean[c] /= 16.0f;
+    }
+
+    float cov[3][3] = {};
+    for(unsigned int i = 0; i < 16; i++)
+    {
+        float d[3] = {block.c[0][i] - mean[0], block.c[1][i] - mean[1], block.c[2][i] - mean[2]};
+        for(unsigned int a = 0; a < 3; a++)
+        {
+            for(unsigned int b = 0; b < 3; b++)
+            {
+                cov[a][b] += d[a] * d[b];
+            }
+        }
+    }
+
+    /* power iteration, starting from the diagonal of the bounding box */
+    float axis[3] = {max[0] - min[0], max[1] - min[1], max[2] - min[2]};
+    for(unsigned int iteration = 0; iteration < 4; iteration++)
+    {
+        float next[3];
+        for(unsigned int a = 0; a < 3; a++)
+        {
+            next[a] = cov[a][0] * axis[0] + cov[a][1] * axis[1] + cov[a][2] * axis[2];
+        }
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if(length <= 0.0f)
+        {
+            break;
+        }
+        for(unsigned int a = 0; a < 3; a++)
+        {
+            axis[a] = next[a] / length;
+        }
+    }
+    float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+
+    float lo = 0.0f, hi = 0.0f;
+    if(axisLength > 0.0f)
+    {
+        for(unsigned int a = 0; a < 3; a++)
+        {
+            axis[a] /= axisLength;
+        }
+        for(unsigned int i = 0; i < 16; i++)
+        {
+            float t = (block.c[0][i] - mean[0]) * axis[0] + (block.c[1][i] - mean[1]) * axis[1] + (block.c[2][i] - mean[2]) * axis[2];
+            lo = std::min(lo, t);
+            hi = std::max(hi, t);
+        }
+    }
+
+    float c0[3], c1[3];
+    for(unsigned int a = 0; a < 3; a++)
+    {
+        c0[a] = mean[a] + axis[a] * hi;
+        c1[a] = mean[a] + axis[a] * lo;
+    }
+    std::uint16_t q0 = pack565(c0), q1 = pack565(c1);
+
+    /* 4 color mode needs q0 > q1, equal endpoints mean a solid block with all indices 0 */
+    std::uint32_t indices = 0;
+    if(q0 < q1)
+    {
+        std::swap(q0, q1);
+    }
+    if(q0 != q1)
+    {
+        float e0[3], e1[3], scaled[3];
+        unpack565(q0, e0);
+        unpack565(q1, e1);
+        float dir[3] = {e1[0] - e0[0], e1[1] - e0[1], e1[2] - e0[2]};
+        float length2 = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+        for(unsigned int a = 0; a < 3; a++)
+        {
+            scaled[a] = dir[a] * 3.0f / length2;
+        }
+
+        /* steps along e0 -> e1 to palette indices: e0, 2/3 e0 + 1/3 e1, 1/3 e0 + 2/3 e1, e1 */
+        int steps[16];
+        const std::uint32_t palette[4] = {0, 2, 3, 1};
+        projectSteps(block, 0, 3, e0, scaled, 3.0f, steps);
+        for(unsigned int i = 0; i < 16; i++)
+        {
+            indices |= palette[steps[i]] << (2 * i);
+        }
+    }
+
+    out[0] = static_cast<unsigned char>(q0 & 0xFF);
+    out[1] = static_cast<unsigned char>(q0 >> 8);
+    out[2] = static_cast<unsigned char>(q1 & 0xFF);
+    out[3] = static_cast<unsigned char>(q1 >> 8);
+    for(unsigned int b = 0; b < 4; b++)
+    {
+        out[4 + b] = static_cast<unsigned char>(indices >> (8 * b));
+    }
+}
+
+/* BC4 block of one channel (also the alpha block of BC3 and the halves of BC5): 8 value mode between min and max */
+void encodeScalarBlock(const TexelBlock& block, unsigned int channel, unsigned char* out)
+{
+    float lo = block.c[channel][0], hi = lo;
+    for(unsigned int i = 1; i < 16; i++)
+    {
+        lo = std::min(lo, block.c[channel][i]);
+        hi = std::max(hi, block.c[channel][i]);
+    }
+
+    unsigned char a0 = static_cast<unsigned char>(hi), a1 = static_cast<unsigned char>(lo);
+    std::uint64_t indices = 0;
+    if(a0 != a1)
+    {
+        /* steps from a1 (0) to a0 (7) to palette indices: a0, a1, then the 6 values in between from a0 towards a1 */
+        int steps[16];
+        float origin = a1, scale = 7.0f / static_cast<float>(a0 - a1);
+        projectSteps(block, channel, 1, &origin, &scale, 7.0f, steps);
+        for(unsigned int i = 0; i < 16; i++)
+        {
+            std::uint64_t index = steps[i] == 7 ? 0 : steps[i] == 0 ? 1 : static_cast<std::uint64_t>(8 - steps[i]);
+            indices |= index << (3 * i);
+        }
+    }
+
+    out[0] = a0;
+    out[1] = a1;
+    for(unsigned int b = 0; b < 6; b++)
+    {
+        out[2 + b] = static_cast<unsigned char>(indices >> (8 * b));
+    }
+}
+
+std::size_t blockBytes(eTextureFormat format)
+{
+    return format == TEXTURE_FORMAT_BC1 || format == TEXTURE_FORMAT_BC4 ? 8 : 16;
+}
+
+void compressLevel(const ImageLevel& level, eTextureFormat format, unsigned char* out)
+{
+    const unsigned int blocksX = (level.width + 3) / 4, blocksY = (level.height + 3) / 4;
+    const std::size_t rowBytes = blocksX * blockBytes(format);
+
+    parallelFor(blocksY, [&](std::size_t by) {
+        TexelBlock block;
+        unsigned char* dst = out + by * rowBytes;
+        for(unsigned int bx = 0; bx < blocksX; bx++)
+        {
+            loadBlock(level, bx, static_cast<unsigned int>(by), block);
+            switch(format)
+            {
+            case TEXTURE_FORMAT_BC1:
+                encodeColorBlock(block, dst);
+                break;
+            case TEXTURE_FORMAT_BC3:
+                encodeScalarBlock(block, 3, dst);
+                encodeColorBlock(block, dst + 8);
+                break;
+            case TEXTURE_FORMAT_BC4:
+                encodeScalarBlock(block, 0, dst);
+                break;
+            case TEXTURE_FORMAT_BC5:
+                encodeScalarBlock(block, 0, dst);
+                encodeScalarBlock(block, 1, dst + 8);
+                break;
+            default:
+                break;
+            }
+            dst += blockBytes(format);
+        }
+    });
+}
+
+}
+
+std::size_t textureFormatSize(eTextureFormat format, unsigned int width, unsigned int height)
+{
+    if(format == TEXTURE_FORMAT_RGBA8)
+    {
+        return std::size_t(width) * height * 4;
+    }
+    return std::size_t((width + 3) / 4) * ((height + 3) / 4) * detail::blockBytes(format);
+}
+
+eTextureFormat textureFormatFor(eTextureUsage usage, const ImageLevel& level)
+{
+    switch(usage)
+    {
+    case TEXTURE_USAGE_COLOR:
+        for(std::size_t i = 0; i < std::size_t(level.width) * level.height; i++)
+        {
+            if(level.pixels[i * 4 + 3] != 255)
+            {
+                return TEXTURE_FORMAT_BC3;
+            }
+        }
+        return TEXTURE_FORMAT_BC1;
+    case TEXTURE_USAGE_SCALAR:
+        return TEXTURE_FORMAT_BC4;
+    case TEXTURE_USAGE_NORMAL:
+        return TEXTURE_FORMAT_BC5;
+    default:
+        return TEXTURE_FORMAT_RGBA8;
+    }
+}
+
+ImageMips imageCompress(const ImageMips& image, eTextureFormat format)
+{
+    ImageMips compressed;
+    compressed.format = format;
+    compressed.levels = image.levels;
+
+    std::size_t bytes = 0;
+    for(const auto& level : image.levels)
+    {
+        bytes += textureFormatSize(format, level.width, level.height);
+    }
+    compressed.storage.resize(bytes);
+
+    unsigned char* out = compressed.storage.data();
+    for(std::size_t i = 0; i < image.levels.size(); i++)
+    {
+        if(format == TEXTURE_FORMAT_RGBA8)
+        {
+            std::memcpy(out, image.levels[i].pixels, textureFormatSize(format, image.levels[i].width, image.levels[i].height));
+        }
+        else
+        {
+            detail::compressLevel(image.levels[i], format, out);
+        }
+        compressed.levels[i].pixels = out;
+        out += textureFormatSize(format, image.levels[i].width, image.levels[i].height);
+    }
+    return compressed;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "image_cache.h"
+
+#include <cstddef>
+
+/**
+ * @brief Size of one level in a texture format.
+ *
+ * @param format Texture format.
+ * @param width Width of the level in texels.
+ * @param height Height of the level in texels.
+ *
+ * @return Size in bytes, BCn levels are padded to whole 4x4 blocks.
+ */
+std::size_t textureFormatSize(eTextureFormat format, unsigned int width, unsigned int height);
+
+/**
+ * @brief Block format an image of a usage is compressed to: BC1 for color without alpha, BC3 for color with alpha,
+ * BC4 for scalar maps and BC5 for normal maps.
+ *
+ * @param usage What the image holds.
+ * @param level Base level of the image (RGBA8), checked for alpha.
+ *
+ * @return Block format, TEXTURE_FORMAT_RGBA8 for TEXTURE_USAGE_DATA.
+ */
+eTextureFormat textureFormatFor(eTextureUsage usage, const ImageLevel& level);
+
+/**
+ * @brief Compresses all levels of an RGBA8 image to a BCn block format on the CPU. Every block is fit with the
+ * principal axis of its colors (the 4 pixel wide math uses SSE2 where available), the block rows of a level are
+ * spread over the shared worker pool.
+ *
+ * @param image RGBA8 image with its mip chain.
+ * @param format Block format to compress to.
+ *
+ * @return Compressed levels.
+ */
+ImageMips imageCompress(const ImageMips& image, eTextureFormat format);
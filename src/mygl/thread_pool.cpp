@@ -0,0 +1,169 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace detail
+{
+
+struct ThreadPool
+{
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stop = false;
+
+    explicit ThreadPool(unsigned int count)
+    {
+        for(unsigned int i = 0; i < count; i++)
+        {
+            workers.emplace_back([this]() { work(); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for(auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    void work()
+    {
+        for(;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stop || !jobs.empty(); });
+                if(jobs.empty())
+                {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+};
+
+ThreadPool& threadPool()
+{
+    /* the calling thread always helps in parallelFor, so one worker less than threads */
+    static ThreadPool pool(threadPoolSize() - 1);
+    return pool;
+}
+
+struct ParallelForState
+{
+    std::atomic<std::size_t> next{0};
+    std::size_t count = 0;
+    std::size_t done = 0;
+    const std::function<void(std::size_t)>* job = nullptr;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::exception_ptr error;
+
+    /* claims and runs jobs until none are left */
+    void run()
+    {
+        for(std::size_t i = next++; i < count; i = next++)
+        {
+            std::exception_ptr jobError;
+            try
+            {
+                (*job)(i);
+            }
+            catch(...)
+            {
+                jobError = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if(jobError && !error)
+            {
+                error = jobError;
+            }
+            if(++done == count)
+            {
+                finished.notify_all();
+            }
+        }
+    }
+};
+
+}
+
+unsigned int threadPoolSize()
+{
+    static const unsigned int size = []() {
+        if(const char* env = std::getenv("MYGL_THREADS"))
+        {
+            int requested = std::atoi(env);
+            if(requested > 0)
+            {
+                return static_cast<unsigned int>(requested);
+            }
+        }
+        return std::max(1u, std::thread::hardware_concurrency());
+    }();
+    return size;
+}
+
+void threadPoolEnqueue(std::function<void()> job)
+{
+    auto& pool = detail::threadPool();
+    if(pool.workers.empty())
+    {
+        job();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.jobs.push_back(std::move(job));
+    }
+    pool.wake.notify_one();
+}
+
+void parallelFor(std::size_t count, const std::function<void(std::size_t)>& job)
+{
+    if(count == 0)
+    {
+        return;
+    }
+
+    auto state = std::make_shared<detail::ParallelForState>();
+    state->count = count;
+    state->job = &job;
+
+    /* helpers that start after all jobs were claimed return without touching the job */
+    std::size_t helpers = std::min<std::size_t>(count, threadPoolSize()) - 1;
+    for(std::size_t i = 0; i < helpers; i++)
+    {
+        threadPoolEnqueue([state]() { state->run(); });
+    }
+    state->run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&]() { return state->done == state->count; });
+    if(state->error)
+    {
+        std::rethrow_exception(state->error);
+    }
+}
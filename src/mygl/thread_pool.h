@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+
+/**
+ * @brief Number of threads that work on jobs of the shared worker pool (including the calling thread in
+ * parallelFor). Defaults to the number of hardware threads, can be overridden with the environment variable
+ * MYGL_THREADS.
+ */
+unsigned int threadPoolSize();
+
+/**
+ * @brief Enqueues a job on the shared worker pool. The pool is created on first use.
+ *
+ * @param job Job to run on one of the worker threads.
+ */
+void threadPoolEnqueue(std::function<void()> job);
+
+/**
+ * @brief Runs job(i) for every i in [0, count) on the shared worker pool. The calling thread takes part in the work,
+ * so calling it from inside a job is fine. Blocks until all jobs are done and rethrows the first exception thrown by
+ * a job.
+ *
+ * @param count Number of jobs.
+ * @param job Job to run for every index.
+ */
+void parallelFor(std::size_t count, const std::function<void(std::size_t)>& job);
+
+/**
+ * @brief Runs a function asynchronously on the shared worker pool.
+ *
+ * @param function Function to run.
+ *
+ * @return Future holding the result (or the exception) of the function.
+ */
+template<typename F>
+auto threadPoolAsync(F&& function) -> std::future<decltype(function())>
+{
+    auto task = std::make_shared<std::packaged_task<decltype(function())()>>(std::forward<F>(function));
+    auto future = task->get_future();
+    threadPoolEnqueue([task]() { (*task)(); });
+    return future;
+}
@@ -0,0 +1,49 @@
+#include "uniform_buffer.h"
+
+const char* uniformBlockName(eUniformBlock block)
+{
+    switch(block)
+    {
+        case UNIFORM_BLOCK_FRAME: return "FrameBlock";
+        case UNIFORM_BLOCK_LIGHT: return "LightBlock";
+        case UNIFORM_BLOCK_DRAW: return "DrawBlock";
+        case UNIFORM_BLOCK_MATERIAL: return "MaterialBlock";
+        default: return "";
+    }
+}
+
+void uniformBlockBind(GLuint program)
+{
+    for(unsigned int block = 0; block < UNIFORM_BLOCK_COUNT; block++)
+    {
+        GLuint index = glGetUniformBlockIndex(program, uniformBlockName(static_cast<eUniformBlock>(block)));
+        if(index != GL_INVALID_INDEX)
+        {
+            glUniformBlockBinding(program, index, block);
+        }
+    }
+}
+
+UniformBuffer uniformBufferCreate(eUniformBlock block, std::size_t size)
+{
+    UniformBuffer buffer{0, block, size};
+    glGenBuffers(1, &buffer.id);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer.id);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, block, buffer.id);
+    return buffer;
+}
+
+void uniformBufferUpdate(const UniformBuffer& buffer, const void* data)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer.id);
+    glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(buffer.size), data, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void uniformBufferDelete(UniformBuffer& buffer)
+{
+    glDeleteBuffers(1, &buffer.id);
+    buffer = UniformBuffer{};
+}
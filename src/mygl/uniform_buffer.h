@@ -0,0 +1,120 @@
+#pragma once
+
+#include "base.h"
+
+#include <cstddef>
+
+/* fixed binding points of the uniform blocks shared by all shader programs */
+enum eUniformBlock
+{
+    UNIFORM_BLOCK_FRAME = 0,    // FrameBlock
+    UNIFORM_BLOCK_LIGHT,        // LightBlock
+    UNIFORM_BLOCK_DRAW,         // DrawBlock, a window of the draw ring (see DrawRing)
+    UNIFORM_BLOCK_MATERIAL,     // MaterialBlock
+    UNIFORM_BLOCK_COUNT
+};
+
+/* array sizes of DrawBlock and MaterialBlock, have to match the shaders */
+#define DRAW_RECORDS 128
+#define MATERIAL_RECORDS 128
+
+/* std140 layout of the FrameBlock uniform block, filled once per frame */
+struct FrameBlock
+{
+    Matrix4D view;
+    Matrix4D proj;
+    Matrix4D viewProj;
+    Vector3D cameraPos;
+    float time;                 // seconds since startup, shares the last 16 byte slot with cameraPos
+};
+static_assert(sizeof(FrameBlock) == 208, "FrameBlock has to match its std140 declaration in the shaders");
+
+/* std140 layout of the LightBlock uniform block (the light of the scene), every vec3 starts a 16 byte slot */
+struct LightBlock
+{
+    Vector3D lightPos;
+    float _pad0 = 0.0f;
+    Vector3D globalAmbientLightColor;
+    float _pad1 = 0.0f;
+    Vector3D lightColor;
+    float ka = 0.0f;            // ambient coefficient  [0, 1]
+    float kd = 0.0f;            // diffuse coefficient  [0, 1]
+    float ks = 0.0f;            // specular coefficient [0, 1]
+    float _pad2[2] = {0.0f, 0.0f};
+};
+static_assert(sizeof(LightBlock) == 64, "LightBlock has to match its std140 declaration in the shaders");
+
+/* std140 layout of one element of the DrawBlock uniform block, written for every draw */
+struct DrawRecord
+{
+    Matrix4D model;
+    Vector4D normal[3];         // columns of transpose(inverse(mat3(model))), a mat3 takes three 16 byte slots
+    int material = 0;           // element of MaterialBlock
+    int _pad[3] = {0, 0, 0};
+};
+static_assert(sizeof(DrawRecord) == 128, "DrawRecord has to match its std140 declaration in the shaders");
+
+/* std140 layout of one element of the MaterialBlock uniform block */
+struct MaterialRecord
+{
+    Vector3D diffuse;
+    float shininess = 0.0f;
+    Vector3D ambient;
+    float _pad0 = 0.0f;
+    Vector3D specular;
+    float _pad1 = 0.0f;
+    Vector3D emission;
+    float _pad2 = 0.0f;
+    int layers[8] = {};         // texture array layers of the maps (see materialLayers), two ivec4 in the shaders
+};
+static_assert(sizeof(MaterialRecord) == 96, "MaterialRecord has to match its std140 declaration in the shaders");
+
+struct UniformBuffer
+{
+    GLuint id = 0;
+    eUniformBlock block = UNIFORM_BLOCK_FRAME;
+    std::size_t size = 0;
+};
+
+/**
+ * @brief Name of a uniform block in the shaders.
+ *
+ * @param block Uniform block.
+ *
+ * @return Block name as declared in GLSL.
+ */
+const char* uniformBlockName(eUniformBlock block);
+
+/**
+ * @brief Assigns the fixed binding point of every uniform block a linked program declares (GLSL 330 has no binding
+ * layout qualifier). Called by shaderCreate.
+ *
+ * @param program Linked program.
+ */
+void uniformBlockBind(GLuint program);
+
+/**
+ * @brief Creates a uniform buffer and binds it to the binding point of its block for the lifetime of the context.
+ *
+ * @param block Uniform block the buffer backs.
+ * @param size Size of the block in bytes.
+ *
+ * @return Uniform buffer.
+ */
+UniformBuffer uniformBufferCreate(eUniformBlock block, std::size_t size);
+
+/**
+ * @brief Replaces the content of a uniform buffer. The old storage is orphaned, so draws of the previous frame that
+ * still read it don't stall the upload.
+ *
+ * @param buffer Uniform buffer.
+ * @param data New content, buffer.size bytes.
+ */
+void uniformBufferUpdate(const UniformBuffer& buffer, const void* data);
+
+/**
+ * @brief Deletes a uniform buffer. Has to be called for each uniform buffer after it is not used anymore.
+ *
+ * @param buffer Uniform buffer to delete.
+ */
+void uniformBufferDelete(UniformBuffer& buffer);
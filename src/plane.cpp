@@ -5,7 +5,7 @@
 
 Plane planeLoad(const std::string& planeFilePath, const std::string& flagFilePath)
 {
-    std::vector<Model> models = modelLoad(planeFilePath);
+    std::vector<Model> models = modelLoad(planeFilePath, MODEL_LOAD_OPTIMIZE | MODEL_LOAD_COMPACT | MODEL_LOAD_LOD);
 
     if(models.size() != Plane::ePart::PART_COUNT)
     {
@@ -33,12 +33,12 @@ Plane planeLoad(const std::string& planeFilePath, const std::string& flagFilePat
         plane.partModel[Plane::HULL] = obj;
             if (!plane.partModel[Plane::HULL].material.empty()) {
                 for (auto& material : plane.partModel[Plane::HULL].material) {
-                    material.map_diffuse = textureLoad("assets/plane/textures/Cessna_Body_Albedo.png");
-                    material.map_normal = textureLoad("assets/plane/textures/Cessna_Body_Normals.png");
-                    material.map_specular = textureLoad("assets/plane/textures/Cessna_Body_Specular_Color.png");
-                    material.map_ambient = textureLoad("assets/plane/textures/Cessna_Body_AO.png");
-                    material.map_emission = textureLoad("assets/plane/textures/Cessna_Body_Emission.png");
-                    material.map_shininess = textureLoad("assets/plane/textures/Cessna_Body_Glossy.png");
+                    textureReplace(material.map_diffuse, "assets/plane/textures/Cessna_Body_Albedo.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                    textureReplace(material.map_normal, "assets/plane/textures/Cessna_Body_Normals.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                    textureReplace(material.map_specular, "assets/plane/textures/Cessna_Body_Specular_Color.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
+                    textureReplace(material.map_ambient, "assets/plane/textures/Cessna_Body_AO.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                    textureReplace(material.map_emission, "assets/plane/textures/Cessna_Body_Emission.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
+                    textureReplace(material.map_shininess, "assets/plane/textures/Cessna_Body_Glossy.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
                 }
             } else {
                 std::cerr << "[Error] No materials found in HULL part!" << std::endl;
@@ -48,11 +48,11 @@ Plane planeLoad(const std::string& planeFilePath, const std::string& flagFilePat
             plane.partModel[Plane::WINDOWS] = obj;
             if (!plane.partModel[Plane::WINDOWS].material.empty()) {
                 for (auto& material : plane.partModel[Plane::WINDOWS].material) {
-                    material.map_diffuse = textureLoad("assets/plane/textures/Cessna_Glass_Albedo.png");
-                    material.map_normal = textureLoad("assets/plane/textures/Cessna_Glass_Normals.png");
-                    material.map_ambient = textureLoad("assets/plane/textures/Cessna_Glass_AO.png");
-                    material.map_emission = textureLoad("assets/plane/textures/Cessna_Glass_Emission.png");
-                    material.map_shininess = textureLoad("assets/plane/textures/Cessna_Glass_Glossy.png");
+                    textureReplace(material.map_diffuse, "assets/plane/textures/Cessna_Glass_Albedo.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                    textureReplace(material.map_normal, "assets/plane/textures/Cessna_Glass_Normals.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                    textureReplace(material.map_ambient, "assets/plane/textures/Cessna_Glass_AO.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                    textureReplace(material.map_emission, "assets/plane/textures/Cessna_Glass_Emission.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
+                    textureReplace(material.map_shininess, "assets/plane/textures/Cessna_Glass_Glossy.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
                 }
             } else {
                 std::cerr << "[Error] No materials found in Glass part!" << std::endl;
@@ -99,11 +99,11 @@ Plane planeLoad(const std::string& planeFilePath, const std::string& flagFilePat
             plane.partModel[Plane::FLAG_CONNECTOR] = obj;
             if (!plane.partModel[Plane::FLAG_CONNECTOR].material.empty()) {
                 for (auto& material : plane.partModel[Plane::FLAG_CONNECTOR].material) {
-                    material.map_diffuse = textureLoad("assets/plane/textures/Cessna_Rope_Albedo.png");
-                    material.map_normal = textureLoad("assets/plane/textures/Cessna_Rope_Normals.png");
-                    material.map_ambient = textureLoad("assets/plane/textures/Cessna_Rope_AO.png");
-                    material.map_emission = textureLoad("assets/plane/textures/Cessna_Rope_Emission.png");
-                    material.map_shininess = textureLoad("assets/plane/textures/Cessna_Rope_Glossy.png");
+                    textureReplace(material.map_diffuse, "assets/plane/textures/Cessna_Rope_Albedo.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                    textureReplace(material.map_normal, "assets/plane/textures/Cessna_Rope_Normals.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                    textureReplace(material.map_ambient, "assets/plane/textures/Cessna_Rope_AO.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                    textureReplace(material.map_emission, "assets/plane/textures/Cessna_Rope_Emission.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
+                    textureReplace(material.map_shininess, "assets/plane/textures/Cessna_Rope_Glossy.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
                 }
             } else {
                 std::cerr << "[Error] No materials found in FlagConnector part!" << std::endl;
@@ -112,6 +112,22 @@ Plane planeLoad(const std::string& planeFilePath, const std::string& flagFilePat
         else throw std::runtime_error("[Plane] unkown part name: " + obj.name);
     }
 
+    /* all parts share one texture array per map slot (without s3tc the maps stay separate and the scalar ones are packed),
+     * the lights switch between their own emission map and a black one */
+    std::vector<Material*> materials;
+    for (auto& part : plane.partModel)
+    {
+        for (auto& material : part.material)
+        {
+            materials.push_back(&material);
+        }
+    }
+    plane.family = materialFamilyPrepare(materials, {{MATERIAL_MAP_EMISSION, &plane.noEmissionTexture}});
+    for (auto& [part, texture] : plane.emissionTextures)
+    {
+        texture = plane.partModel[part].material[0].map_emission;
+    }
+
     plane.flag = flagCreate(flagFilePath);
     plane.flagModelMatrix = flagPlane::trans;
 
@@ -122,22 +138,15 @@ void planeDelete(Plane &plane)
 {
     flagDelete(plane.flag);
 
+    /* the materials have to hold their own emission textures again, they release them */
+    setLightEmission(plane, true);
     for (auto &model : plane.partModel)
     {
         modelDelete(model);
     }
 
     textureDelete(plane.noEmissionTexture);
-    for (auto& model : plane.partModel) {
-        for (auto& material : model.material) {
-            textureDelete(material.map_diffuse);
-            textureDelete(material.map_normal);
-            textureDelete(material.map_specular);
-            textureDelete(material.map_ambient);
-            textureDelete(material.map_emission);
-            textureDelete(material.map_shininess);
-        }
-    }
+    materialFamilyDelete(plane.family);
     /*
     textureDelete(plane.body_ao);
     textureDelete(plane.body_emission);
@@ -47,6 +47,7 @@ struct Plane
     std::map<int, Vector3D> emissionColors;
     std::map<int, Texture> emissionTextures;
     Texture noEmissionTexture;
+    MaterialFamily family;
     /*
     Texture body_ao;
     Texture body_emission;
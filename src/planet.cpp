@@ -7,7 +7,7 @@ Planet planetLoad(const std::string &planetFilePath)
 {
 
     Planet planet;
-    planet.partModel = modelLoad(planetFilePath);
+    planet.partModel = modelLoad(planetFilePath, MODEL_LOAD_OPTIMIZE | MODEL_LOAD_COMPACT | MODEL_LOAD_LOD | MODEL_LOAD_STREAM | MODEL_LOAD_CLUSTER);
     planet.noEmissionTexture = textureCreateSingleColor(1, 1, {0.0f, 0.0f, 0.0f});
 
     if(planet.partModel.size() <= 0)
@@ -24,51 +24,51 @@ Planet planetLoad(const std::string &planetFilePath)
         auto &part = planet.partModel[part_id];
         for (auto mat_id=0u; mat_id < planet.partModel[part_id].material.size(); mat_id++)
         {
-            auto mat = planet.partModel[part_id].material[mat_id];
+            auto &mat = planet.partModel[part_id].material[mat_id];
 
             // Texture setUp
             if (part.name == "Boats"){
-                mat.map_diffuse = textureLoad("assets/planet/textures/Boats_Albedo.png");
-                mat.map_ambient = textureLoad("assets/planet/textures/Boats_AO.png");
-                mat.map_emission = textureLoad("assets/planet/textures/Boats_Emission.png");
-                mat.map_shininess = textureLoad("assets/planet/textures/Boats_Glossy.png");
-                mat.map_normal = textureLoad("assets/planet/textures/Boats_Normals.png");
-                mat.map_specular = textureLoad("assets/planet/textures/Boats_Specular_Color.png");
+                textureReplace(mat.map_diffuse, "assets/planet/textures/Boats_Albedo.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                textureReplace(mat.map_ambient, "assets/planet/textures/Boats_AO.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                textureReplace(mat.map_emission, "assets/planet/textures/Boats_Emission.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
+                textureReplace(mat.map_shininess, "assets/planet/textures/Boats_Glossy.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                textureReplace(mat.map_normal, "assets/planet/textures/Boats_Normals.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                textureReplace(mat.map_specular, "assets/planet/textures/Boats_Specular_Color.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
             } else if (part.name == "Continent"){
-                mat.map_diffuse = textureLoad("assets/planet/textures/Continents_Albedo.png");
-                mat.map_ambient = textureLoad("assets/planet/textures/Continents_AO.png");
-                mat.map_emission = textureLoad("assets/planet/textures/Continents_Emission.png");
-                mat.map_shininess = textureLoad("assets/planet/textures/Continents_Glossy.png");
-                mat.map_normal = textureLoad("assets/planet/textures/Continents_Normals.png");
-                mat.map_specular = textureLoad("assets/planet/textures/Continents_Specular_Color.png");
+                textureReplace(mat.map_diffuse, "assets/planet/textures/Continents_Albedo.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                textureReplace(mat.map_ambient, "assets/planet/textures/Continents_AO.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                textureReplace(mat.map_emission, "assets/planet/textures/Continents_Emission.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
+                textureReplace(mat.map_shininess, "assets/planet/textures/Continents_Glossy.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                textureReplace(mat.map_normal, "assets/planet/textures/Continents_Normals.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                textureReplace(mat.map_specular, "assets/planet/textures/Continents_Specular_Color.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
             } else if (part.name == "Houses"){
-                mat.map_diffuse = textureLoad("assets/planet/textures/Houses_Albedo.png");
-                mat.map_ambient = textureLoad("assets/planet/textures/Houses_AO.png");
-                mat.map_emission = textureLoad("assets/planet/textures/Houses_Emit.png");
-                mat.map_shininess = textureLoad("assets/planet/textures/Houses_Glossy.png");
-                mat.map_normal = textureLoad("assets/planet/textures/Houses_Normal.png");
-                mat.map_specular = textureLoad("assets/planet/textures/Houses_Specular_Color.png");
+                textureReplace(mat.map_diffuse, "assets/planet/textures/Houses_Albedo.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                textureReplace(mat.map_ambient, "assets/planet/textures/Houses_AO.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                textureReplace(mat.map_emission, "assets/planet/textures/Houses_Emit.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
+                textureReplace(mat.map_shininess, "assets/planet/textures/Houses_Glossy.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                textureReplace(mat.map_normal, "assets/planet/textures/Houses_Normal.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                textureReplace(mat.map_specular, "assets/planet/textures/Houses_Specular_Color.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
             } else if (part.name == "Ocean"){
-                mat.map_diffuse = textureLoad("assets/planet/textures/Ocean_Albedo.png");
-                mat.map_ambient = textureLoad("assets/planet/textures/Ocean_AO.png");
-                mat.map_emission = textureLoad("assets/planet/textures/Ocean_Emission.png");
-                mat.map_shininess = textureLoad("assets/planet/textures/Ocean_Glossy.png");
-                mat.map_normal = textureLoad("assets/planet/textures/Ocean_Normals.png");
-                mat.map_specular = textureLoad("assets/planet/textures/Ocean_Specular_Color.png");
+                textureReplace(mat.map_diffuse, "assets/planet/textures/Ocean_Albedo.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                textureReplace(mat.map_ambient, "assets/planet/textures/Ocean_AO.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                textureReplace(mat.map_emission, "assets/planet/textures/Ocean_Emission.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
+                textureReplace(mat.map_shininess, "assets/planet/textures/Ocean_Glossy.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                textureReplace(mat.map_normal, "assets/planet/textures/Ocean_Normals.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                textureReplace(mat.map_specular, "assets/planet/textures/Ocean_Specular_Color.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
             } else if (part.name == "Trees"){
-                mat.map_diffuse = textureLoad("assets/planet/textures/Trees_Albedo.png");
-                mat.map_ambient = textureLoad("assets/planet/textures/Trees_AO.png");
-                mat.map_emission = textureLoad("assets/planet/textures/Trees_Emission.png");
-                mat.map_shininess = textureLoad("assets/planet/textures/Trees_Glossy.png");
-                mat.map_normal = textureLoad("assets/planet/textures/Trees_Normals.png");
-                mat.map_specular = textureLoad("assets/planet/textures/Trees_Specular_Color.png");
+                textureReplace(mat.map_diffuse, "assets/planet/textures/Trees_Albedo.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                textureReplace(mat.map_ambient, "assets/planet/textures/Trees_AO.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                textureReplace(mat.map_emission, "assets/planet/textures/Trees_Emission.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
+                textureReplace(mat.map_shininess, "assets/planet/textures/Trees_Glossy.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                textureReplace(mat.map_normal, "assets/planet/textures/Trees_Normals.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                textureReplace(mat.map_specular, "assets/planet/textures/Trees_Specular_Color.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
             } else if (part.name == "Vistas"){
-                mat.map_diffuse = textureLoad("assets/planet/textures/Vistas_Albedo.png");
-                mat.map_ambient = textureLoad("assets/planet/textures/Vistas_AO.png");
-                mat.map_emission = textureLoad("assets/planet/textures/Vistas_Emission.png");
-                mat.map_shininess = textureLoad("assets/planet/textures/Vistas_Glossy.png");
-                mat.map_normal = textureLoad("assets/planet/textures/Vistas_Normals.png");
-                mat.map_specular = textureLoad("assets/planet/textures/Vistas_Specular_Color.png");
+                textureReplace(mat.map_diffuse, "assets/planet/textures/Vistas_Albedo.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                textureReplace(mat.map_ambient, "assets/planet/textures/Vistas_AO.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                textureReplace(mat.map_emission, "assets/planet/textures/Vistas_Emission.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
+                textureReplace(mat.map_shininess, "assets/planet/textures/Vistas_Glossy.png", TEXTURE_USAGE_SCALAR, TEXTURE_PRIORITY_DETAIL);
+                textureReplace(mat.map_normal, "assets/planet/textures/Vistas_Normals.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_PRIMARY);
+                textureReplace(mat.map_specular, "assets/planet/textures/Vistas_Specular_Color.png", TEXTURE_USAGE_COLOR, TEXTURE_PRIORITY_SURFACE);
             }
             
             if (mat.emission.x > 0.0f || mat.emission.y > 0.0f || mat.emission.z > 0.0f)
@@ -87,17 +87,39 @@ Planet planetLoad(const std::string &planetFilePath)
         }
     }
 
+    /* all parts share one texture array per map slot (without s3tc the maps stay separate and the scalar ones are packed),
+     * emission maps switch between their own map and a black one */
+    std::vector<Material*> materials;
+    for (auto &part : planet.partModel)
+    {
+        for (auto &mat : part.material)
+        {
+            materials.push_back(&mat);
+        }
+    }
+    planet.family = materialFamilyPrepare(materials, {{MATERIAL_MAP_EMISSION, &planet.noEmissionTexture}});
+    for (auto &[part_id, textures] : planet.emissionTextures)
+    {
+        for (auto &[mat_id, texture] : textures)
+        {
+            texture = planet.partModel[part_id].material[mat_id].map_emission;
+        }
+    }
+
     return planet;
 }
 
 void planetDelete(Planet &planet)
 {
+    /* the materials have to hold their own emission textures again, they release them */
+    setEmisson(planet, true);
     for (auto &model : planet.partModel)
     {
         modelDelete(model);
     }
 
     textureDelete(planet.noEmissionTexture);
+    materialFamilyDelete(planet.family);
     planet.partModel.clear();
 }
 
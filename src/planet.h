@@ -11,6 +11,7 @@ struct Planet
     std::map<int, std::map<int, Vector3D>> emissionColors;
     std::map<int, std::map<int, Texture>> emissionTextures;
     Texture noEmissionTexture;
+    MaterialFamily family;
 
     Matrix4D transformation = Matrix4D::scale(50.0, 50.0, 50.0);
     Matrix4D rotation = Matrix4D::identity();
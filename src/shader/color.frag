@@ -1,15 +1,17 @@
 #version 330 core
 
-struct Material
+/* per frame camera data shared by all programs, matches struct FrameBlock (uniform_buffer.h) */
+layout(std140) uniform FrameBlock
 {
-    vec3 diffuse;
-    vec3 ambient;
-    vec3 specular;
-    vec3 emission;
-    float shininess;
+    mat4 uView;
+    mat4 uProj;
+    mat4 uViewProj;
+    vec3 uCameraPos;            // camera position needed for specular computations
+    float uTime;
 };
 
-struct Light
+/* light of the scene, matches struct LightBlock (uniform_buffer.h) */
+layout(std140) uniform LightBlock
 {
     vec3 lightPos;
     vec3 globalAmbientLightColor;
@@ -17,26 +19,70 @@ struct Light
     float ka;                       // ambient coefficient  [0, 1]
     float kd;                       // diffuse coefficient  [0, 1]
     float ks;                       // specular coefficient [0, 1]
+} uLight;
+
+/* per draw records of the bound window of the draw ring, matches struct DrawRecord (uniform_buffer.h) */
+struct DrawRecord
+{
+    mat4 model;
+    mat3 normal;                // transpose(inverse(mat3(model)))
+    int material;               // element of MaterialBlock
 };
 
-uniform Light uLight;
-uniform vec3 uCameraPos; // camera position needed for specular computations
+layout(std140) uniform DrawBlock
+{
+    DrawRecord uDraws[128];     // DRAW_RECORDS
+};
+
+/* material table of the scene, matches struct MaterialRecord (uniform_buffer.h) */
+struct MaterialRecord
+{
+    vec3 diffuse;
+    float shininess;
+    vec3 ambient;
+    vec3 specular;
+    vec3 emission;
+    ivec4 layers[2];            // texture array layers of the maps: diffuse, normal, ambient, emission, shininess, specular
+};
+
+layout(std140) uniform MaterialBlock
+{
+    MaterialRecord uMaterials[128];     // MATERIAL_RECORDS
+};
 
 in vec3 tNormal;
 in vec3 tFragPos;
 in vec2 TexCoords;
+flat in int tDraw;
 
 out vec4 FragColor;
 
-uniform Material uMaterial;
+#ifdef TEXTURE_ARRAYS
+// the maps of a material family are layers of shared texture arrays (not combined with PACKED_MAPS), the record of
+// the material drawn picks them
+uniform sampler2DArray map_diffuse;
+uniform sampler2DArray map_emission;
+uniform sampler2DArray map_normal;
+uniform sampler2DArray map_specular;
+uniform sampler2DArray map_ambient;
+uniform sampler2DArray map_shininess;
+#define MAP(map, slot) texture(map, vec3(TexCoords, float(uMaterials[uDraws[tDraw].material].layers[slot / 4][slot % 4])))
+#else
 uniform sampler2D map_diffuse;
-uniform sampler2D map_ambient;
 uniform sampler2D map_emission;
-uniform sampler2D map_shininess;
 uniform sampler2D map_normal;
 uniform sampler2D map_specular;
+uniform sampler2D map_ambient;
+uniform sampler2D map_shininess;
+#ifdef PACKED_MAPS
+// scalar maps packed by materialPack, materials that couldn't be packed read their separate maps
+uniform sampler2D map_packed; // r: ambient occlusion, g: shininess, b: specular if packedSpecular
+uniform bool packedMaps;
+uniform bool packedSpecular;
+#endif
+#define MAP(map, slot) texture(map, TexCoords)
+#endif
 uniform bool hasSpecular;
-uniform mat4 uModel;
 
 /*
 vec3 directionalLight(vec3 normal, vec3 lightPos) {
@@ -96,22 +142,33 @@ void main(void)
     // Compute the directional/global light contribution
     vec3 lightResult = directionalLight(normal, uLight.lightPos);
     vec3 finalColor_previous = lightResult + uMaterial.emission;*/
-    Light dummy = uLight; // compiler get rid off unused in main uniforms
-    Material dummy2 = uMaterial;
-
-    vec3 tex_diffuse = texture(map_diffuse, TexCoords).rgb;
-    vec3 tex_ambient = texture(map_ambient, TexCoords).rgb;
-    vec4 tex_emission = texture(map_emission, TexCoords);
-    float tex_shininess = texture(map_shininess, TexCoords).r * 1000.0;
-    vec3 tex_normals = texture(map_normal, TexCoords).rgb; // x, y, z
+    vec3 tex_diffuse = MAP(map_diffuse, 0).rgb;
+    vec4 tex_emission = MAP(map_emission, 3);
+    vec3 tex_normals = MAP(map_normal, 1).rgb; // x, y, z
     vec3 tex_specular = vec3(0.0);
-    if (hasSpecular) {
-        tex_specular = texture(map_specular, TexCoords).rgb;
+    vec3 tex_ambient;
+    float tex_shininess;
+#ifdef PACKED_MAPS
+    if (packedMaps) {
+        vec4 tex_packed = texture(map_packed, TexCoords);
+        tex_ambient = vec3(tex_packed.r);
+        tex_shininess = tex_packed.g * 1000.0;
+        if (hasSpecular) {
+            tex_specular = packedSpecular ? vec3(tex_packed.b) : MAP(map_specular, 5).rgb;
+        }
+    } else
+#endif
+    {
+        tex_ambient = MAP(map_ambient, 2).rgb;
+        tex_shininess = MAP(map_shininess, 4).r * 1000.0;
+        if (hasSpecular) {
+            tex_specular = MAP(map_specular, 5).rgb;
+        }
     }
 
     vec3 ambientMaterial = tex_diffuse * tex_ambient;
     vec3 n_objectSpace  = tex_normals * 2.0 - 1.0;
-    vec3 n_world = normalize( mat3(transpose(inverse(mat3(uModel)))) * n_objectSpace );
+    vec3 n_world = normalize( uDraws[tDraw].normal * n_objectSpace );
 
     vec3 blinnResult = blinnPhongIllumination(
         n_world,
@@ -124,7 +181,7 @@ void main(void)
         tex_shininess
     );
 
-    float alpha = texture(map_diffuse, TexCoords).a;
+    float alpha = MAP(map_diffuse, 0).a;
 
     vec4 finalColor = vec4(blinnResult, alpha) + tex_emission;
 
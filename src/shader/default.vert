@@ -1,22 +1,60 @@
 #version 330 core
 
 layout(location = 0) in vec3 aPosition;
-layout(location = 1) in vec3 aNormal;
+layout(location = 1) in vec3 aNormal;   // xy holds an octahedral normal for compact meshes
 layout(location = 2) in vec2 aUV;
+layout(location = 3) in int aDrawID;    // record of the draw, set through the base instance
 
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProj;
+/* per frame camera data shared by all programs, matches struct FrameBlock (uniform_buffer.h) */
+layout(std140) uniform FrameBlock
+{
+    mat4 uView;
+    mat4 uProj;
+    mat4 uViewProj;
+    vec3 uCameraPos;            // camera position needed for specular computations
+    float uTime;
+};
+
+/* per draw records of the bound window of the draw ring, matches struct DrawRecord (uniform_buffer.h) */
+struct DrawRecord
+{
+    mat4 model;
+    mat3 normal;                // transpose(inverse(mat3(model)))
+    int material;               // element of MaterialBlock
+};
+
+layout(std140) uniform DrawBlock
+{
+    DrawRecord uDraws[128];     // DRAW_RECORDS
+};
+
+/* vertex decoding of compact meshes (see eVertexFormat), the defaults leave float meshes untouched */
+uniform vec3 uPositionOffset = vec3(0.0);
+uniform vec3 uPositionScale = vec3(1.0);
+uniform bool uOctNormals = false;
 
 out vec3 tNormal;
 out vec3 tFragPos;
 out vec2 TexCoords;
+flat out int tDraw;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
 
 void main(void)
 {
-    gl_Position = uProj * uView * uModel * vec4(aPosition, 1.0);
-    tFragPos = vec3(uModel * vec4(aPosition, 1.0));
-    // tNormal = mat3(transpose(inverse(uModel))) * aNormal;
+    vec3 position = uPositionOffset + uPositionScale * aPosition;
+    vec3 normal = uOctNormals ? octDecode(aNormal.xy) : aNormal;
+
+    mat4 model = uDraws[aDrawID].model;
+    gl_Position = uViewProj * model * vec4(position, 1.0);
+    tFragPos = vec3(model * vec4(position, 1.0));
     TexCoords = aUV;
-    tNormal = normalize(mat3(uModel) * aNormal);
+    tNormal = normalize(uDraws[aDrawID].normal * normal);
+    tDraw = aDrawID;
 }
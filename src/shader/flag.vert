@@ -4,13 +4,32 @@
  */
 
 layout(location = 0) in vec3 aPosition;
-layout(location = 1) in vec3 aNormal;
+layout(location = 1) in vec3 aNormal;   // xy holds an octahedral normal for compact meshes
 layout(location = 2) in vec2 aUV;
+layout(location = 3) in int aDrawID;    // record of the draw, set through the base instance
 
-uniform mat4 uModel;
-uniform mat4 uView;
-uniform mat4 uProj;
-uniform vec3 uCameraPos;
+/* per frame camera data shared by all programs, matches struct FrameBlock (uniform_buffer.h) */
+layout(std140) uniform FrameBlock
+{
+    mat4 uView;
+    mat4 uProj;
+    mat4 uViewProj;
+    vec3 uCameraPos;            // camera position needed for specular computations
+    float uTime;
+};
+
+/* per draw records of the bound window of the draw ring, matches struct DrawRecord (uniform_buffer.h) */
+struct DrawRecord
+{
+    mat4 model;
+    mat3 normal;                // transpose(inverse(mat3(model)))
+    int material;               // element of MaterialBlock
+};
+
+layout(std140) uniform DrawBlock
+{
+    DrawRecord uDraws[128];     // DRAW_RECORDS
+};
 
 uniform float amplitudes[3];
 uniform float phases[3];      // == phi
@@ -21,18 +40,32 @@ uniform float accumTime; // is updated within the main program!
 uniform sampler2D map_displacement;
 uniform float displacementScale;
 
+/* vertex decoding of compact meshes (see eVertexFormat), the defaults leave float meshes untouched */
+uniform vec3 uPositionOffset = vec3(0.0);
+uniform vec3 uPositionScale = vec3(1.0);
+uniform bool uOctNormals = false;
+
 out vec3 tNormal;
 out vec3 tFragPos;
 out vec2 TexCoords;
 out vec3 normal;
+flat out int tDraw;
 
 
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
 float getDisplacement(vec2 pos) {
     float displacement = 0.0f;
     for (int i = 0; i < 3; i++) {
         displacement += amplitudes[i] * sin(dot(directions[i], pos) * frequencies[i] + accumTime * phases[i]);
     }
-    return displacement * (aPosition.z / zPosMin);
+    return displacement * (pos.y / zPosMin); // in the 2D pos, y equals z
 }
 
 float getDisplacementFromMap(vec2 uv) {
@@ -59,26 +92,31 @@ float getPartialDerivative(bool deriveY, vec2 pos, float time) {
 
 void main(void)
 {
+    vec3 position = uPositionOffset + uPositionScale * aPosition;
+    vec3 vertexNormal = uOctNormals ? octDecode(aNormal.xy) : aNormal;
+
     float displacement = getDisplacementFromMap(aUV);
 
     // Calculate the partial derivatives of H(p, t) with respect to y and z
     // vec2 partialDeriv;
-    vec3 modifiedPos = aPosition + aNormal * displacement;
-    //vec3 modifiedPos = aPosition;
+    vec3 modifiedPos = position + vertexNormal * displacement;
+    //vec3 modifiedPos = position;
 
-    modifiedPos.x += getDisplacement(aPosition.yz); // Displacement on x-axis
+    modifiedPos.x += getDisplacement(position.yz); // Displacement on x-axis
 
-    float partialDerivY = getPartialDerivative(true, aPosition.yz, accumTime);
-    float partialDerivZ = getPartialDerivative(false, aPosition.yz, accumTime);
+    float partialDerivY = getPartialDerivative(true, position.yz, accumTime);
+    float partialDerivZ = getPartialDerivative(false, position.yz, accumTime);
 
     // New normals which consider the displacement of the flag
     normal = normalize(cross(vec3(partialDerivY, 1.0f, 0.0f), vec3(partialDerivZ, 0.0f, 1.0f)));
 
 
-    gl_Position = uProj * uView * uModel * vec4(modifiedPos, 1.0);
-    tFragPos = vec3(uModel * vec4(modifiedPos, 1.0));
+    mat4 model = uDraws[aDrawID].model;
+    gl_Position = uViewProj * model * vec4(modifiedPos, 1.0);
+    tFragPos = vec3(model * vec4(modifiedPos, 1.0));
     TexCoords = aUV;
 
-    tNormal = normalize(mat3(transpose(inverse(uModel))) * normal);
+    tNormal = normalize(uDraws[aDrawID].normal * normal);
+    tDraw = aDrawID;
 }
 
@@ -4,9 +4,29 @@ in vec3 tNormal;
 in vec3 tFragPos;
 out vec4 FragColor;
 
-uniform vec3 uCameraPos;
 uniform bool isFlag;
 
+/* per frame camera data shared by all programs, matches struct FrameBlock (uniform_buffer.h) */
+layout(std140) uniform FrameBlock
+{
+    mat4 uView;
+    mat4 uProj;
+    mat4 uViewProj;
+    vec3 uCameraPos;            // camera position needed for specular computations
+    float uTime;
+};
+
+/* light of the scene, matches struct LightBlock (uniform_buffer.h) */
+layout(std140) uniform LightBlock
+{
+    vec3 lightPos;
+    vec3 globalAmbientLightColor;
+    vec3 lightColor;
+    float ka;                       // ambient coefficient  [0, 1]
+    float kd;                       // diffuse coefficient  [0, 1]
+    float ks;                       // specular coefficient [0, 1]
+} uLight;
+
 struct Material {
     vec3 diffuse;
     vec3 ambient;
@@ -15,15 +35,6 @@ struct Material {
     float shininess;
 };
 
-struct Light {
-    vec3 lightPos;
-    vec3 globalAmbientLightColor;
-    vec3 lightColor;
-    float ka;
-    float kd;
-    float ks;
-};
-
 /*
 struct PointLight {
     vec3 position;
@@ -37,7 +48,6 @@ struct PointLight {
 };*/
 
 uniform Material uMaterial;
-uniform Light uLight;
 //uniform PointLight lights[6];
 uniform int numLights;
 uniform bool planeLightsOn;
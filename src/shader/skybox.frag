@@ -0,0 +1,12 @@
+#version 330 core
+
+in vec4 tDirection;
+
+out vec4 FragColor;
+
+uniform samplerCube uSky;
+
+void main(void)
+{
+    FragColor = vec4(texture(uSky, tDirection.xyz / tDirection.w).rgb, 1.0);
+}
@@ -0,0 +1,15 @@
+#version 330 core
+
+uniform mat4 uInvViewProj;  // inverse of projection * camera rotation
+
+out vec4 tDirection;
+
+void main(void)
+{
+    /* one triangle that covers the whole screen, exactly on the far plane (depth 1 after the divide) */
+    vec2 position = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);
+    gl_Position = vec4(position, 1.0, 1.0);
+
+    /* homogeneous, so it interpolates linearly across the screen; divided per fragment */
+    tDirection = uInvViewProj * vec4(position, 1.0, 1.0);
+}